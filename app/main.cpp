@@ -1,17 +1,24 @@
 #include "cpplox/log/Log.hpp"
 #include "cpplox/core/StringFormatter.hpp"
 #include "cpplox/compiler/Compiler.hpp"
+#include "cpplox/compiler/CppEmitter.hpp"
 #include "cpplox/vm/VM.hpp"
+#include "cpplox/runtime/GC.hpp"
 #include "cpplox/diagnostics/DiagnosticEngine.hpp"
 
+#include <chrono>
 #include <cstdlib>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 
 using cpplox::VM;
 using cpplox::Compiler;
+using cpplox::OptimizationLevel;
+using cpplox::Backend;
+using cpplox::VMOptions;
 using cpplox::InterpretResult;
 using cpplox::InterpretResultCode;
 using cpplox::DiagnosticConsumer;
@@ -24,17 +31,21 @@ public:
     }
 };
 
-bool hasEnvVar(const char* name) {
+const char* envVar(const char* name) {
 #ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable : 4996)
 #endif
-    return std::getenv(name) != nullptr;
+    return std::getenv(name);
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
 }
 
+bool hasEnvVar(const char* name) {
+    return envVar(name) != nullptr;
+}
+
 bool isASCII(const std::string& str);
 
 InterpretResult interpret(std::string source,
@@ -43,7 +54,9 @@ InterpretResult interpret(std::string source,
                           VM& vm,
                           Compiler& c);
 void repl(DiagnosticEngine& e, VM& vm, Compiler& c);
+int emitCpp(const char* filename, DiagnosticEngine& e, VM& vm, Compiler& c);
 bool readFile(const char* filename, std::string& result);
+void printGCStats(const VM& vm);
 
 int main(int argc, const char* argv[]) {
     std::locale::global(std::locale("en_US.UTF-8"));
@@ -52,11 +65,32 @@ int main(int argc, const char* argv[]) {
     Compiler compiler;
     compiler.setOptions({
         .forceLongInstructions = hasEnvVar("CPPLOX_FORCE_LONG_OPS"),
+        .optimizationLevel = hasEnvVar("CPPLOX_NO_OPTIMIZE")
+            ? OptimizationLevel::NONE
+            : OptimizationLevel::PEEPHOLE,
+        .backend = hasEnvVar("CPPLOX_REGISTER_VM")
+            ? Backend::REGISTER
+            : Backend::STACK,
     });
-    VM vm;
+    VMOptions vmOptions;
+    if (hasEnvVar("CPPLOX_JIT_EAGER")) {
+        // compile every function on its first call or loop iteration
+        vmOptions.jitThreshold = 0;
+        vmOptions.osrThreshold = 0;
+    }
+    if (const char* budget = envVar("CPPLOX_GC_PAUSE_BUDGET")) {
+        vmOptions.incrementalGC = true;
+        vmOptions.gcPauseBudget = std::chrono::microseconds(std::strtoul(budget, nullptr, 10));
+    }
+    if (hasEnvVar("CPPLOX_GC_CONCURRENT")) {
+        vmOptions.concurrentGC = true;
+    }
+    VM vm(vmOptions);
+    compiler.setGlobals(&vm.globalTable());
 
     if (argc == 1) {
         repl(diagnostics, vm, compiler);
+        printGCStats(vm);
     } else if (argc == 2) {
         std::string source = "";
         bool bFileOk = readFile(argv[1], source);
@@ -70,6 +104,7 @@ int main(int argc, const char* argv[]) {
         }
 
         const auto r = interpret(std::move(source), false, diagnostics, vm, compiler);
+        printGCStats(vm);
         if (r.code == InterpretResultCode::COMPILE_ERROR) {
             return 65;
         }
@@ -77,6 +112,8 @@ int main(int argc, const char* argv[]) {
             cpplox::errorln("Runtime error: {}", r.error);
             return 70;
         }
+    } else if (argc == 3 && std::string_view(argv[1]) == "--emit-cpp") {
+        return emitCpp(argv[2], diagnostics, vm, compiler);
     } else {
         return 64;
     }
@@ -135,6 +172,46 @@ InterpretResult interpret(std::string source,
     return r;
 }
 
+// Writes the C++ source of a standalone binary of the script to stdout.
+int emitCpp(const char* filename, DiagnosticEngine& e, VM& vm, Compiler& compiler) {
+    std::string source = "";
+    if (readFile(filename, source) == false) {
+        cpplox::errorln("Error reading '{}'", filename);
+        return 74;
+    }
+    if (isASCII(source) == false) {
+        cpplox::errorln("Invalid input - '{}' - non-ascii characters found", filename);
+        return 1;
+    }
+
+    cpplox::CompileResult compiled = compiler.compile(std::move(source), &e);
+    if (compiled.error) {
+        return 65;
+    }
+
+    std::cout << cpplox::emitCpp(*compiled.function, vm.globalTable());
+    for (std::size_t i = 0; i < compiled.gcObjects.getCount(); ++i) {
+        cpplox::gc::freeObject(compiled.gcObjects[i]);
+    }
+    return 0;
+}
+
+// Prints how long the program was paused for the GC to stderr,
+// if asked to with the CPPLOX_GC_STATS environment variable.
+void printGCStats(const VM& vm) {
+    if (hasEnvVar("CPPLOX_GC_STATS") == false) {
+        return;
+    }
+
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const cpplox::GCStats stats = vm.gcStats();
+    cpplox::errorln("GC: {} pauses, total {:.3f} ms, max {:.3f} ms, p99 {:.3f} ms",
+                    stats.pauses,
+                    Milliseconds(stats.total).count(),
+                    Milliseconds(stats.max).count(),
+                    Milliseconds(stats.p99).count());
+}
+
 // Reads a file in a single step.
 // We assume source files are not very big.
 bool readFile(const char* filename, std::string& result) {
@@ -0,0 +1,19 @@
+# Builds a standalone executable of a Lox script. The script is translated
+# to C++ by `cpplox --emit-cpp` at build time, a block of code for each
+# instruction, and linked against the VM, which performs calls and returns.
+#
+#   cpplox_add_executable(<target> <script.lox>)
+function(cpplox_add_executable target script)
+  get_filename_component(script ${script} ABSOLUTE)
+  set(source ${CMAKE_CURRENT_BINARY_DIR}/${target}.cpp)
+
+  add_custom_command(
+    OUTPUT ${source}
+    COMMAND $<TARGET_FILE:cpplox_exe> --emit-cpp ${script} > ${source}
+    DEPENDS cpplox_exe ${script}
+    COMMENT "Compiling ${script} to C++"
+  )
+
+  add_executable(${target} ${source})
+  target_link_libraries(${target} PRIVATE vm)
+endfunction()
@@ -4,11 +4,40 @@
 #include "cpplox/bytecode/Chunk.hpp"
 
 namespace cpplox {
+    enum class OpCode;
+
     bool fitsOneByte(std::size_t i);
     bool fitsTwoBytes(std::size_t i);
     void serializeTwoByteInteger(std::size_t i, std::uint8_t& a, std::uint8_t& b);
     std::size_t parseTwoByteInteger(std::uint8_t a, std::uint8_t b);
 
+    // A source operand of a register instruction with this bit set is the
+    // index of a constant, a register (local slot) otherwise. Only the
+    // first 128 registers and constants fit in one.
+    constexpr std::uint8_t RK_CONSTANT = 0x80;
+    bool fitsRK(std::size_t i);
+
+    // the operand of the instruction at ip, which has a one-byte form
+    // (shortForm) and a two-byte one
+    std::size_t operandOf(const std::uint8_t* ip, OpCode shortForm);
+    // the offset of the first byte after the operand of operandOf
+    std::size_t operandEnd(const std::uint8_t* ip, OpCode shortForm);
+
     void addCode(Chunk& chunk, std::uint8_t c, unsigned l);
     std::size_t addConstant(Chunk& chunk, Value&& v);
+    // the index of a new, empty inline cache of the chunk
+    std::size_t addPropertyCache(Chunk& chunk);
+
+    // JMP, LOOP and the conditional jumps, all of them take a two-byte
+    // offset relative to the next instruction as their first operand
+    bool isJump(OpCode op);
+    bool isConditionalJump(OpCode op);
+
+    // the size in bytes of the instruction starting at offset,
+    // including its operands
+    std::size_t instructionLength(const Chunk& chunk, std::size_t offset);
+    // the maximum number of values the chunk keeps on the stack at any
+    // point of its execution, counting the initialDepth values which are
+    // already there when it starts (the callee and the arguments)
+    std::size_t maxStackDepth(const Chunk& chunk, std::size_t initialDepth);
 } // namespace cpplox
\ No newline at end of file
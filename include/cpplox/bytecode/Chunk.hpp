@@ -6,9 +6,54 @@
 #include "cpplox/core/Vector.hpp"
 
 namespace cpplox {
+    class Shape;
+    class Closure;
+
+    // The inline cache of a property access or method call site. It
+    // remembers what the property name resolved to for the last few
+    // receiver shapes seen at the site. Shapes belong to a single class,
+    // so a shape identifies both the fields and the methods of the
+    // receiver. Super calls look up a class, not a receiver, and are
+    // keyed on the root shape of that class.
+    struct PropertyCache {
+        static constexpr std::size_t WAYS = 4;
+
+        struct Entry {
+            const Shape* shape = nullptr;
+            // the shape after adding the field, if the name was not a field
+            // of shape when it was set
+            Shape* next = nullptr;
+            // the method, if the name was not a field of shape when read
+            Closure* method = nullptr;
+            std::uint32_t slot = 0;
+        };
+
+        const Entry* find(const Shape* shape) const {
+            for (const Entry& e : entries) {
+                if (e.shape == shape) {
+                    return &e;
+                }
+            }
+            return nullptr;
+        }
+
+        // A full (megamorphic) cache keeps replacing its last entry.
+        void insert(const Entry& entry) {
+            std::size_t i = 0;
+            while (i < WAYS - 1 && entries[i].shape != nullptr) {
+                ++i;
+            }
+            entries[i] = entry;
+        }
+
+        Entry entries[WAYS];
+    };
+
     struct Chunk {
         Vector<std::uint8_t> code;
         Vector<unsigned> lines;
         Vector<Value> constants;
+        // indexed by the cache operand of the property and invoke instructions
+        Vector<PropertyCache> propertyCaches;
     };
-} // namespace cpplox
\ No newline at end of file
+} // namespace cpplox
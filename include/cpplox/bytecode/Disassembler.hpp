@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
 #include <string_view>
 
 namespace cpplox {
@@ -36,6 +38,7 @@ namespace cpplox {
         void printInvokeInstruction(const char* name,
                                     std::size_t constant,
                                     std::size_t argc,
+                                    std::size_t cache,
                                     const Chunk& chunk) const;
         std::size_t invokeInstruction(const char* name,
                                       const Chunk& chunk,
@@ -43,6 +46,34 @@ namespace cpplox {
         std::size_t invoke16Instruction(const char* name,
                                         const Chunk& chunk,
                                         std::size_t offset) const;
+        std::size_t propertyInstruction(const char* name,
+                                        const Chunk& chunk,
+                                        std::size_t offset) const;
+        std::size_t property16Instruction(const char* name,
+                                          const Chunk& chunk,
+                                          std::size_t offset) const;
+        void printPropertyInstruction(const char* name,
+                                      std::size_t constant,
+                                      std::size_t cache,
+                                      const Chunk& chunk) const;
+        // a superinstruction with two local slot operands
+        std::size_t localsInstruction(const char* name,
+                                      const Chunk& chunk,
+                                      std::size_t offset) const;
+        // a superinstruction with a local slot and a constant operand
+        std::size_t localConstantInstruction(const char* name,
+                                             const Chunk& chunk,
+                                             std::size_t offset) const;
+        // a register or a constant operand of a register instruction
+        std::string registerOperand(const Chunk& chunk, std::uint8_t rk) const;
+        // a destination register and two sources
+        std::size_t registerInstruction(const char* name,
+                                        const Chunk& chunk,
+                                        std::size_t offset) const;
+        // a jump offset and two sources
+        std::size_t registerJumpInstruction(const char* name,
+                                            const Chunk& chunk,
+                                            std::size_t offset) const;
         std::size_t closureUpvalues(const Chunk& chunk,
                                     std::size_t offset) const;
     };
@@ -58,5 +58,39 @@ namespace cpplox {
         GET_SUPER_16,
         SUPER_INVOKE,
         SUPER_INVOKE_16,
+        // quickened forms, the VM rewrites ADD to them at runtime
+        ADD_NUM,
+        ADD_STR,
+        // superinstructions, each one replaces a READ_LOCAL,
+        // a READ_LOCAL or a CONSTANT and a binary operation
+        ADD_LOCALS,
+        LESS_LOCALS,
+        ADD_LOCAL_CONST,
+        SUBTRACT_LOCAL_CONST,
+        LESS_LOCAL_CONST,
+        // conditional jumps which pop the condition
+        POP_JMP_IF_FALSE,
+        JMP_IF_NOT_LESS,
+        JMP_IF_NOT_LESS_EQUAL,
+        JMP_IF_NOT_GREATER,
+        JMP_IF_NOT_GREATER_EQUAL,
+        // emitted by the peephole optimizer only
+        POP_JMP_IF_TRUE,
+        SET_LOCAL_POP,
+        // a CALL in 'return f(...)', reuses the frame of the caller if it can
+        TAIL_CALL,
+        // three-address instructions of the register backend, the
+        // registers are the local slots of the frame and a source operand
+        // is a register or a constant (see RK_CONSTANT), the stack is left
+        // as it is. dst = a, dst = a op b and jumps if a op b does not hold
+        MOVE,
+        ADD_RK,
+        SUBTRACT_RK,
+        MULTIPLY_RK,
+        DIVIDE_RK,
+        JMP_IF_NOT_LESS_RK,
+        JMP_IF_NOT_LESS_EQUAL_RK,
+        JMP_IF_NOT_GREATER_RK,
+        JMP_IF_NOT_GREATER_EQUAL_RK,
     };
 }
\ No newline at end of file
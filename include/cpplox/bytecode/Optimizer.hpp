@@ -0,0 +1,22 @@
+#pragma once
+
+#include "cpplox/bytecode/Chunk.hpp"
+
+namespace cpplox {
+    enum class OptimizationLevel {
+        NONE,
+        // rewrites of short instruction sequences and jump chains
+        PEEPHOLE,
+    };
+
+    // Rewrites the code of a compiled chunk in place, keeping the lines
+    // table in step with it and fixing up the jump offsets. Constants and
+    // inline caches are indexed by operands and are left untouched.
+    void optimize(Chunk& chunk, OptimizationLevel level);
+
+    // Rewrites the moves, arithmetic and comparisons between locals and
+    // constants to the three-address instructions of the register backend,
+    // which name the local slots as registers instead of passing their
+    // values on the stack. Everything else is left as stack code.
+    void allocateRegisters(Chunk& chunk);
+} // namespace cpplox
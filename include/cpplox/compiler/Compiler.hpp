@@ -1,8 +1,10 @@
 #pragma once
 
 #include "cpplox/compiler/Scanner.hpp"
+#include "cpplox/bytecode/Optimizer.hpp"
 #include "cpplox/core/Vector.hpp"
 #include "cpplox/core/Value.hpp"
+#include "cpplox/runtime/StringTable.hpp"
 
 #include <string>
 
@@ -12,6 +14,7 @@ namespace cpplox {
     class DiagnosticEngine;
     enum class OpCode;
     class String;
+    class GlobalTable;
 
     struct CompileResult {
         bool error = false;
@@ -19,8 +22,18 @@ namespace cpplox {
         Vector<Object*> gcObjects;
     };
 
+    enum class Backend {
+        // every operand is passed on the stack
+        STACK,
+        // the locals are registers of three-address instructions
+        // where an instruction can take them (see allocateRegisters)
+        REGISTER,
+    };
+
     struct CompileOptions {
         bool forceLongInstructions = false;
+        OptimizationLevel optimizationLevel = OptimizationLevel::PEEPHOLE;
+        Backend backend = Backend::STACK;
     };
 
     class Compiler {
@@ -60,6 +73,9 @@ namespace cpplox {
         Compiler& operator=(const Compiler&) = delete;
 
         void setOptions(const CompileOptions& opts);
+        // the table global names are resolved in, must be
+        // the one of the VM which is going to run the code
+        void setGlobals(GlobalTable* table);
 
         CompileResult compile(std::string src, DiagnosticEngine* engine);
         CompileResult replExpression(std::string src, DiagnosticEngine* engine);
@@ -80,6 +96,7 @@ namespace cpplox {
                         const Token& name,
                         Upvalue upv,
                         std::size_t& upvalueIdx);
+        bool resolveGlobal(const Token& name, std::size_t& idx);
         bool resolveLocal(Frame& frame, const Token& name, std::size_t& idx);
         bool resolveUpvalue(Frame& frame, const Token& name, std::size_t& idx);
 
@@ -95,18 +112,41 @@ namespace cpplox {
         void compileError(const Token& t, std::string_view fmt, Args&&... args);
         bool processError();
 
+        Value makeString(std::string_view chars);
         bool makeConstant(Value value,
                           bool searchExisting,
                           std::size_t& idx);
         void emitReturn();
+        void finishFunction();
         void emitConstant(Value value);
         void emitClosure(Function* fun, const Frame& closureFrame);
         void emitIntegerInstruction(OpCode small,
                                     OpCode big,
                                     std::size_t operand);
         void emitTwoByteIntegerInstruction(OpCode op, std::size_t operand);
+        // the cache operand of a property or invoke instruction
+        void emitPropertyCache();
+        // emits op or fuses it with the operands before it
+        void emitBinaryOp(OpCode op);
+        bool emitSuperinstruction(OpCode op);
+        // constant folding, replaces the operands of op with its result
+        // if they are all constants
+        bool foldUnaryOp(OpCode op);
+        bool foldBinaryOp(OpCode op);
+        bool constantAt(std::size_t offset, Value& value) const;
+        // the value of the last expression, if it is a single constant
+        bool constantExpression(Value& value) const;
+        void emitValue(const Value& value);
+        // removes the last one or two instructions emitted
+        void removeInstructions(std::size_t count);
+        // compiles a statement which never runs and drops its code
+        void deadStatement();
         void emitLoop(std::size_t loopStart);
+        std::size_t markLoopStart();
         std::size_t emitJump(OpCode op);
+        // the jump of a statement condition, taken if it is false,
+        // the condition is popped on both paths
+        std::size_t emitConditionJump();
         void patchJump(std::size_t offset);
         void emitOpCode(OpCode op);
         void emitByte(std::uint8_t byte);
@@ -163,6 +203,7 @@ namespace cpplox {
             bool hadError = false;
             bool panicMode = false;
         } parser;
+        static constexpr std::size_t NO_INSTRUCTION = static_cast<std::size_t>(-1);
         struct Frame {
             Frame* parent = nullptr;
             FunctionType funType = FunctionType::SCRIPT;
@@ -170,6 +211,13 @@ namespace cpplox {
             Vector<Local> locals;
             Vector<Upvalue> upvalues;
             std::uint16_t scopeDepth = 0;
+            // where the last three instructions start and the furthest offset
+            // a jump lands on, superinstructions and folded constants must
+            // not span a jump target
+            std::size_t lastInstruction = NO_INSTRUCTION;
+            std::size_t previousInstruction = NO_INSTRUCTION;
+            std::size_t thirdInstruction = NO_INSTRUCTION;
+            std::size_t lastJumpTarget = 0;
         } frame;
         struct Loop {
             bool null = true;
@@ -184,6 +232,10 @@ namespace cpplox {
             bool hasSuperclass = false;
         } enclosingClass;
         Vector<Object*> gcObjects;
+        // the strings of the current compilation,
+        // the VM interns them again when it takes the objects
+        StringTable strings;
+        GlobalTable* globals = nullptr;
         DiagnosticEngine* diagnostics = nullptr;
         CompileOptions options;
     };
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace cpplox {
+    class Function;
+    class GlobalTable;
+
+    // Emits a C++ translation unit which defines the program compiled to
+    // script as a ProgramImage (cpplox/vm/Program.hpp) along with a main
+    // which runs it. Each function comes with C++ code translated from its
+    // bytecode, which leaves the frame to the VM only to call or return.
+    // Built and linked against the vm library, it is a standalone binary
+    // of the script. globals must be the table the script was compiled with.
+    std::string emitCpp(const Function& script, const GlobalTable& globals);
+} // namespace cpplox
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <string_view>
 
 namespace cpplox {
@@ -46,4 +47,7 @@ namespace cpplox {
 
     bool operator==(const String& lhs, const String& rhs);
     bool operator!=(const String& lhs, const String& rhs);
+
+    // the hash String::hashValue() returns for the same characters
+    std::uint32_t hashOf(std::string_view chars);
 } // namespace cpplox
\ No newline at end of file
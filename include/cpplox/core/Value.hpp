@@ -1,6 +1,12 @@
 #pragma once
 
 #include <string_view>
+#include <type_traits>
+
+#ifdef CPPLOX_NAN_BOXING
+#include <bit>
+#include <cstdint>
+#endif
 
 namespace cpplox {
     class Object;
@@ -12,8 +18,97 @@ namespace cpplox {
         NUMBER,
         STRING,
         OBJECT,
+        // marks a declared, but not yet defined global variable
+        UNDEFINED,
+    };
+
+#ifdef CPPLOX_NAN_BOXING
+    // Every value is a double. Non-number values are stored in the
+    // payload of a quiet NaN which no arithmetic operation produces:
+    // nil and the booleans are small tags in the low bits, pointers
+    // have the sign bit set and strings have an extra tag bit above
+    // the 48 bits of the address.
+    // Strings are interned and owned by the GC, so a Value never
+    // owns memory and is copied bitwise.
+    class Value {
+    private:
+        static constexpr std::uint64_t SIGN_BIT = 0x8000000000000000;
+        static constexpr std::uint64_t QNAN = 0x7ffc000000000000;
+        static constexpr std::uint64_t STRING_BIT = 0x0001000000000000;
+        static constexpr std::uint64_t POINTER_TAG = SIGN_BIT | QNAN;
+        static constexpr std::uint64_t POINTER_MASK = POINTER_TAG | STRING_BIT;
+
+        static constexpr std::uint64_t TAG_NIL = 1;
+        static constexpr std::uint64_t TAG_FALSE = 2;
+        static constexpr std::uint64_t TAG_TRUE = 3;
+        static constexpr std::uint64_t TAG_UNDEFINED = 4;
+
+        static constexpr std::uint64_t NIL_BITS = QNAN | TAG_NIL;
+        static constexpr std::uint64_t FALSE_BITS = QNAN | TAG_FALSE;
+        static constexpr std::uint64_t TRUE_BITS = QNAN | TAG_TRUE;
+        static constexpr std::uint64_t UNDEFINED_BITS = QNAN | TAG_UNDEFINED;
+
+    public:
+        // all of these bits are set in the non-number values, for machine
+        // code which tells numbers apart without calling isNumber
+        static constexpr std::uint64_t NAN_BITS = QNAN;
+
+        Value() = default;
+        explicit Value(bool b)
+            : bits(b ? TRUE_BITS : FALSE_BITS)
+        {}
+        explicit Value(double d)
+            : bits(std::bit_cast<std::uint64_t>(d))
+        {}
+        explicit Value(const String* s)
+            : bits(POINTER_MASK | reinterpret_cast<std::uintptr_t>(s))
+        {}
+        explicit Value(Object* obj)
+            : bits(POINTER_TAG | reinterpret_cast<std::uintptr_t>(obj))
+        {}
+
+        static Value nil() { return Value(); }
+        static Value undefined() {
+            Value v;
+            v.bits = UNDEFINED_BITS;
+            return v;
+        }
+
+        ValueType internalType() const;
+        bool holdsType(ValueType t) const { return internalType() == t; }
+        bool isNil() const { return bits == NIL_BITS; }
+        bool isUndefined() const { return bits == UNDEFINED_BITS; }
+        bool isBoolean() const { return (bits | 1) == TRUE_BITS; }
+        bool isNumber() const { return (bits & QNAN) != QNAN; }
+        bool isString() const { return (bits & POINTER_MASK) == POINTER_MASK; }
+        bool isObject() const { return (bits & POINTER_MASK) == POINTER_TAG; }
+
+        bool asBoolean() const { return bits == TRUE_BITS; }
+        double asNumber() const { return std::bit_cast<double>(bits); }
+        const String& asString() const { return *pointer<const String>(); }
+        Object* asObject() { return pointer<Object>(); }
+        const Object* asObject() const { return pointer<Object>(); }
+
+        bool isFalsey() const { return bits == NIL_BITS || bits == FALSE_BITS; }
+
+        bool operator==(const Value& rhs) const;
+        bool operator!=(const Value& rhs) const {
+            return !(*this == rhs);
+        }
+
+    private:
+        template <typename T>
+        T* pointer() const {
+            return reinterpret_cast<T*>(static_cast<std::uintptr_t>(bits & ~POINTER_MASK));
+        }
+
+    private:
+        std::uint64_t bits = NIL_BITS;
     };
 
+    static_assert(sizeof(Value) == 8, "A NaN-boxed Value should fit in 64 bits");
+    static_assert(std::is_trivially_copyable_v<Value>);
+#else
     class Value {
     public:
         Value() = default;
@@ -25,25 +120,26 @@ namespace cpplox {
             : type(ValueType::NUMBER)
             , as{.number = d}
         {}
-        explicit Value(String&& s);
-        explicit Value(std::string_view s);
+        explicit Value(const String* s)
+            : type(ValueType::STRING)
+            , as{.string = s}
+        {}
         explicit Value(Object* obj)
             : type(ValueType::OBJECT)
             , as{.object = obj}
         {}
 
-        Value(const Value& other) { copy(other); }
-        Value(Value&& other) noexcept { move(std::move(other)); }
-        ~Value() { destroy(); }
-
-        Value& operator=(const Value& other);
-        Value& operator=(Value&& other) noexcept;
-
         static Value nil() { return Value(); }
+        static Value undefined() {
+            Value v;
+            v.type = ValueType::UNDEFINED;
+            return v;
+        }
 
         ValueType internalType() const { return type; }
         bool holdsType(ValueType t) const { return type == t; }
         bool isNil() const { return holdsType(ValueType::NIL); }
+        bool isUndefined() const { return holdsType(ValueType::UNDEFINED); }
         bool isBoolean() const { return holdsType(ValueType::BOOL); }
         bool isNumber() const { return holdsType(ValueType::NUMBER); }
         bool isString() const { return holdsType(ValueType::STRING); }
@@ -52,7 +148,6 @@ namespace cpplox {
         bool asBoolean() const { return as.boolean; }
         double asNumber() const { return as.number; }
         const String& asString() const { return *(as.string); }
-        String& asString() { return *(as.string); }
         Object* asObject() { return as.object; }
         const Object* asObject() const { return as.object; }
 
@@ -63,17 +158,12 @@ namespace cpplox {
             return !(*this == rhs);
         }
 
-    private:
-        void copy(const Value& other);
-        void move(Value&& other);
-        void destroy();
-
     private:
         ValueType type = ValueType::NIL;
         union {
             bool boolean;
             double number;
-            String* string;
+            const String* string;
             Object* object;
         } as;
     };
@@ -81,4 +171,6 @@ namespace cpplox {
     static_assert(
         sizeof(Value) <= 16,
         "We should keep Value small enough to be passed around on the stack");
+    static_assert(std::is_trivially_copyable_v<Value>);
+#endif
 } // namespace cpplox
\ No newline at end of file
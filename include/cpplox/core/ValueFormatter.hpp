@@ -28,6 +28,9 @@ struct fmt::formatter<cpplox::Value> {
                 std::string s = fmt::format("\"{}\"", v.asString());
                 return spec.format(std::string_view(s), ctx);
             } break;
+            case cpplox::ValueType::UNDEFINED: {
+                return spec.format(std::string_view("undefined"), ctx);
+            } break;
             case cpplox::ValueType::OBJECT: {
                 std::string s =
                     fmt::format("<obj {}>",
@@ -5,11 +5,12 @@
 #include "cpplox/core/Vector.hpp"
 
 namespace cpplox {
+    // Maps interned strings to values. Keys are compared by identity,
+    // so every key must come from the same string table.
     class ValueMap {
         struct Entry {
-            String key;
+            const String* key = nullptr;
             Value value;
-            bool isEmpty = true;
         };
     public:
         ValueMap();
@@ -20,10 +21,10 @@ namespace cpplox {
         ValueMap& operator=(ValueMap&& src) noexcept;
         ValueMap& operator=(const ValueMap& src);
 
-        void insert(String key, Value v);
-        bool remove(const String& key, Value& v);
-        bool find(const String& key, Value& v) const;
-        bool contains(const String& key) const;
+        void insert(const String* key, Value v);
+        bool remove(const String* key, Value& v);
+        bool find(const String* key, Value& v) const;
+        bool contains(const String* key) const;
 
         bool isEmpty() const;
         void clear();
@@ -32,11 +33,13 @@ namespace cpplox {
 
         template <typename F>
         void forEachValue(const F& f);
+        template <typename F>
+        void forEachEntry(const F& f);
 
     private:
         ValueMap(std::size_t tableSize);
 
-        std::size_t findSlot(const String& key) const;
+        std::size_t findSlot(const String* key) const;
         void growIfFillingUp();
 
         static void insertEntries(const Vector<Entry>& table, ValueMap& map);
@@ -55,9 +58,20 @@ namespace cpplox {
         const std::size_t size = table.getCount();
         for (std::size_t i = 0; i < size; ++i) {
             Entry& e = table[i];
-            if (e.isEmpty == false) {
+            if (e.key != nullptr) {
                 f(e.value);
             }
         }
     }
+
+    template <typename F>
+    void ValueMap::forEachEntry(const F& f) {
+        const std::size_t size = table.getCount();
+        for (std::size_t i = 0; i < size; ++i) {
+            Entry& e = table[i];
+            if (e.key != nullptr) {
+                f(e.key, e.value);
+            }
+        }
+    }
 } // namespace cpplox
\ No newline at end of file
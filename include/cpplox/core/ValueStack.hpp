@@ -1,32 +1,54 @@
 #pragma once
 
 #include "cpplox/core/Value.hpp"
-#include "cpplox/core/Vector.hpp"
+
+#include <cstddef>
+#include <utility>
 
 namespace cpplox {
+    // A contiguous stack with a fixed capacity.
+    // It is never reallocated, so pointers to its values stay valid.
+    // Pushing onto a full stack is undefined - callers check for room first.
     class ValueStack {
     public:
-        const Value& at(std::size_t i) const { return stack[i]; }
-        Value& at(std::size_t i) { return stack[i]; }
+        static constexpr std::size_t DEFAULT_CAPACITY = 256;
+
+        explicit ValueStack(std::size_t capacity = DEFAULT_CAPACITY);
+        ~ValueStack();
+
+        ValueStack(const ValueStack&) = delete;
+        ValueStack& operator=(const ValueStack&) = delete;
 
-        const Value& peekN(std::size_t n) const;
-        Value& peekN(std::size_t n);
-        const Value& peek() const { return stack.back(); }
-        Value& peek() { return stack.back(); }
+        const Value& at(std::size_t i) const { return items[i]; }
+        Value& at(std::size_t i) { return items[i]; }
+
+        const Value& peekN(std::size_t n) const { return top[-1 - static_cast<std::ptrdiff_t>(n)]; }
+        Value& peekN(std::size_t n) { return top[-1 - static_cast<std::ptrdiff_t>(n)]; }
+        const Value& peek() const { return top[-1]; }
+        Value& peek() { return top[-1]; }
 
         Value pop();
         void popN(std::size_t n);
-        void push(Value&& v) { stack.insertBack(std::move(v)); }
-        void push(const Value& v) { stack.insertBack(v); }
+        void push(Value&& v) { *(top++) = std::move(v); }
+        void push(const Value& v) { *(top++) = v; }
         void clear();
-        void reserve(std::size_t size);
 
-        bool isEmpty() const { return stack.isEmpty(); }
-        std::size_t size() const { return stack.getCount(); }
+        bool isEmpty() const { return top == items; }
+        bool isFull() const { return top == limit; }
+        std::size_t size() const { return static_cast<std::size_t>(top - items); }
+        std::size_t capacity() const { return static_cast<std::size_t>(limit - items); }
+
+        const Value* data() const { return items; }
+        Value* data() { return items; }
 
-        const Value* data() const { return stack.data(); }
+        // Raw access to the top of the stack (one past the last value)
+        // so that the interpreter loop can keep it in a local.
+        Value* end() { return top; }
+        void setEnd(Value* newTop) { top = newTop; }
 
     private:
-        Vector<Value> stack;
+        Value* items = nullptr;
+        Value* top = nullptr;
+        Value* limit = nullptr;
     };
-} // namespace cpplox
\ No newline at end of file
+} // namespace cpplox
@@ -5,15 +5,21 @@
 #include "cpplox/core/ValueMap.hpp"
 
 namespace cpplox {
+    class Shape;
+
     class Class : public Object {
     public:
         static constexpr ObjectType TYPE = ObjectType::CLASS;
 
-        explicit Class(const String& name);
+        Class(const String& name, Shape* rootShape);
 
         void trace(gc::Visitor& v) override;
 
         const String name;
         ValueMap methods;
+        // the shape of new instances
+        Shape* const rootShape = nullptr;
+        // the most fields an instance has had, reserved for new instances
+        std::size_t fieldCountHint = 0;
     };
-}
\ No newline at end of file
+}
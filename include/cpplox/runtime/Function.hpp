@@ -5,6 +5,10 @@
 #include "cpplox/bytecode/Chunk.hpp"
 
 namespace cpplox {
+    struct JitCode;
+    struct AotFrame;
+    struct AotExit;
+
     class Function : public Object {
     public:
         static constexpr ObjectType TYPE = ObjectType::FUNCTION;
@@ -16,6 +20,21 @@ namespace cpplox {
         const String name;
         unsigned arity = 0;
         unsigned upvaluesCount = 0;
+        // the most stack slots a call can use, the callee and arguments included
+        std::size_t maxStackSize = 0;
         Chunk chunk;
+        // the C++ code of the function in an ahead-of-time built program,
+        // see cpplox/vm/Program.hpp
+        AotExit (*aotEntry)(const AotFrame& frame, Value* sp, std::size_t resumeAt) = nullptr;
+#ifdef CPPLOX_JIT
+        // owned by the JIT, set once the function has been called often enough
+        JitCode* jitCode = nullptr;
+        std::uint32_t callCount = 0;
+        std::uint32_t backEdgeCount = 0;
+        // the times its machine code has been dropped
+        std::uint32_t recompileCount = 0;
+        // the JIT can't compile some of its code, it stays interpreted
+        bool jitFailed = false;
+#endif
     };
 }
\ No newline at end of file
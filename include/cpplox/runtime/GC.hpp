@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cpplox/runtime/Object.hpp"
+#include "cpplox/core/Vector.hpp"
 #ifdef CPPLOX_DEBUG_LOG_GC
     #include "cpplox/log/Log.hpp"
 #endif
@@ -27,6 +28,30 @@ namespace cpplox::gc {
         return obj;
     }
 
-    void traceRoot(Object* root);
+    // Marks the objects reachable from the roots it visits. Visiting an
+    // object marks it and queues it as gray, trace() then traces the gray
+    // objects from the worklist, so marking does not recurse on the native
+    // stack however deep the object graph is.
+    class Marker : public Visitor {
+    public:
+        using Visitor::visit;
+        void visit(Object* obj) override;
+
+        // traces the gray objects until there are none left
+        void trace();
+        // traces at most count gray objects, whether none is left
+        bool trace(std::size_t count);
+        // queues obj, which is marked, to be traced again after
+        // a store into it
+        void retrace(Object* obj);
+        bool isDone() const { return gray.isEmpty(); }
+
+    private:
+        Vector<Object*> gray;
+    };
+
+    // whether v refers to an object which has not survived a collection
+    bool isYoung(const Value& v);
+
     void freeObject(Object* obj);
 } // namespace cpplox::gc
\ No newline at end of file
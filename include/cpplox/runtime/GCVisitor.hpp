@@ -2,12 +2,16 @@
 
 namespace cpplox {
     class Object;
+    class Value;
 
     namespace gc {
         class Visitor {
         public:
             virtual ~Visitor() = default;
             virtual void visit(Object*) = 0;
+
+            // visits the object or the string the value refers to, if any
+            void visit(const Value& v);
         };
     } // namespace gc
 } // namespace cpplox
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "cpplox/core/String.hpp"
+#include "cpplox/core/Value.hpp"
+#include "cpplox/core/Vector.hpp"
+
+#include <string_view>
+
+namespace cpplox {
+    // The global variables, shared by the compiler and the VM.
+    // The compiler resolves each global name to a slot which stays the
+    // same for the lifetime of the table, so code compiled separately
+    // (e.g. REPL lines) refers to the same variable. The VM indexes the
+    // values by slot; a slot is undefined until the variable is defined.
+    class GlobalTable {
+    public:
+        GlobalTable();
+
+        // the slot of the global named name, a new undefined one if it has none
+        std::size_t slotFor(std::string_view name);
+        bool find(std::string_view name, std::size_t& slot) const;
+
+        const String& nameOf(std::size_t slot) const { return names[slot]; }
+        Value* values() { return slots.data(); }
+        std::size_t size() const { return slots.getCount(); }
+
+    private:
+        std::size_t findIndex(std::string_view name, std::uint32_t hash) const;
+        void growIndexIfFillingUp();
+
+    private:
+        Vector<String> names;
+        Vector<Value> slots;
+        // open addressing table of slot + 1, 0 marks an empty entry
+        Vector<std::size_t> index;
+    };
+} // namespace cpplox
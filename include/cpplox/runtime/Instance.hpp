@@ -1,10 +1,12 @@
 #pragma once
 
 #include "cpplox/runtime/Object.hpp"
-#include "cpplox/core/ValueMap.hpp"
+#include "cpplox/core/Value.hpp"
+#include "cpplox/core/Vector.hpp"
 
 namespace cpplox {
     class Class;
+    class Shape;
 
     class Instance : public Object {
     public:
@@ -14,7 +16,11 @@ namespace cpplox {
 
         void trace(gc::Visitor& v) override;
 
+        bool getField(const String* name, Value& result) const;
+
         Class* const klass = nullptr;
-        ValueMap fields;
+        // maps the field names to slots in fields
+        Shape* shape = nullptr;
+        Vector<Value> fields;
     };
-}
\ No newline at end of file
+}
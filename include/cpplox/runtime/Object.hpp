@@ -10,6 +10,8 @@ namespace cpplox {
         CLASS,
         INSTANCE,
         BOUND_METHOD,
+        STRING,
+        SHAPE,
     };
 
     template <typename T>
@@ -36,6 +38,12 @@ namespace cpplox {
 
     public:
         bool isReachable = false;
+        // survived a collection, old objects stay marked between collections
+        bool isOld = false;
+        // an old object in the remembered set of the VM, see VM::writeBarrier
+        bool isRemembered = false;
+        // the next object in the nursery or the old objects of the VM
+        Object* next = nullptr;
 
     private:
         ObjectType _type;
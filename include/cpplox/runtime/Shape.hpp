@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cpplox/runtime/Object.hpp"
+#include "cpplox/core/String.hpp"
+#include "cpplox/core/Vector.hpp"
+
+namespace cpplox {
+    // The layout of the fields of an instance (a hidden class).
+    // Each class has an empty root shape. Adding a field moves an
+    // instance to the child shape reached by a transition on the field
+    // name, so instances whose fields were added in the same order share
+    // one shape. A shape maps every field name to the slot of the value
+    // in the fields of the instance.
+    // Names are interned strings and are compared by identity.
+    class Shape : public Object {
+    public:
+        static constexpr ObjectType TYPE = ObjectType::SHAPE;
+
+        Shape() : Object(Shape::TYPE) {}
+        Shape(const Shape& parent, const String* name);
+
+        void trace(gc::Visitor& v) override;
+
+        bool find(const String* name, std::size_t& slot) const;
+        std::size_t fieldCount() const { return names.getCount(); }
+
+        // the shape after adding the field name, nullptr if not yet created
+        Shape* transition(const String* name) const;
+        void addTransition(const String* name, Shape* next);
+
+    private:
+        struct Transition {
+            const String* name = nullptr;
+            Shape* next = nullptr;
+        };
+
+        // the name of the field in each slot
+        Vector<const String*> names;
+        Vector<Transition> transitions;
+    };
+} // namespace cpplox
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "cpplox/runtime/Object.hpp"
+#include "cpplox/core/String.hpp"
+#include "cpplox/core/Value.hpp"
+
+namespace cpplox {
+    // An immutable, interned string on the GC heap.
+    // Values refer to it through its String base.
+    class StringObject : public Object, public String {
+    public:
+        static constexpr ObjectType TYPE = ObjectType::STRING;
+
+        explicit StringObject(std::string_view chars);
+        explicit StringObject(String&& s);
+
+        void trace(gc::Visitor& v) override;
+
+        Value asValue() const { return Value(static_cast<const String*>(this)); }
+
+        // the object of a string Value
+        static StringObject* from(const String& s) {
+            return static_cast<StringObject*>(const_cast<String*>(&s));
+        }
+    };
+} // namespace cpplox
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "cpplox/core/Vector.hpp"
+
+#include <cstdint>
+#include <string_view>
+
+namespace cpplox {
+    class StringObject;
+    class String;
+
+    // The set of interned strings, looked up by their characters.
+    // It doesn't own the strings and doesn't keep them alive -
+    // the unreachable ones are dropped before the GC frees them.
+    class StringTable {
+    public:
+        StringTable();
+
+        StringObject* find(std::string_view chars) const;
+        StringObject* find(const String& s) const;
+        // the table must not contain an equal string
+        void insert(StringObject* s);
+        void removeUnreachable();
+
+        std::size_t size() const { return count; }
+
+    private:
+        std::size_t findSlot(std::string_view chars, std::uint32_t hash) const;
+        void growIfFillingUp();
+        void rebuild(std::size_t tableSize, bool onlyReachable);
+
+    private:
+        Vector<StringObject*> table;
+        std::size_t count = 0;
+    };
+} // namespace cpplox
@@ -0,0 +1,91 @@
+#pragma once
+
+#ifdef CPPLOX_JIT
+
+#include "cpplox/core/Vector.hpp"
+#include "cpplox/core/Value.hpp"
+#include "cpplox/vm/Stubs.hpp"
+
+#include <cstdint>
+
+namespace cpplox {
+    class VM;
+    class Function;
+
+    struct JitExit;
+    // the entry sequence of the machine code of a function, it saves
+    // the registers the code uses and jumps to target
+    using JitEntry = JitExit (*)(VM* vm, Value* slots, Value* sp, const void* target);
+
+    // The machine code of a function and the places where the interpreter
+    // can hand a frame of the function over to it.
+    struct JitCode {
+        JitEntry entry = nullptr;
+        // indexed by bytecode offset, the code of the instruction at it if
+        // execution can resume there (the start, loop starts and after calls)
+        Vector<const void*> resumePoints;
+        std::uint32_t bailOuts = 0;
+    };
+
+    // What the machine code returns when it leaves a frame: the new stack
+    // end and the instruction the interpreter continues with. A null sp
+    // means that a runtime error has been reported.
+    struct JitExit {
+        Value* sp = nullptr;
+        const std::uint8_t* ip = nullptr;
+    };
+
+    // A baseline compiler from bytecode to x86-64 machine code.
+    // The code of an instruction works on the same stack and frame
+    // layout as the interpreter, the hot operand values stay in registers
+    // only within an instruction. Calls and returns leave the machine code,
+    // the interpreter performs them and resumes the machine code of the
+    // frame it continues with. Everything which allocates, looks something
+    // up or reports an error calls back into the VM through a stub
+    // (see Stubs).
+    class Jit {
+    public:
+        explicit Jit(VM& vm);
+        ~Jit();
+
+        Jit(const Jit&) = delete;
+        Jit& operator=(const Jit&) = delete;
+
+        // sets the jitCode of f, false if some of its code can't be compiled
+        bool compile(Function& f);
+        // runs the current frame in machine code if there is code for its
+        // ip, false on a runtime error
+        bool resume();
+        // the global variable values of the code which runs next
+        void setGlobals(Value* values) { globals = values; }
+
+    private:
+        using Stub = Stubs::Stub;
+
+        // translates the bytecode of one function
+        class Generator;
+
+        struct CodeBlock {
+            std::uint8_t* memory = nullptr;
+            std::size_t size = 0;
+            std::size_t used = 0;
+        };
+
+        // the machine code left for the interpreter to run an instruction
+        // it is not specialized for, rather than to call or return
+        static bool isBailOut(const std::uint8_t* ip);
+        // drops the machine code of f, which has bailed out too often,
+        // and recompiles it only a few times as its memory is not reused
+        void drop(Function& f);
+        // copies code into executable memory, nullptr if out of memory
+        const std::uint8_t* install(const Vector<std::uint8_t>& code);
+
+    private:
+        VM& vm;
+        Vector<CodeBlock> blocks;
+        Vector<JitCode*> codes;
+        Value* globals = nullptr;
+    };
+} // namespace cpplox
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "cpplox/core/Value.hpp"
+#include "cpplox/vm/Stubs.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// A program compiled ahead of time, which the C++ source emitted by
+// `cpplox --emit-cpp` defines. Every function of it comes with its bytecode
+// and with C++ code translated from it, a block per instruction. The VM
+// builds the functions from the bytecode, which the errors, the stubs and
+// the inline caches still use, and hands their frames over to the C++ code.
+namespace cpplox {
+    // The frame of a function the VM hands over to its C++ code, which
+    // works on the same stack as the interpreter.
+    struct AotFrame {
+        VM* vm = nullptr;
+        Value* slots = nullptr;
+        // of the function the VM has built, the stubs take instructions of it
+        const std::uint8_t* code = nullptr;
+        const Value* constants = nullptr;
+        Value* globals = nullptr;
+    };
+
+    // What the C++ code returns when it leaves a frame, at a call or a
+    // return: the new stack end and the instruction the interpreter runs
+    // next. A null sp means that a runtime error has been reported.
+    struct AotExit {
+        Value* sp = nullptr;
+        const std::uint8_t* ip = nullptr;
+    };
+
+    // The C++ code of a function, which runs frame from the instruction at
+    // resumeAt (the start or right after a call) until it leaves it.
+    using AotEntry = AotExit (*)(const AotFrame& frame, Value* sp, std::size_t resumeAt);
+
+    struct ConstantImage {
+        enum class Kind : std::uint8_t {
+            NIL,
+            BOOLEAN,
+            NUMBER,
+            STRING,
+            FUNCTION,
+        };
+
+        Kind kind = Kind::NIL;
+        // 0 or 1 for a boolean, the bits of a number, the length of a
+        // string and the index of a function in the program functions
+        std::uint64_t payload = 0;
+        const char* chars = nullptr;
+    };
+
+    struct FunctionImage {
+        const char* name = nullptr;
+        unsigned arity = 0;
+        unsigned upvaluesCount = 0;
+        std::size_t maxStackSize = 0;
+        // code and lines are codeSize long
+        const std::uint8_t* code = nullptr;
+        const unsigned* lines = nullptr;
+        std::size_t codeSize = 0;
+        const ConstantImage* constants = nullptr;
+        std::size_t constantsCount = 0;
+        std::size_t propertyCachesCount = 0;
+        AotEntry entry = nullptr;
+    };
+
+    struct ProgramImage {
+        // the script comes first
+        const FunctionImage* functions = nullptr;
+        std::size_t functionsCount = 0;
+        // the global variable names, indexed by the slots the code uses
+        const char* const* globals = nullptr;
+        std::size_t globalsCount = 0;
+    };
+
+    // Runs the program in a new VM and returns the exit status the cpplox
+    // executable has for the same script.
+    int runProgram(const ProgramImage& program);
+} // namespace cpplox
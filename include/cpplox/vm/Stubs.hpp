@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cpplox/core/Value.hpp"
+
+#include <cstdint>
+
+namespace cpplox {
+    class VM;
+
+    // The slow paths of compiled code, the machine code of the JIT and the
+    // C++ code of ahead-of-time built programs. Each gets the stack end and
+    // the instruction it runs, and returns the new stack end or nullptr if
+    // it has reported a runtime error.
+    class Stubs {
+    public:
+        using Stub = Value* (*)(VM* vm, Value* sp, const std::uint8_t* ip);
+
+        static Value* numbersError(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* numberError(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* add(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* addLocals(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* addLocalConst(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* addRegisters(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* print(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* readGlobal(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* setGlobal(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* makeClosure(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* readUpvalue(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* setUpvalue(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* closeUpvalue(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* makeClass(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* method(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* inherit(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* getSuper(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* getProperty(VM* vm, Value* sp, const std::uint8_t* ip);
+        static Value* setProperty(VM* vm, Value* sp, const std::uint8_t* ip);
+
+    private:
+        static void syncState(VM& vm, Value* sp, const std::uint8_t* ip);
+    };
+} // namespace cpplox
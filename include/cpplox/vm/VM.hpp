@@ -4,6 +4,16 @@
 #include "cpplox/core/ValueMap.hpp"
 #include "cpplox/core/Vector.hpp"
 #include "cpplox/core/String.hpp"
+#include "cpplox/bytecode/Chunk.hpp"
+#include "cpplox/runtime/StringTable.hpp"
+#include "cpplox/runtime/GlobalTable.hpp"
+#include "cpplox/runtime/GC.hpp"
+#include "cpplox/vm/Jit.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 namespace cpplox {
     class Function;
@@ -11,6 +21,8 @@ namespace cpplox {
     class Object;
     class Upvalue;
     class Class;
+    class Instance;
+    class StringObject;
 
     enum class InterpretResultCode {
         OK,
@@ -23,11 +35,59 @@ namespace cpplox {
         String error = "";
     };
 
+    struct VMOptions {
+        // in number of values, the stack is never reallocated
+        std::size_t stackSize = 64 * 1024;
+        // the number of calls after which a function is compiled to
+        // machine code, when the VM is built with the JIT
+        std::size_t jitThreshold = 1000;
+        // the number of loop iterations after which a function running a
+        // loop is compiled and continues in machine code mid-loop
+        std::size_t osrThreshold = 1000;
+        // in bytes, the allocations after which the young objects are
+        // collected and the survivors promoted to the old ones
+        std::size_t nurserySize = 256 * 1024;
+        // collect the old objects in steps interleaved with the allocations,
+        // each step taking about gcPauseBudget, instead of all at once
+        bool incrementalGC = false;
+        std::chrono::microseconds gcPauseBudget{1000};
+        // mark on a background thread while the program runs, the rest of
+        // the collection is incremental
+        bool concurrentGC = false;
+    };
+
+    // the pauses of the program for the garbage collector
+    struct GCStats {
+        std::size_t pauses = 0;
+        std::chrono::nanoseconds total{0};
+        std::chrono::nanoseconds max{0};
+        std::chrono::nanoseconds p99{0};
+    };
+
     template <typename Op>
     concept NumberBinaryOp =
         requires(Op op, double a, double b, Value c) { c = op(a, b); };
 
     class VM {
+        // the JIT runs frames in machine code which calls back into the VM
+        friend class Jit;
+        // the slow paths of the machine code and of ahead-of-time built code
+        friend class Stubs;
+
+        // An incremental collection of the old objects clears their marks,
+        // marks from the roots and sweeps, a bounded amount of each at a
+        // time. The nursery is not collected while the marks are cleared
+        // or set, the objects allocated meanwhile are marked and traced
+        // like the roots. A concurrent collection marks on a thread instead,
+        // from a snapshot of the roots, the objects allocated meanwhile are
+        // marked but not traced.
+        enum class GCPhase {
+            IDLE,
+            CLEARING,
+            MARKING,
+            SWEEPING,
+        };
+
         struct CallFrame {
             Closure* closure = nullptr;
             const std::uint8_t* ip = nullptr;
@@ -35,7 +95,7 @@ namespace cpplox {
         };
 
     public:
-        VM() = default;
+        explicit VM(const VMOptions& opts = VMOptions{});
         ~VM();
 
         VM(const VM&) = delete;
@@ -43,25 +103,127 @@ namespace cpplox {
 
         InterpretResult interpret(Function* func, Vector<Object*>&& objects);
 
+        // the compiler must resolve the global names of the code this VM runs here
+        GlobalTable& globalTable() { return globals; }
+
+        GCStats gcStats() const;
+
     private:
         InterpretResultCode run();
         void addObjects(Vector<Object*>&& objects);
+        StringObject* internString(std::string_view chars);
+        StringObject* internString(String&& chars);
+        StringObject* concatenate(const String& a, const String& b);
         template <typename T, typename... Args>
         T* makeObject(Args&&... args);
         static std::size_t objectSize(Object* o);
+        // adds obj to the young objects the VM owns and collects
+        void track(Object* obj);
+        // collects the young objects only, the old objects referring to
+        // young ones are found in the remembered set
+        void collectNursery();
+        // collects all objects
         void runGC();
+        // does the next part of an incremental collection, starting one if idle
+        void stepGC();
+        // the roots of a collection, including the remembered set
         void traceGCRoots();
+        // marks the roots but not what they refer to, which queues them
+        // as gray, a snapshot of the roots a marking can go on from
+        void visitGCRoots();
+        // marks from the gray objects on markerThread, in steps if it fails to start
+        void startMarkerThread();
+        // the marking thread, traces the gray objects until there are none
+        void markConcurrently();
+        void recordPause(std::chrono::steady_clock::time_point start);
+        // frees the unreachable young objects and promotes the rest
+        void promoteNursery();
+
+        // Must follow every store of a reference into an object, but for
+        // the ones into a newly created object before anything else is
+        // allocated. A minor collection traces only the young objects,
+        // which old objects refer to only if remembered here, and an
+        // incremental one must see what is stored into the marked objects.
+        // Between collections only the old objects are marked.
+        void writeBarrier(Object* owner, const Value& stored) {
+            if (owner->isReachable && owner->isRemembered == false) {
+                storedIntoMarked(owner, stored);
+            }
+        }
+        // for stores of references which may be young
+        void writeBarrier(Object* owner) {
+            if (owner->isReachable && owner->isRemembered == false) {
+                storedIntoMarked(owner);
+            }
+        }
+        void storedIntoMarked(Object* owner, const Value& stored);
+        void storedIntoMarked(Object* owner);
+        void remember(Object* owner);
+
+        using HeapLock = std::unique_lock<std::mutex>;
+        // Must precede every store of a reference into an object, the store
+        // and its write barrier are done while the returned lock is held and
+        // nothing is allocated meanwhile. A concurrent marking traces the
+        // objects as they were when it started (snapshot at the beginning),
+        // so what a store overwrites is marked first.
+        [[nodiscard]] HeapLock beforeStore(const Value& overwritten) {
+            return markingConcurrently ? shadeOverwritten(overwritten) : HeapLock();
+        }
+        // for the stores which do more than overwrite a reference of owner,
+        // marks everything owner refers to
+        [[nodiscard]] HeapLock beforeStore(Object* owner) {
+            return markingConcurrently ? shadeReferences(owner) : HeapLock();
+        }
+        HeapLock shadeOverwritten(const Value& overwritten);
+        HeapLock shadeReferences(Object* owner);
+        // s was found in the string table, which does not keep it alive
+        void stringFound(StringObject* s);
+        // fills a property cache of the function in the top frame, its
+        // entries refer to shapes and methods
+        void fillPropertyCache(PropertyCache& cache, const PropertyCache::Entry& entry);
 
         template <NumberBinaryOp Op>
-        bool numBinaryOp(const Op& op);
+        static bool numBinaryOp(Value*& top, const Op& op);
+        // the generic ADD of the superinstructions, a and b
+        // must stay reachable if the result is allocated
+        bool addValues(const Value& a, const Value& b, Value& result);
 
-        bool invoke(const String& name, std::uint8_t argc);
-        bool invokeFromClass(Class* klass, const String& method, std::uint8_t argc);
+        bool invoke(const String& name, std::uint8_t argc, PropertyCache& cache);
+        bool invokeFromClass(Class* klass,
+                             const String& method,
+                             std::uint8_t argc,
+                             PropertyCache& cache);
         bool callValue(Value& v, std::uint8_t argc);
         bool call(Closure* f, std::uint8_t argc);
+        // calls v in place of the current frame if none of its locals is
+        // captured by an open upvalue, falls back to callValue otherwise
+        bool tailCallValue(Value& v, std::uint8_t argc);
+        bool tailCall(Closure* f, std::uint8_t argc);
+        // runs the current frame in the C++ code of its function, which an
+        // ahead-of-time built program has, false on a runtime error
+        bool resumeAot();
+        // compiles function to machine code once it has been called often enough
+        void compileIfHot(Function* function);
+        // counts a back edge of a loop in function, see compileIfHot
+        void compileIfHotLoop(Function* function);
         void printValue(const Value& v) const;
+        // push the new object, upvalues points to the upvalue descriptors
+        // of MAKE_CLOSURE and is advanced past them
+        bool makeClosure(Function* function, const std::uint8_t*& upvalues);
+        bool makeClass(const String& name);
+        // copies the methods of the superclass below the top into the
+        // subclass on the top and pops the subclass
+        bool inherit();
         void defineMethod(const String& name);
+        bool addField(Instance* inst, const String& name, const Value& value);
         bool bindMethod(Class* klass, const String& name);
+        bool bindMethod(Closure* method);
+        // the uncached property accesses, which fill the cache of the site
+        bool getProperty(Instance* inst, const String& name, PropertyCache& cache);
+        bool setProperty(Instance* inst,
+                         const String& name,
+                         const Value& value,
+                         PropertyCache& cache);
 
         Upvalue* captureUpvalue(std::size_t offset);
         void closeUpvalues(std::size_t offset);
@@ -72,13 +234,47 @@ namespace cpplox {
 
     private:
         ValueStack stack;
-        ValueMap globals;
+        GlobalTable globals;
         Vector<CallFrame> frames;
-        Vector<Object*> gcObjects;
+        // the heads of the intrusive lists of the young and the old
+        // objects, linked by Object::next
+        Object* nursery = nullptr;
+        Object* nurseryTail = nullptr;
+        Object* oldObjects = nullptr;
+        // the old objects which may refer to young ones
+        Vector<Object*> rememberedSet;
+        gc::Marker marker;
         std::uint64_t bytesAllocated = 0;
         std::uint64_t nextGC = 1024 * 1024;
+        std::uint64_t nurseryBytes = 0;
+        std::uint64_t nurserySize = 0;
+        bool incrementalGC = false;
+        bool concurrentGC = false;
+        std::chrono::nanoseconds gcPauseBudget{0};
+        GCPhase gcPhase = GCPhase::IDLE;
+        // the marking runs on markerThread, which sets markerDone once it
+        // runs out of gray objects, the marker is shared under heapMutex
+        bool markingConcurrently = false;
+        std::thread markerThread;
+        std::atomic<bool> markerDone = false;
+        std::mutex heapMutex;
+        // the next old object to clear and the link to the next one to sweep
+        Object* clearCursor = nullptr;
+        Object** sweepCursor = nullptr;
+        std::uint64_t bytesSinceGCStep = 0;
+        Vector<std::chrono::nanoseconds> gcPauses;
         Upvalue* openUpvalues = nullptr;
+        StringTable strings;
+        StringObject* initString = nullptr;
         String error = "";
-        String classInitKey = "init";
+#ifdef CPPLOX_DEBUG_TRACE_EXECUTION
+        // the instructions the interpreter has run, machine code not included
+        std::uint64_t executedInstructions = 0;
+#endif
+#ifdef CPPLOX_JIT
+        std::size_t jitThreshold = 0;
+        std::size_t osrThreshold = 0;
+        Jit jit;
+#endif
     };
 } // namespace cpplox
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "cpplox/core/Vector.hpp"
+
+#include <cstdint>
+
+namespace cpplox::x64 {
+    enum class Reg : std::uint8_t {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8, R9, R10, R11, R12, R13, R14, R15,
+    };
+
+    enum class Xmm : std::uint8_t {
+        XMM0, XMM1,
+    };
+
+    // the condition codes of jcc and setcc
+    enum class Cond : std::uint8_t {
+        B = 0x2,  // below (CF = 1)
+        AE = 0x3, // above or equal (CF = 0)
+        E = 0x4,
+        NE = 0x5,
+        BE = 0x6, // below or equal (CF = 1 or ZF = 1)
+        A = 0x7,  // above (CF = 0 and ZF = 0)
+        NP = 0xB, // not parity, the operands of ucomisd were ordered
+    };
+
+    struct Label {
+        std::size_t id = 0;
+    };
+
+    // Encodes the handful of x86-64 instructions the JIT emits into a
+    // byte buffer. All integer operations are 64-bit, all jumps take a
+    // 32-bit displacement, which is patched once their label is bound.
+    class Assembler {
+    public:
+        Label newLabel();
+        void bind(Label label);
+        // the offset of a bound label from the start of the code
+        std::size_t offsetOf(Label label) const { return labels[label.id]; }
+
+        // resolves the jumps, false if one of their labels is not bound
+        bool finish();
+        const Vector<std::uint8_t>& code() const { return buffer; }
+        std::size_t size() const { return buffer.getCount(); }
+
+        void push(Reg r);
+        void pop(Reg r);
+        void ret();
+
+        void mov(Reg dst, Reg src);
+        void mov(Reg dst, std::uint64_t imm);
+        // dst = [base + disp]
+        void load(Reg dst, Reg base, std::int32_t disp);
+        // [base + disp] = src
+        void store(Reg base, std::int32_t disp, Reg src);
+
+        void add(Reg dst, Reg src);
+        void add(Reg dst, std::int32_t imm);
+        void sub(Reg dst, Reg src);
+        void sub(Reg dst, std::int32_t imm);
+        void and_(Reg dst, Reg src);
+        void xor_(Reg dst, Reg src);
+        void xor_(Reg dst, std::int32_t imm);
+        void cmp(Reg a, Reg b);
+        void cmp(Reg a, std::int32_t imm);
+        void test(Reg a, Reg b);
+        // complements bit of r
+        void btc(Reg r, std::uint8_t bit);
+        // dst = cond ? 1 : 0, for the registers with a low byte
+        // addressable without a REX prefix (rax, rcx, rdx and rbx)
+        void set(Cond cond, Reg dst);
+
+        void movq(Xmm dst, Reg src);
+        void movq(Reg dst, Xmm src);
+        void addsd(Xmm dst, Xmm src);
+        void subsd(Xmm dst, Xmm src);
+        void mulsd(Xmm dst, Xmm src);
+        void divsd(Xmm dst, Xmm src);
+        void ucomisd(Xmm a, Xmm b);
+
+        void jmp(Label target);
+        void jcc(Cond cond, Label target);
+        void jmp(Reg target);
+        void call(Reg target);
+
+    private:
+        void emit(std::uint8_t byte);
+        void emit32(std::uint32_t value);
+        void emit64(std::uint64_t value);
+        // REX.W with the extension bits of reg and rm
+        void rexW(std::uint8_t reg, std::uint8_t rm);
+        void modRM(std::uint8_t mod, std::uint8_t reg, std::uint8_t rm);
+        // the ModRM (and SIB) byte and the displacement of [base + disp]
+        void memory(std::uint8_t reg, Reg base, std::int32_t disp);
+        // op r/m64, r64
+        void aluRR(std::uint8_t opcode, Reg dst, Reg src);
+        // op r/m64, imm with the opcode extension ext
+        void aluRI(std::uint8_t ext, Reg dst, std::int32_t imm);
+        // an SSE2 scalar double operation between xmm registers
+        void sse(std::uint8_t prefix, std::uint8_t opcode, Xmm dst, Xmm src);
+        void jump(Label target);
+
+    private:
+        static constexpr std::size_t UNBOUND = static_cast<std::size_t>(-1);
+
+        struct Fixup {
+            // where the 32-bit displacement is, it is relative to the end of it
+            std::size_t at = 0;
+            Label target;
+        };
+
+        Vector<std::uint8_t> buffer;
+        Vector<std::size_t> labels;
+        Vector<Fixup> fixups;
+    };
+} // namespace cpplox::x64
@@ -1,4 +1,5 @@
 #include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
 
 namespace cpplox {
     bool fitsOneByte(std::size_t i) {
@@ -20,6 +21,19 @@ namespace cpplox {
         return i;
     }
 
+    bool fitsRK(std::size_t i) {
+        return i < static_cast<std::size_t>(RK_CONSTANT);
+    }
+
+    std::size_t operandOf(const std::uint8_t* ip, OpCode shortForm) {
+        return static_cast<OpCode>(ip[0]) == shortForm ? ip[1]
+                                                       : parseTwoByteInteger(ip[1], ip[2]);
+    }
+
+    std::size_t operandEnd(const std::uint8_t* ip, OpCode shortForm) {
+        return static_cast<OpCode>(ip[0]) == shortForm ? 2 : 3;
+    }
+
     void addCode(Chunk& chunk, std::uint8_t c, unsigned l) {
         chunk.code.insertBack(c);
         chunk.lines.insertBack(l);
@@ -29,4 +43,294 @@ namespace cpplox {
         chunk.constants.insertBack(std::move(v));
         return chunk.constants.getCount() - 1;
     }
-}
\ No newline at end of file
+
+    std::size_t addPropertyCache(Chunk& chunk) {
+        chunk.propertyCaches.insertBack(PropertyCache{});
+        return chunk.propertyCaches.getCount() - 1;
+    }
+
+    bool isJump(OpCode op) {
+        return op == OpCode::JMP || op == OpCode::LOOP || isConditionalJump(op);
+    }
+
+    bool isConditionalJump(OpCode op) {
+        switch (op) {
+            case OpCode::JMP_IF_FALSE:
+            case OpCode::POP_JMP_IF_FALSE:
+            case OpCode::POP_JMP_IF_TRUE:
+            case OpCode::JMP_IF_NOT_LESS:
+            case OpCode::JMP_IF_NOT_LESS_EQUAL:
+            case OpCode::JMP_IF_NOT_GREATER:
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL:
+            case OpCode::JMP_IF_NOT_LESS_RK:
+            case OpCode::JMP_IF_NOT_LESS_EQUAL_RK:
+            case OpCode::JMP_IF_NOT_GREATER_RK:
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL_RK: {
+                return true;
+            } break;
+            default: {
+                return false;
+            } break;
+        }
+    }
+
+    std::size_t instructionLength(const Chunk& chunk, std::size_t offset) {
+        const auto op = static_cast<OpCode>(chunk.code[offset]);
+        switch (op) {
+            case OpCode::CONSTANT:
+            case OpCode::DEFINE_GLOBAL:
+            case OpCode::READ_GLOBAL:
+            case OpCode::SET_GLOBAL:
+            case OpCode::READ_LOCAL:
+            case OpCode::SET_LOCAL:
+            case OpCode::SET_LOCAL_POP:
+            case OpCode::POP_N:
+            case OpCode::CALL:
+            case OpCode::TAIL_CALL:
+            case OpCode::READ_UPVALUE:
+            case OpCode::SET_UPVALUE:
+            case OpCode::MAKE_CLASS:
+            case OpCode::METHOD:
+            case OpCode::GET_SUPER: {
+                return 2;
+            } break;
+            case OpCode::CONSTANT_16:
+            case OpCode::DEFINE_GLOBAL_16:
+            case OpCode::READ_GLOBAL_16:
+            case OpCode::SET_GLOBAL_16:
+            case OpCode::READ_LOCAL_16:
+            case OpCode::SET_LOCAL_16:
+            case OpCode::POP_N_16:
+            case OpCode::JMP_IF_FALSE:
+            case OpCode::POP_JMP_IF_FALSE:
+            case OpCode::POP_JMP_IF_TRUE:
+            case OpCode::JMP_IF_NOT_LESS:
+            case OpCode::JMP_IF_NOT_LESS_EQUAL:
+            case OpCode::JMP_IF_NOT_GREATER:
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL:
+            case OpCode::JMP:
+            case OpCode::LOOP:
+            case OpCode::MAKE_CLASS_16:
+            case OpCode::METHOD_16:
+            case OpCode::ADD_LOCALS:
+            case OpCode::LESS_LOCALS:
+            case OpCode::ADD_LOCAL_CONST:
+            case OpCode::SUBTRACT_LOCAL_CONST:
+            case OpCode::LESS_LOCAL_CONST:
+            case OpCode::GET_SUPER_16:
+            case OpCode::MOVE: {
+                return 3;
+            } break;
+            // the destination and two sources
+            case OpCode::ADD_RK:
+            case OpCode::SUBTRACT_RK:
+            case OpCode::MULTIPLY_RK:
+            case OpCode::DIVIDE_RK: {
+                return 4;
+            } break;
+            // the jump offset and two sources
+            case OpCode::JMP_IF_NOT_LESS_RK:
+            case OpCode::JMP_IF_NOT_LESS_EQUAL_RK:
+            case OpCode::JMP_IF_NOT_GREATER_RK:
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL_RK: {
+                return 5;
+            } break;
+            // the name and a two-byte cache index
+            case OpCode::SET_PROPERTY:
+            case OpCode::GET_PROPERTY: {
+                return 4;
+            } break;
+            case OpCode::SET_PROPERTY_16:
+            case OpCode::GET_PROPERTY_16: {
+                return 5;
+            } break;
+            // the name, the argument count and a two-byte cache index
+            case OpCode::INVOKE:
+            case OpCode::SUPER_INVOKE: {
+                return 5;
+            } break;
+            case OpCode::INVOKE_16:
+            case OpCode::SUPER_INVOKE_16: {
+                return 6;
+            } break;
+            case OpCode::MAKE_CLOSURE:
+            case OpCode::MAKE_CLOSURE_16: {
+                std::size_t end = offset + (op == OpCode::MAKE_CLOSURE ? 2 : 3);
+                const std::uint8_t count = chunk.code[end++];
+                for (std::uint8_t i = 0; i < count; ++i) {
+                    // a local upvalue has a two-byte index, an enclosing one - a single byte
+                    end += chunk.code[end] == 1 ? 3 : 2;
+                }
+                return end - offset;
+            } break;
+            default: {
+                return 1;
+            } break;
+        }
+    }
+
+    namespace {
+        // the net number of values an instruction pushes (positive)
+        // or pops (negative), calls included
+        long stackEffect(const Chunk& chunk, std::size_t offset) {
+            const auto op = static_cast<OpCode>(chunk.code[offset]);
+            const auto operand8 = [&chunk, offset] {
+                return static_cast<long>(chunk.code[offset + 1]);
+            };
+            const auto operand16 = [&chunk, offset] {
+                return static_cast<long>(parseTwoByteInteger(chunk.code[offset + 1],
+                                                             chunk.code[offset + 2]));
+            };
+
+            switch (op) {
+                case OpCode::CONSTANT:
+                case OpCode::CONSTANT_16:
+                case OpCode::NIL:
+                case OpCode::TRUE:
+                case OpCode::FALSE:
+                case OpCode::READ_GLOBAL:
+                case OpCode::READ_GLOBAL_16:
+                case OpCode::READ_LOCAL:
+                case OpCode::READ_LOCAL_16:
+                case OpCode::READ_UPVALUE:
+                case OpCode::MAKE_CLOSURE:
+                case OpCode::MAKE_CLOSURE_16:
+                case OpCode::MAKE_CLASS:
+                case OpCode::MAKE_CLASS_16:
+                case OpCode::ADD_LOCALS:
+                case OpCode::LESS_LOCALS:
+                case OpCode::ADD_LOCAL_CONST:
+                case OpCode::SUBTRACT_LOCAL_CONST:
+                case OpCode::LESS_LOCAL_CONST: {
+                    return 1;
+                } break;
+                case OpCode::EQUAL:
+                case OpCode::NOT_EQUAL:
+                case OpCode::LESS:
+                case OpCode::LESS_EQUAL:
+                case OpCode::GREATER:
+                case OpCode::GREATER_EQUAL:
+                case OpCode::ADD:
+                case OpCode::ADD_NUM:
+                case OpCode::ADD_STR:
+                case OpCode::SUBTRACT:
+                case OpCode::MULTIPLY:
+                case OpCode::DIVIDE:
+                case OpCode::PRINT:
+                case OpCode::POP:
+                case OpCode::DEFINE_GLOBAL:
+                case OpCode::DEFINE_GLOBAL_16:
+                case OpCode::CLOSE_UPVALUE:
+                case OpCode::SET_PROPERTY:
+                case OpCode::SET_PROPERTY_16:
+                case OpCode::METHOD:
+                case OpCode::METHOD_16:
+                case OpCode::INHERIT:
+                case OpCode::GET_SUPER:
+                case OpCode::GET_SUPER_16:
+                case OpCode::POP_JMP_IF_FALSE:
+                case OpCode::POP_JMP_IF_TRUE:
+                case OpCode::SET_LOCAL_POP:
+                case OpCode::RETURN: {
+                    return -1;
+                } break;
+                case OpCode::JMP_IF_NOT_LESS:
+                case OpCode::JMP_IF_NOT_LESS_EQUAL:
+                case OpCode::JMP_IF_NOT_GREATER:
+                case OpCode::JMP_IF_NOT_GREATER_EQUAL: {
+                    return -2;
+                } break;
+                case OpCode::POP_N: {
+                    return -operand8();
+                } break;
+                case OpCode::POP_N_16: {
+                    return -operand16();
+                } break;
+                case OpCode::CALL:
+                case OpCode::TAIL_CALL: {
+                    // the callee and the arguments are replaced by the result
+                    return -operand8();
+                } break;
+                case OpCode::INVOKE: {
+                    return -static_cast<long>(chunk.code[offset + 2]);
+                } break;
+                case OpCode::INVOKE_16: {
+                    return -static_cast<long>(chunk.code[offset + 3]);
+                } break;
+                case OpCode::SUPER_INVOKE: {
+                    // the superclass is popped as well
+                    return -static_cast<long>(chunk.code[offset + 2]) - 1;
+                } break;
+                case OpCode::SUPER_INVOKE_16: {
+                    return -static_cast<long>(chunk.code[offset + 3]) - 1;
+                } break;
+                default: {
+                    return 0;
+                } break;
+            }
+        }
+    } // namespace
+
+    std::size_t maxStackDepth(const Chunk& chunk, std::size_t initialDepth) {
+        const std::size_t codeSize = chunk.code.getCount();
+        if (codeSize == 0) {
+            return initialDepth;
+        }
+
+        // the compiler keeps the stack balanced on every path, so each
+        // reachable instruction is entered with a single known depth
+        Vector<long> depthAt(codeSize);
+        Vector<bool> visited(codeSize);
+        Vector<std::size_t> worklist;
+        worklist.reserve(16);
+
+        long maxDepth = static_cast<long>(initialDepth);
+        const auto enqueue = [&](std::size_t target, long depth) {
+            if (target < codeSize && visited[target] == false) {
+                visited[target] = true;
+                depthAt[target] = depth;
+                worklist.insertBack(target);
+            }
+        };
+
+        enqueue(0, static_cast<long>(initialDepth));
+        while (worklist.isEmpty() == false) {
+            std::size_t offset = worklist.back();
+            worklist.removeBack();
+            long depth = depthAt[offset];
+
+            // walk the straight-line code until it ends or joins a visited path
+            while (offset < codeSize) {
+                const auto op = static_cast<OpCode>(chunk.code[offset]);
+                const std::size_t next = offset + instructionLength(chunk, offset);
+
+                depth += stackEffect(chunk, offset);
+                if (depth > maxDepth) {
+                    maxDepth = depth;
+                }
+
+                if (op == OpCode::RETURN) {
+                    break;
+                }
+                if (isJump(op)) {
+                    const std::size_t jump = parseTwoByteInteger(chunk.code[offset + 1],
+                                                                 chunk.code[offset + 2]);
+                    const std::size_t target = op == OpCode::LOOP ? next - jump : next + jump;
+                    enqueue(target, depth);
+                    if (isConditionalJump(op) == false) {
+                        break;
+                    }
+                }
+
+                if (next >= codeSize || visited[next]) {
+                    break;
+                }
+                visited[next] = true;
+                depthAt[next] = depth;
+                offset = next;
+            }
+        }
+
+        return static_cast<std::size_t>(maxDepth);
+    }
+} // namespace cpplox
@@ -4,6 +4,8 @@
 #include "cpplox/core/ValueFormatter.hpp"
 #include "cpplox/log/Log.hpp"
 
+#include <fmt/format.h>
+
 namespace cpplox {
     void Disassembler::disassembleChunk(const Chunk& chunk,
                                         const std::string_view& name) const {
@@ -35,6 +37,27 @@ namespace cpplox {
             case OpCode::ADD: {
                 return simpleInstruction("ADD", offset);
             } break;
+            case OpCode::ADD_NUM: {
+                return simpleInstruction("ADD_NUM", offset);
+            } break;
+            case OpCode::ADD_STR: {
+                return simpleInstruction("ADD_STR", offset);
+            } break;
+            case OpCode::ADD_LOCALS: {
+                return localsInstruction("ADD_LOCALS", chunk, offset);
+            } break;
+            case OpCode::LESS_LOCALS: {
+                return localsInstruction("LESS_LOCALS", chunk, offset);
+            } break;
+            case OpCode::ADD_LOCAL_CONST: {
+                return localConstantInstruction("ADD_LOCAL_CONST", chunk, offset);
+            } break;
+            case OpCode::SUBTRACT_LOCAL_CONST: {
+                return localConstantInstruction("SUBTRACT_LOCAL_CONST", chunk, offset);
+            } break;
+            case OpCode::LESS_LOCAL_CONST: {
+                return localConstantInstruction("LESS_LOCAL_CONST", chunk, offset);
+            } break;
             case OpCode::SUBTRACT: {
                 return simpleInstruction("SUBTRACT", offset);
             } break;
@@ -78,22 +101,22 @@ namespace cpplox {
                 return constant16Instruction("CONSTANT_16", chunk, offset);
             } break;
             case OpCode::DEFINE_GLOBAL: {
-                return constantInstruction("DEFINE_GLOBAL", chunk, offset);
+                return integerInstruction("DEFINE_GLOBAL", chunk, offset);
             } break;
             case OpCode::DEFINE_GLOBAL_16: {
-                return constant16Instruction("DEFINE_GLOBAL_16", chunk, offset);
+                return integer16Instruction("DEFINE_GLOBAL_16", chunk, offset);
             } break;
             case OpCode::READ_GLOBAL: {
-                return constantInstruction("READ_GLOBAL", chunk, offset);
+                return integerInstruction("READ_GLOBAL", chunk, offset);
             } break;
             case OpCode::READ_GLOBAL_16: {
-                return constant16Instruction("READ_GLOBAL_16", chunk, offset);
+                return integer16Instruction("READ_GLOBAL_16", chunk, offset);
             } break;
             case OpCode::SET_GLOBAL: {
-                return constantInstruction("SET_GLOBAL", chunk, offset);
+                return integerInstruction("SET_GLOBAL", chunk, offset);
             } break;
             case OpCode::SET_GLOBAL_16: {
-                return constant16Instruction("SET_GLOBAL_16", chunk, offset);
+                return integer16Instruction("SET_GLOBAL_16", chunk, offset);
             } break;
             case OpCode::READ_LOCAL: {
                 return integerInstruction("READ_LOCAL", chunk, offset);
@@ -107,6 +130,9 @@ namespace cpplox {
             case OpCode::SET_LOCAL_16: {
                 return integer16Instruction("SET_LOCAL_16", chunk, offset);
             } break;
+            case OpCode::SET_LOCAL_POP: {
+                return integerInstruction("SET_LOCAL_POP", chunk, offset);
+            } break;
             case OpCode::TRUE: {
                 return simpleInstruction("TRUE", offset);
             } break;
@@ -134,12 +160,33 @@ namespace cpplox {
             case OpCode::JMP_IF_FALSE: {
                 return integer16Instruction("JMP_IF_FALSE", chunk, offset);
             } break;
+            case OpCode::POP_JMP_IF_FALSE: {
+                return integer16Instruction("POP_JMP_IF_FALSE", chunk, offset);
+            } break;
+            case OpCode::POP_JMP_IF_TRUE: {
+                return integer16Instruction("POP_JMP_IF_TRUE", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_LESS: {
+                return integer16Instruction("JMP_IF_NOT_LESS", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_LESS_EQUAL: {
+                return integer16Instruction("JMP_IF_NOT_LESS_EQUAL", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_GREATER: {
+                return integer16Instruction("JMP_IF_NOT_GREATER", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL: {
+                return integer16Instruction("JMP_IF_NOT_GREATER_EQUAL", chunk, offset);
+            } break;
             case OpCode::LOOP: {
                 return integer16Instruction("LOOP", chunk, offset);
             } break;
             case OpCode::CALL: {
                 return integerInstruction("CALL", chunk, offset);
             } break;
+            case OpCode::TAIL_CALL: {
+                return integerInstruction("TAIL_CALL", chunk, offset);
+            } break;
             case OpCode::MAKE_CLOSURE: {
                 const auto constant = chunk.code[offset + 1];
                 printConstantInstruction("MAKE_CLOSURE", chunk, constant);
@@ -169,16 +216,16 @@ namespace cpplox {
                 return constant16Instruction("MAKE_CLASS_16", chunk, offset);
             } break;
             case OpCode::SET_PROPERTY: {
-                return constantInstruction("SET_PROPERTY", chunk, offset);
+                return propertyInstruction("SET_PROPERTY", chunk, offset);
             } break;
             case OpCode::SET_PROPERTY_16: {
-                return constant16Instruction("SET_PROPERTY_16", chunk, offset);
+                return property16Instruction("SET_PROPERTY_16", chunk, offset);
             } break;
             case OpCode::GET_PROPERTY: {
-                return constantInstruction("GET_PROPERTY", chunk, offset);
+                return propertyInstruction("GET_PROPERTY", chunk, offset);
             } break;
             case OpCode::GET_PROPERTY_16: {
-                return constant16Instruction("GET_PROPERTY_16", chunk, offset);
+                return property16Instruction("GET_PROPERTY_16", chunk, offset);
             } break;
             case OpCode::METHOD: {
                 return constantInstruction("METHOD", chunk, offset);
@@ -207,6 +254,37 @@ namespace cpplox {
             case OpCode::SUPER_INVOKE_16: {
                 return invoke16Instruction("SUPER_INVOKE_16", chunk, offset);
             } break;
+            case OpCode::MOVE: {
+                println("{:<16} {:>5} {}",
+                        "MOVE",
+                        chunk.code[offset + 1],
+                        registerOperand(chunk, chunk.code[offset + 2]));
+                return offset + 3;
+            } break;
+            case OpCode::ADD_RK: {
+                return registerInstruction("ADD_RK", chunk, offset);
+            } break;
+            case OpCode::SUBTRACT_RK: {
+                return registerInstruction("SUBTRACT_RK", chunk, offset);
+            } break;
+            case OpCode::MULTIPLY_RK: {
+                return registerInstruction("MULTIPLY_RK", chunk, offset);
+            } break;
+            case OpCode::DIVIDE_RK: {
+                return registerInstruction("DIVIDE_RK", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_LESS_RK: {
+                return registerJumpInstruction("JMP_IF_NOT_LESS_RK", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_LESS_EQUAL_RK: {
+                return registerJumpInstruction("JMP_IF_NOT_LESS_EQUAL_RK", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_GREATER_RK: {
+                return registerJumpInstruction("JMP_IF_NOT_GREATER_RK", chunk, offset);
+            } break;
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL_RK: {
+                return registerJumpInstruction("JMP_IF_NOT_GREATER_EQUAL_RK", chunk, offset);
+            } break;
             default: {
                 println("Unknown opcode '{}'",
                         static_cast<std::uint8_t>(opCode));
@@ -276,12 +354,14 @@ namespace cpplox {
     void Disassembler::printInvokeInstruction(const char* name,
                                               std::size_t constant,
                                               std::size_t argc,
+                                              std::size_t cache,
                                               const Chunk& chunk) const {
-        println("{:<16} {:<5} {:>5} '{}'",
+        println("{:<16} {:<5} {:>5} '{}' (cache {})",
                 name,
                 constant,
                 argc,
-                chunk.constants[constant]);
+                chunk.constants[constant],
+                cache);
     }
 
     std::size_t Disassembler::invokeInstruction(const char* name,
@@ -289,8 +369,10 @@ namespace cpplox {
                                                 std::size_t offset) const {
         const auto constant = chunk.code[offset + 1];
         const auto count = chunk.code[offset + 2];
-        printInvokeInstruction(name, constant, count, chunk);
-        return offset + 3;
+        const auto cache = parseTwoByteInteger(chunk.code[offset + 3],
+                                               chunk.code[offset + 4]);
+        printInvokeInstruction(name, constant, count, cache, chunk);
+        return offset + 5;
     }
 
     std::size_t Disassembler::invoke16Instruction(const char* name,
@@ -300,10 +382,96 @@ namespace cpplox {
         const auto b = chunk.code[offset + 2];
         const auto constant = parseTwoByteInteger(a, b);
         const auto count = chunk.code[offset + 3];
-        printInvokeInstruction(name, constant, count, chunk);
+        const auto cache = parseTwoByteInteger(chunk.code[offset + 4],
+                                               chunk.code[offset + 5]);
+        printInvokeInstruction(name, constant, count, cache, chunk);
+        return offset + 6;
+    }
+
+    std::size_t Disassembler::propertyInstruction(const char* name,
+                                                  const Chunk& chunk,
+                                                  std::size_t offset) const {
+        const auto constant = chunk.code[offset + 1];
+        const auto cache = parseTwoByteInteger(chunk.code[offset + 2],
+                                               chunk.code[offset + 3]);
+        printPropertyInstruction(name, constant, cache, chunk);
         return offset + 4;
     }
 
+    std::size_t Disassembler::property16Instruction(const char* name,
+                                                    const Chunk& chunk,
+                                                    std::size_t offset) const {
+        const auto constant = parseTwoByteInteger(chunk.code[offset + 1],
+                                                  chunk.code[offset + 2]);
+        const auto cache = parseTwoByteInteger(chunk.code[offset + 3],
+                                               chunk.code[offset + 4]);
+        printPropertyInstruction(name, constant, cache, chunk);
+        return offset + 5;
+    }
+
+    void Disassembler::printPropertyInstruction(const char* name,
+                                                std::size_t constant,
+                                                std::size_t cache,
+                                                const Chunk& chunk) const {
+        println("{:<16} {:>5} '{}' (cache {})",
+                name,
+                constant,
+                chunk.constants[constant],
+                cache);
+    }
+
+    std::size_t Disassembler::localsInstruction(const char* name,
+                                                const Chunk& chunk,
+                                                std::size_t offset) const {
+        println("{:<16} {:>5} {:>5}",
+                name,
+                chunk.code[offset + 1],
+                chunk.code[offset + 2]);
+        return offset + 3;
+    }
+
+    std::size_t Disassembler::localConstantInstruction(const char* name,
+                                                       const Chunk& chunk,
+                                                       std::size_t offset) const {
+        const auto constant = chunk.code[offset + 2];
+        println("{:<16} {:>5} {:>5} '{}'",
+                name,
+                chunk.code[offset + 1],
+                constant,
+                chunk.constants[constant]);
+        return offset + 3;
+    }
+
+    std::string Disassembler::registerOperand(const Chunk& chunk, std::uint8_t rk) const {
+        if ((rk & RK_CONSTANT) == 0) {
+            return fmt::format("r{}", rk);
+        }
+        const std::size_t constant = rk & ~RK_CONSTANT;
+        return fmt::format("k{} '{}'", constant, chunk.constants[constant]);
+    }
+
+    std::size_t Disassembler::registerInstruction(const char* name,
+                                                  const Chunk& chunk,
+                                                  std::size_t offset) const {
+        println("{:<16} {:>5} {} {}",
+                name,
+                chunk.code[offset + 1],
+                registerOperand(chunk, chunk.code[offset + 2]),
+                registerOperand(chunk, chunk.code[offset + 3]));
+        return offset + 4;
+    }
+
+    std::size_t Disassembler::registerJumpInstruction(const char* name,
+                                                      const Chunk& chunk,
+                                                      std::size_t offset) const {
+        println("{:<16} {:>5} {} {}",
+                name,
+                parseTwoByteInteger(chunk.code[offset + 1], chunk.code[offset + 2]),
+                registerOperand(chunk, chunk.code[offset + 3]),
+                registerOperand(chunk, chunk.code[offset + 4]));
+        return offset + 5;
+    }
+
     std::size_t Disassembler::closureUpvalues(const Chunk& chunk,
                                               std::size_t offset) const {
         const std::uint8_t count = chunk.code[offset++];
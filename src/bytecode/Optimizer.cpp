@@ -0,0 +1,568 @@
+#include "cpplox/bytecode/Optimizer.hpp"
+#include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace cpplox {
+    namespace {
+        // one rewrite can expose another, e.g. removing dead code can
+        // leave a jump to the next instruction behind
+        constexpr std::size_t MAX_PASSES = 4;
+
+        struct Instruction {
+            // where the instruction starts in the code being rewritten
+            std::size_t offset = 0;
+            std::size_t length = 0;
+            OpCode op = OpCode::RETURN;
+            // for jumps, the index of the instruction they land on,
+            // the instruction count if they land past the end
+            std::size_t target = 0;
+            bool isJumpTarget = false;
+            bool removed = false;
+            // an instruction replaced by one with other operands, which are
+            // laid out from operands rather than copied from the old code
+            // (the bytes of the jump offset of a jump are left unused)
+            bool replaced = false;
+            std::uint8_t operands[4] = {};
+        };
+
+        // The instructions of a chunk, decoded once. The rewrites change
+        // opcodes, operands and jump targets or remove instructions, and
+        // the code is laid out again at the end. A sequence is never fused
+        // if a jump lands in the middle of it.
+        class Rewriter {
+        public:
+            explicit Rewriter(Chunk& chunk)
+                : chunk(chunk)
+            {}
+
+        protected:
+            void decode();
+            void rewrite();
+
+            // the first instruction at or after i which is not removed,
+            // a removed instruction does nothing, so jumps to it land there
+            std::size_t live(std::size_t i) const;
+            std::size_t nextLive(std::size_t i) const { return live(i + 1); }
+            void remove(std::size_t i);
+
+        protected:
+            Chunk& chunk;
+            Vector<Instruction> instructions;
+            bool changed = false;
+        };
+
+        // A single pass of rewrites of short instruction sequences.
+        class Peephole : public Rewriter {
+        public:
+            using Rewriter::Rewriter;
+
+            // true if the code has changed
+            bool run();
+
+        private:
+            void threadJumps();
+            void fuseSequences();
+            void removeUnreachable();
+            void removeJumpsToNext();
+
+            bool fallsThrough(OpCode op) const;
+            bool fitsJump(std::size_t from, std::size_t to) const;
+        };
+
+        // Replaces the stack code of moves, arithmetic and comparisons
+        // between locals and constants with register instructions, e.g.
+        // READ_LOCAL b, READ_LOCAL c, ADD, SET_LOCAL_POP a with ADD_RK a b c.
+        // Each replaced sequence leaves the stack as it has found it, so the
+        // code around it runs as before. The code only shrinks.
+        class RegisterAllocator : public Rewriter {
+        public:
+            using Rewriter::Rewriter;
+
+            void run();
+
+        private:
+            // the register instruction a sequence starting at i is replaced
+            // with, false if there is none
+            bool binaryOp(std::size_t i);
+            bool compareJump(std::size_t i);
+            bool fusedBinaryOp(std::size_t i);
+            bool fusedCompareJump(std::size_t i);
+            bool move(std::size_t i);
+
+            // the register operand of an instruction which
+            // pushes a local or a constant, false if it is none
+            bool source(std::size_t i, std::uint8_t& rk) const;
+            // the register of the instructions at i which pop the top into
+            // a local, false if there are none, last is the final one
+            bool sink(std::size_t i, std::uint8_t& dst, std::size_t& last) const;
+            // the instructions after i up to last are not jump targets
+            bool straightLine(std::size_t i, std::size_t last) const;
+            void replace(std::size_t first,
+                         std::size_t last,
+                         OpCode op,
+                         std::initializer_list<std::uint8_t> operands);
+        };
+
+        bool Peephole::run() {
+            decode();
+            threadJumps();
+            fuseSequences();
+            removeUnreachable();
+            removeJumpsToNext();
+            if (changed) {
+                rewrite();
+            }
+            return changed;
+        }
+
+        void Rewriter::decode() {
+            const std::size_t codeSize = chunk.code.getCount();
+            Vector<std::size_t> indexAt(codeSize + 1);
+
+            for (std::size_t offset = 0; offset < codeSize;) {
+                Instruction inst;
+                inst.offset = offset;
+                inst.length = instructionLength(chunk, offset);
+                inst.op = static_cast<OpCode>(chunk.code[offset]);
+                indexAt[offset] = instructions.getCount();
+                instructions.insertBack(inst);
+                offset += inst.length;
+            }
+            indexAt[codeSize] = instructions.getCount();
+
+            for (std::size_t i = 0; i < instructions.getCount(); ++i) {
+                Instruction& inst = instructions[i];
+                if (isJump(inst.op) == false) {
+                    continue;
+                }
+                const std::size_t next = inst.offset + inst.length;
+                const std::size_t jump = parseTwoByteInteger(chunk.code[inst.offset + 1],
+                                                             chunk.code[inst.offset + 2]);
+                inst.target = indexAt[inst.op == OpCode::LOOP ? next - jump : next + jump];
+                if (inst.target < instructions.getCount()) {
+                    instructions[inst.target].isJumpTarget = true;
+                }
+            }
+        }
+
+        // A jump to a JMP or a LOOP goes straight to where that one leads.
+        // Conditional jumps can only go forward.
+        void Peephole::threadJumps() {
+            const std::size_t count = instructions.getCount();
+            for (std::size_t i = 0; i < count; ++i) {
+                Instruction& inst = instructions[i];
+                if (inst.removed || isJump(inst.op) == false) {
+                    continue;
+                }
+
+                const std::size_t target = live(inst.target);
+                std::size_t final = target;
+                // a cycle of jumps is an infinite loop, bound the walk
+                for (std::size_t steps = 0; steps < count && final < count; ++steps) {
+                    const OpCode op = instructions[final].op;
+                    if (op != OpCode::JMP && op != OpCode::LOOP) {
+                        break;
+                    }
+                    final = live(instructions[final].target);
+                }
+
+                if (final == target || final == i || fitsJump(i, final) == false) {
+                    continue;
+                }
+                if (isConditionalJump(inst.op) && final < i) {
+                    continue;
+                }
+                inst.target = final;
+                changed = true;
+            }
+        }
+
+        void Peephole::fuseSequences() {
+            const std::size_t count = instructions.getCount();
+            for (std::size_t i = live(0); i < count; i = nextLive(i)) {
+                const std::size_t j = nextLive(i);
+                if (j >= count || instructions[j].isJumpTarget) {
+                    continue;
+                }
+
+                Instruction& first = instructions[i];
+                Instruction& second = instructions[j];
+                if (first.op == OpCode::NOT && second.op == OpCode::POP_JMP_IF_FALSE) {
+                    second.op = OpCode::POP_JMP_IF_TRUE;
+                    remove(i);
+                } else if (first.op == OpCode::NOT && second.op == OpCode::POP_JMP_IF_TRUE) {
+                    second.op = OpCode::POP_JMP_IF_FALSE;
+                    remove(i);
+                } else if (first.op == OpCode::SET_LOCAL && second.op == OpCode::POP) {
+                    first.op = OpCode::SET_LOCAL_POP;
+                    remove(j);
+                }
+            }
+        }
+
+        void Peephole::removeUnreachable() {
+            const std::size_t count = instructions.getCount();
+            Vector<bool> reachable(count);
+            Vector<std::size_t> worklist;
+            worklist.reserve(16);
+
+            const auto enqueue = [&](std::size_t i) {
+                if (i < count && reachable[i] == false) {
+                    reachable[i] = true;
+                    worklist.insertBack(i);
+                }
+            };
+
+            enqueue(live(0));
+            while (worklist.isEmpty() == false) {
+                const std::size_t i = worklist.back();
+                worklist.removeBack();
+
+                const Instruction& inst = instructions[i];
+                if (isJump(inst.op)) {
+                    enqueue(live(inst.target));
+                }
+                if (fallsThrough(inst.op)) {
+                    enqueue(nextLive(i));
+                }
+            }
+
+            for (std::size_t i = 0; i < count; ++i) {
+                if (instructions[i].removed == false && reachable[i] == false) {
+                    remove(i);
+                }
+            }
+        }
+
+        void Peephole::removeJumpsToNext() {
+            const std::size_t count = instructions.getCount();
+            for (std::size_t i = live(0); i < count; i = nextLive(i)) {
+                const Instruction& inst = instructions[i];
+                if (inst.op == OpCode::JMP && live(inst.target) == nextLive(i)) {
+                    remove(i);
+                }
+            }
+        }
+
+        void Rewriter::rewrite() {
+            const std::size_t count = instructions.getCount();
+            // a removed instruction gets the offset of the next live one
+            Vector<std::size_t> newOffset(count + 1);
+            std::size_t offset = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                newOffset[i] = offset;
+                if (instructions[i].removed == false) {
+                    offset += instructions[i].length;
+                }
+            }
+            newOffset[count] = offset;
+
+            Vector<std::uint8_t> code;
+            Vector<unsigned> lines;
+            code.reserve(offset);
+            lines.reserve(offset);
+            const auto emit = [&](std::uint8_t byte, unsigned line) {
+                code.insertBack(byte);
+                lines.insertBack(line);
+            };
+
+            for (std::size_t i = 0; i < count; ++i) {
+                Instruction& inst = instructions[i];
+                if (inst.removed) {
+                    continue;
+                }
+
+                const unsigned line = chunk.lines[inst.offset];
+                const auto operandLine = [&](std::size_t k) {
+                    return inst.replaced ? line : chunk.lines[inst.offset + k];
+                };
+                std::size_t k = 1;
+                if (isJump(inst.op)) {
+                    const std::size_t next = newOffset[i] + inst.length;
+                    const std::size_t target = newOffset[inst.target];
+                    std::size_t jump = 0;
+                    if (inst.op == OpCode::JMP || inst.op == OpCode::LOOP) {
+                        inst.op = target >= next ? OpCode::JMP : OpCode::LOOP;
+                    }
+                    jump = inst.op == OpCode::LOOP ? next - target : target - next;
+
+                    std::uint8_t a = 0, b = 0;
+                    serializeTwoByteInteger(jump, a, b);
+                    emit(static_cast<std::uint8_t>(inst.op), line);
+                    emit(a, operandLine(1));
+                    emit(b, operandLine(2));
+                    k = 3;
+                } else {
+                    emit(static_cast<std::uint8_t>(inst.op), line);
+                }
+
+                for (; k < inst.length; ++k) {
+                    const std::uint8_t operand = inst.replaced ? inst.operands[k - 1]
+                                                               : chunk.code[inst.offset + k];
+                    emit(operand, operandLine(k));
+                }
+            }
+
+            chunk.code = std::move(code);
+            chunk.lines = std::move(lines);
+        }
+
+        std::size_t Rewriter::live(std::size_t i) const {
+            while (i < instructions.getCount() && instructions[i].removed) {
+                ++i;
+            }
+            return i;
+        }
+
+        bool Peephole::fallsThrough(OpCode op) const {
+            return op != OpCode::JMP && op != OpCode::LOOP && op != OpCode::RETURN;
+        }
+
+        // the code only shrinks, so a distance which fits
+        // now still fits once it has been laid out again
+        bool Peephole::fitsJump(std::size_t from, std::size_t to) const {
+            const Instruction& jump = instructions[from];
+            const std::size_t next = jump.offset + jump.length;
+            const std::size_t target = to < instructions.getCount()
+                ? instructions[to].offset
+                : chunk.code.getCount();
+            return fitsTwoBytes(target >= next ? target - next : next - target);
+        }
+
+        void Rewriter::remove(std::size_t i) {
+            instructions[i].removed = true;
+            changed = true;
+        }
+
+        void RegisterAllocator::run() {
+            decode();
+            const std::size_t count = instructions.getCount();
+            for (std::size_t i = live(0); i < count; i = nextLive(i)) {
+                // the longest sequences first
+                if (binaryOp(i) == false &&
+                    compareJump(i) == false &&
+                    fusedBinaryOp(i) == false &&
+                    fusedCompareJump(i) == false)
+                {
+                    move(i);
+                }
+            }
+            if (changed) {
+                rewrite();
+            }
+        }
+
+        // a b BINARY sink -> OP_RK dst a b
+        bool RegisterAllocator::binaryOp(std::size_t i) {
+            const std::size_t j = nextLive(i);
+            const std::size_t k = nextLive(j);
+            std::uint8_t a = 0, b = 0, dst = 0;
+            std::size_t last = 0;
+            if (k >= instructions.getCount() ||
+                source(i, a) == false ||
+                source(j, b) == false ||
+                sink(nextLive(k), dst, last) == false ||
+                straightLine(i, last) == false)
+            {
+                return false;
+            }
+
+            OpCode op = OpCode::RETURN;
+            switch (instructions[k].op) {
+                case OpCode::ADD: { op = OpCode::ADD_RK; } break;
+                case OpCode::SUBTRACT: { op = OpCode::SUBTRACT_RK; } break;
+                case OpCode::MULTIPLY: { op = OpCode::MULTIPLY_RK; } break;
+                case OpCode::DIVIDE: { op = OpCode::DIVIDE_RK; } break;
+                default: { return false; } break;
+            }
+
+            replace(i, last, op, {dst, a, b});
+            return true;
+        }
+
+        // a b JMP_IF_NOT_COMPARISON -> JMP_IF_NOT_COMPARISON_RK a b
+        bool RegisterAllocator::compareJump(std::size_t i) {
+            const std::size_t j = nextLive(i);
+            const std::size_t k = nextLive(j);
+            std::uint8_t a = 0, b = 0;
+            if (k >= instructions.getCount() ||
+                source(i, a) == false ||
+                source(j, b) == false ||
+                straightLine(i, k) == false)
+            {
+                return false;
+            }
+
+            OpCode op = OpCode::RETURN;
+            switch (instructions[k].op) {
+                case OpCode::JMP_IF_NOT_LESS: { op = OpCode::JMP_IF_NOT_LESS_RK; } break;
+                case OpCode::JMP_IF_NOT_LESS_EQUAL: { op = OpCode::JMP_IF_NOT_LESS_EQUAL_RK; } break;
+                case OpCode::JMP_IF_NOT_GREATER: { op = OpCode::JMP_IF_NOT_GREATER_RK; } break;
+                case OpCode::JMP_IF_NOT_GREATER_EQUAL: { op = OpCode::JMP_IF_NOT_GREATER_EQUAL_RK; } break;
+                default: { return false; } break;
+            }
+
+            instructions[i].target = instructions[k].target;
+            replace(i, k, op, {0, 0, a, b});
+            return true;
+        }
+
+        // ADD_LOCALS a b sink -> ADD_RK dst a b and alike
+        bool RegisterAllocator::fusedBinaryOp(std::size_t i) {
+            const Instruction& inst = instructions[i];
+            OpCode op = OpCode::RETURN;
+            bool constant = false;
+            switch (inst.op) {
+                case OpCode::ADD_LOCALS: { op = OpCode::ADD_RK; } break;
+                case OpCode::ADD_LOCAL_CONST: { op = OpCode::ADD_RK; constant = true; } break;
+                case OpCode::SUBTRACT_LOCAL_CONST: { op = OpCode::SUBTRACT_RK; constant = true; } break;
+                default: { return false; } break;
+            }
+
+            const std::uint8_t a = chunk.code[inst.offset + 1];
+            const std::uint8_t b = chunk.code[inst.offset + 2];
+            const std::uint8_t rk = constant ? (b | RK_CONSTANT) : b;
+            std::uint8_t dst = 0;
+            std::size_t last = 0;
+            if (fitsRK(a) == false ||
+                fitsRK(b) == false ||
+                sink(nextLive(i), dst, last) == false ||
+                straightLine(i, last) == false)
+            {
+                return false;
+            }
+
+            replace(i, last, op, {dst, a, rk});
+            return true;
+        }
+
+        // LESS_LOCALS a b POP_JMP_IF_FALSE -> JMP_IF_NOT_LESS_RK a b and alike
+        bool RegisterAllocator::fusedCompareJump(std::size_t i) {
+            const Instruction& inst = instructions[i];
+            if (inst.op != OpCode::LESS_LOCALS && inst.op != OpCode::LESS_LOCAL_CONST) {
+                return false;
+            }
+
+            const std::uint8_t a = chunk.code[inst.offset + 1];
+            const std::uint8_t b = chunk.code[inst.offset + 2];
+            const std::size_t j = nextLive(i);
+            if (fitsRK(a) == false ||
+                fitsRK(b) == false ||
+                j >= instructions.getCount() ||
+                instructions[j].op != OpCode::POP_JMP_IF_FALSE ||
+                straightLine(i, j) == false)
+            {
+                return false;
+            }
+
+            const std::uint8_t rk = inst.op == OpCode::LESS_LOCALS ? b : (b | RK_CONSTANT);
+            instructions[i].target = instructions[j].target;
+            replace(i, j, OpCode::JMP_IF_NOT_LESS_RK, {0, 0, a, rk});
+            return true;
+        }
+
+        // a sink -> MOVE dst a
+        bool RegisterAllocator::move(std::size_t i) {
+            std::uint8_t a = 0, dst = 0;
+            std::size_t last = 0;
+            if (source(i, a) == false ||
+                sink(nextLive(i), dst, last) == false ||
+                straightLine(i, last) == false)
+            {
+                return false;
+            }
+
+            replace(i, last, OpCode::MOVE, {dst, a});
+            return true;
+        }
+
+        bool RegisterAllocator::source(std::size_t i, std::uint8_t& rk) const {
+            if (i >= instructions.getCount()) {
+                return false;
+            }
+
+            const Instruction& inst = instructions[i];
+            if (inst.op != OpCode::READ_LOCAL && inst.op != OpCode::CONSTANT) {
+                return false;
+            }
+            const std::uint8_t operand = chunk.code[inst.offset + 1];
+            if (fitsRK(operand) == false) {
+                return false;
+            }
+
+            rk = inst.op == OpCode::CONSTANT ? (operand | RK_CONSTANT) : operand;
+            return true;
+        }
+
+        bool RegisterAllocator::sink(std::size_t i, std::uint8_t& dst, std::size_t& last) const {
+            if (i >= instructions.getCount()) {
+                return false;
+            }
+
+            const Instruction& inst = instructions[i];
+            if (inst.op == OpCode::SET_LOCAL_POP) {
+                dst = chunk.code[inst.offset + 1];
+                last = i;
+                return true;
+            }
+
+            const std::size_t j = nextLive(i);
+            if (inst.op == OpCode::SET_LOCAL &&
+                j < instructions.getCount() &&
+                instructions[j].op == OpCode::POP)
+            {
+                dst = chunk.code[inst.offset + 1];
+                last = j;
+                return true;
+            }
+
+            return false;
+        }
+
+        bool RegisterAllocator::straightLine(std::size_t i, std::size_t last) const {
+            for (std::size_t k = nextLive(i); k <= last; k = nextLive(k)) {
+                if (instructions[k].isJumpTarget) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void RegisterAllocator::replace(std::size_t first,
+                                        std::size_t last,
+                                        OpCode op,
+                                        std::initializer_list<std::uint8_t> operands) {
+            for (std::size_t k = nextLive(first); k <= last; k = nextLive(k)) {
+                remove(k);
+            }
+
+            Instruction& inst = instructions[first];
+            inst.op = op;
+            inst.length = 1 + operands.size();
+            inst.replaced = true;
+            std::copy(operands.begin(), operands.end(), inst.operands);
+            changed = true;
+        }
+    } // namespace
+
+    void optimize(Chunk& chunk, OptimizationLevel level) {
+        if (level == OptimizationLevel::NONE) {
+            return;
+        }
+
+        for (std::size_t pass = 0; pass < MAX_PASSES; ++pass) {
+            Peephole peephole(chunk);
+            if (peephole.run() == false) {
+                break;
+            }
+        }
+    }
+
+    void allocateRegisters(Chunk& chunk) {
+        RegisterAllocator allocator(chunk);
+        allocator.run();
+    }
+} // namespace cpplox
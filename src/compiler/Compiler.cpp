@@ -3,6 +3,8 @@
 #include "cpplox/bytecode/Bytecode.hpp"
 #include "cpplox/bytecode/Chunk.hpp"
 #include "cpplox/runtime/Function.hpp"
+#include "cpplox/runtime/StringObject.hpp"
+#include "cpplox/runtime/GlobalTable.hpp"
 #include "cpplox/runtime/GC.hpp"
 #include "cpplox/diagnostics/DiagnosticEngine.hpp"
 #include "cpplox/core/Algorithm.hpp"
@@ -92,6 +94,10 @@ namespace cpplox {
         options = opts;
     }
 
+    void Compiler::setGlobals(GlobalTable* table) {
+        globals = table;
+    }
+
     CompileResult Compiler::replExpression(std::string src,
                                            DiagnosticEngine* engine) {
         bool initOk = init(std::move(src), engine);
@@ -99,7 +105,7 @@ namespace cpplox {
             advance();
             expression();
             emitOpCode(OpCode::PRINT);
-            emitReturn();
+            finishFunction();
         }
 
         bool error = initOk == false ||
@@ -123,7 +129,7 @@ namespace cpplox {
                     synchronize();
                 }
             } while (peek(TokenType::EOF_TOKEN) == false);
-            emitReturn();
+            finishFunction();
         }
 
         bool error = initOk == false || parser.hadError;
@@ -135,6 +141,10 @@ namespace cpplox {
     }
 
     bool Compiler::init(std::string&& compileSource, DiagnosticEngine* engine) {
+        if (globals == nullptr) {
+            return false;
+        }
+
         source = std::move(compileSource);
         diagnostics = engine;
         scanner = Scanner(source, engine);
@@ -184,6 +194,7 @@ namespace cpplox {
         scanner = Scanner(source, nullptr);
         parser = Parser{};
         frame = Frame{};
+        strings = StringTable{};
 
         const std::size_t size = gcObjects.getCount();
         for (std::size_t i = 0; i < size; ++i) {
@@ -312,6 +323,16 @@ namespace cpplox {
         fr.function->upvaluesCount++;
     }
 
+    bool Compiler::resolveGlobal(const Token& name, std::size_t& idx) {
+        idx = globals->slotFor(name.lexeme);
+        if (fitsTwoBytes(idx) == false) {
+            compileError(name, "Too many global variables");
+            return false;
+        }
+
+        return true;
+    }
+
     bool Compiler::resolveLocal(Frame& fr, const Token& name, std::size_t& idx) {
         for (std::size_t i = fr.locals.getCount(); i > 0; --i) {
             auto localIdx = i - 1;
@@ -399,11 +420,15 @@ namespace cpplox {
         consumeTokenErr(TokenType::IDENTIFIER, "Expected class name");
         const Token className = parser.previous;
 
-        std::size_t idx = 0;
-        makeConstant(Value(String(className.lexeme)), true, idx);
+        std::size_t nameIdx = 0;
+        makeConstant(makeString(className.lexeme), true, nameIdx);
         declareVariable(className);
-        emitIntegerInstruction(OpCode::MAKE_CLASS, OpCode::MAKE_CLASS_16, idx);
-        defineVariable(idx);
+        std::size_t slot = 0;
+        if (inLocalScope() == false) {
+            resolveGlobal(className, slot);
+        }
+        emitIntegerInstruction(OpCode::MAKE_CLASS, OpCode::MAKE_CLASS_16, nameIdx);
+        defineVariable(slot);
 
         auto oldClass = enclosingClass;
         enclosingClass.null = false;
@@ -448,7 +473,7 @@ namespace cpplox {
         consumeTokenErr(TokenType::IDENTIFIER, "Expected method name");
 
         std::size_t idx = 0;
-        makeConstant(Value(String(parser.previous.lexeme)),
+        makeConstant(makeString(parser.previous.lexeme),
                          true,
                          idx);
 
@@ -512,7 +537,7 @@ namespace cpplox {
         consumeTokenErr(TokenType::LEFT_BRACE,
                         "Expected '{{' before function body");
         block();
-        emitReturn();
+        finishFunction();
 
         // no need for endScope because we
         // return to compiling the parent function
@@ -545,9 +570,7 @@ namespace cpplox {
         if (inLocalScope()) {
             declareVariable(parser.previous);
         } else {
-            makeConstant(Value(String(parser.previous.lexeme)),
-                         true,
-                         idx);
+            resolveGlobal(parser.previous, idx);
         }
     }
 
@@ -690,17 +713,34 @@ namespace cpplox {
         expression();
         consumeTokenErr(TokenType::RIGHT_PAREN, "Expected ')' after condition");
 
-        std::size_t thenJmp = emitJump(OpCode::JMP_IF_FALSE);
-        emitOpCode(OpCode::POP);
-        statement();
-        std::size_t elseJmp = emitJump(OpCode::JMP);
-        patchJump(thenJmp);
+        Value condition;
+        if (constantExpression(condition)) {
+            // only the branch which is taken is kept
+            removeInstructions(1);
+            if (condition.isFalsey()) {
+                deadStatement();
+                if (match(TokenType::ELSE)) {
+                    statement();
+                }
+            } else {
+                statement();
+                if (match(TokenType::ELSE)) {
+                    deadStatement();
+                }
+            }
+            return;
+        }
 
-        emitOpCode(OpCode::POP);
+        const std::size_t thenJmp = emitConditionJump();
+        statement();
         if (match(TokenType::ELSE)) {
+            const std::size_t elseJmp = emitJump(OpCode::JMP);
+            patchJump(thenJmp);
             statement();
+            patchJump(elseJmp);
+        } else {
+            patchJump(thenJmp);
         }
-        patchJump(elseJmp);
     }
 
     void Compiler::whileStatement() {
@@ -708,7 +748,7 @@ namespace cpplox {
         loop.null = false;
         loop.enclosingScopeDepth = frame.scopeDepth;
 
-        const std::size_t loopStart = currentChunkCodeOffset();
+        const std::size_t loopStart = markLoopStart();
         loop.continueTarget = loopStart;
         loop.continueScopeDepth = frame.scopeDepth;
 
@@ -716,13 +756,24 @@ namespace cpplox {
         expression();
         consumeTokenErr(TokenType::RIGHT_PAREN, "Expected ')' after condition");
 
-        std::size_t exitJmp = emitJump(OpCode::JMP_IF_FALSE);
-        emitOpCode(OpCode::POP);
-        statement();
-        emitLoop(loopStart);
+        Value condition;
+        const bool constant = constantExpression(condition);
+        if (constant) {
+            removeInstructions(1);
+        }
 
-        patchJump(exitJmp);
-        emitOpCode(OpCode::POP);
+        if (constant && condition.isFalsey()) {
+            deadStatement();
+        } else {
+            // a constant true condition needs no exit jump
+            const std::size_t exitJmp = constant ? 0 : emitConditionJump();
+            statement();
+            emitLoop(loopStart);
+
+            if (constant == false) {
+                patchJump(exitJmp);
+            }
+        }
 
         forEach(loop.breaksToPatch,
                 [this](std::size_t jmp) { patchJump(jmp); });
@@ -748,19 +799,26 @@ namespace cpplox {
 
         bool hasCondition = false;
         std::size_t exitJmp = 0;
-        std::size_t loopStart = currentChunkCodeOffset();
+        std::size_t loopStart = markLoopStart();
         if (match(TokenType::SEMICOLON) == false) {
             hasCondition = true;
             expression();
             consumeTokenErr(TokenType::SEMICOLON,
                             "Expected ';' after loop condition");
-            exitJmp = emitJump(OpCode::JMP_IF_FALSE);
-            emitOpCode(OpCode::POP); // condition
+
+            Value condition;
+            if (constantExpression(condition) && condition.isFalsey() == false) {
+                // an always true condition is the same as none
+                removeInstructions(1);
+                hasCondition = false;
+            } else {
+                exitJmp = emitConditionJump();
+            }
         }
 
         if (match(TokenType::RIGHT_PAREN) == false) {
             const std::size_t bodyJmp = emitJump(OpCode::JMP);
-            const std::size_t increment = currentChunkCodeOffset();
+            const std::size_t increment = markLoopStart();
             expression();
             emitOpCode(OpCode::POP);
             consumeTokenErr(TokenType::RIGHT_PAREN, "Expected ')' after for clauses");
@@ -778,7 +836,6 @@ namespace cpplox {
 
         if (hasCondition) {
             patchJump(exitJmp);
-            emitOpCode(OpCode::POP); // condition
         }
 
         endScope();
@@ -805,6 +862,17 @@ namespace cpplox {
 
             expression();
             consumeTokenErr(TokenType::SEMICOLON, "Expected ';' after return");
+
+            // the RETURN still runs if the VM can't reuse the frame for the call
+            const std::size_t last = frame.lastInstruction;
+            Chunk& chunk = frame.function->chunk;
+            if (last != NO_INSTRUCTION &&
+                currentChunkCodeOffset() == last + 2 &&
+                frame.lastJumpTarget <= last &&
+                static_cast<OpCode>(chunk.code[last]) == OpCode::CALL)
+            {
+                chunk.code[last] = static_cast<std::uint8_t>(OpCode::TAIL_CALL);
+            }
             emitOpCode(OpCode::RETURN);
         }
     }
@@ -890,34 +958,34 @@ namespace cpplox {
 
         switch (op) {
             case TokenType::PLUS: {
-                emitOpCode(OpCode::ADD);
+                emitBinaryOp(OpCode::ADD);
             } break;
             case TokenType::MINUS: {
-                emitOpCode(OpCode::SUBTRACT);
+                emitBinaryOp(OpCode::SUBTRACT);
             } break;
             case TokenType::STAR: {
-                emitOpCode(OpCode::MULTIPLY);
+                emitBinaryOp(OpCode::MULTIPLY);
             } break;
             case TokenType::SLASH: {
-                emitOpCode(OpCode::DIVIDE);
+                emitBinaryOp(OpCode::DIVIDE);
             } break;
             case TokenType::EQUAL_EQUAL: {
-                emitOpCode(OpCode::EQUAL);
+                emitBinaryOp(OpCode::EQUAL);
             } break;
             case TokenType::BANG_EQUAL: {
-                emitOpCode(OpCode::NOT_EQUAL);
+                emitBinaryOp(OpCode::NOT_EQUAL);
             } break;
             case TokenType::GREATER: {
-                emitOpCode(OpCode::GREATER);
+                emitBinaryOp(OpCode::GREATER);
             } break;
             case TokenType::GREATER_EQUAL: {
-                emitOpCode(OpCode::GREATER_EQUAL);
+                emitBinaryOp(OpCode::GREATER_EQUAL);
             } break;
             case TokenType::LESS: {
-                emitOpCode(OpCode::LESS);
+                emitBinaryOp(OpCode::LESS);
             } break;
             case TokenType::LESS_EQUAL: {
-                emitOpCode(OpCode::LESS_EQUAL);
+                emitBinaryOp(OpCode::LESS_EQUAL);
             } break;
             default: {
                 // unreachable
@@ -946,12 +1014,13 @@ namespace cpplox {
         TokenType type = parser.previous.type;
         parsePrecedence(OpPrecedence::UNARY);
 
+        const OpCode op = type == TokenType::MINUS ? OpCode::NEGATE : OpCode::NOT;
         switch (type) {
-            case TokenType::MINUS: {
-                emitOpCode(OpCode::NEGATE);
-            } break;
+            case TokenType::MINUS:
             case TokenType::BANG: {
-                emitOpCode(OpCode::NOT);
+                if (foldUnaryOp(op) == false) {
+                    emitOpCode(op);
+                }
             } break;
             default: {
                 // unreachable
@@ -970,7 +1039,7 @@ namespace cpplox {
         if (local == false) {
             upvalue = resolveUpvalue(frame, t, idx);
             if (upvalue == false) {
-                makeConstant(Value(String(t.lexeme)), true, idx);
+                resolveGlobal(t, idx);
             }
         }
 
@@ -1015,7 +1084,7 @@ namespace cpplox {
         v.remove_prefix(1);
         v.remove_suffix(1);
 
-        emitConstant(Value(v));
+        emitConstant(makeString(v));
     }
 
     void Compiler::and_(bool) {
@@ -1042,21 +1111,24 @@ namespace cpplox {
                         "Expected property name after '.'");
 
         std::size_t idx = 0;
-        makeConstant(Value(String(parser.previous.lexeme)), true, idx);
+        makeConstant(makeString(parser.previous.lexeme), true, idx);
 
         if (canAssign && match(TokenType::EQUAL)) {
             expression();
             emitIntegerInstruction(OpCode::SET_PROPERTY,
                                    OpCode::SET_PROPERTY_16,
                                    idx);
+            emitPropertyCache();
         } else if (match(TokenType::LEFT_PAREN)) {
             const auto count = argList();
             emitIntegerInstruction(OpCode::INVOKE, OpCode::INVOKE_16, idx);
             emitByte(static_cast<std::uint8_t>(count));
+            emitPropertyCache();
         } else {
             emitIntegerInstruction(OpCode::GET_PROPERTY,
                                    OpCode::GET_PROPERTY_16,
                                    idx);
+            emitPropertyCache();
         }
     }
 
@@ -1081,7 +1153,7 @@ namespace cpplox {
         consumeTokenErr(TokenType::IDENTIFIER, "Expected superclass method name");
 
         std::size_t idx = 0;
-        makeConstant(Value(String(parser.previous.lexeme)), true, idx);
+        makeConstant(makeString(parser.previous.lexeme), true, idx);
 
         namedVariable(Token{.lexeme = "this"}, false);
         if (match(TokenType::LEFT_PAREN)) {
@@ -1091,6 +1163,7 @@ namespace cpplox {
                                    OpCode::SUPER_INVOKE_16,
                                    idx);
             emitByte(static_cast<std::uint8_t>(argc));
+            emitPropertyCache();
         } else {
             namedVariable(Token{.lexeme = "super"}, false);
             emitIntegerInstruction(OpCode::GET_SUPER,
@@ -1154,6 +1227,19 @@ namespace cpplox {
         return realError;
     }
 
+    Value Compiler::makeString(std::string_view chars) {
+        StringObject* s = strings.find(chars);
+        if (s == nullptr) {
+            s = makeObject<StringObject>(chars);
+            if (s == nullptr) {
+                return Value::nil();
+            }
+            strings.insert(s);
+        }
+
+        return s->asValue();
+    }
+
     bool Compiler::makeConstant(Value value,
                                 bool searchExisting,
                                 std::size_t& idx) {
@@ -1228,6 +1314,20 @@ namespace cpplox {
         emitOpCode(OpCode::RETURN);
     }
 
+    void Compiler::finishFunction() {
+        emitReturn();
+        if (parser.hadError) {
+            return;
+        }
+
+        Function* f = frame.function;
+        optimize(f->chunk, options.optimizationLevel);
+        if (options.backend == Backend::REGISTER) {
+            allocateRegisters(f->chunk);
+        }
+        f->maxStackSize = maxStackDepth(f->chunk, f->arity + 1);
+    }
+
     void Compiler::emitIntegerInstruction(OpCode small,
                                           OpCode big,
                                           std::size_t operand) {
@@ -1249,6 +1349,306 @@ namespace cpplox {
         emitBytes(a, b);
     }
 
+    void Compiler::emitPropertyCache() {
+        const std::size_t cache = addPropertyCache(frame.function->chunk);
+        if (fitsTwoBytes(cache) == false) {
+            compileError(parser.previous,
+                         "Too many property accesses in one function");
+            return;
+        }
+
+        std::uint8_t a = 0;
+        std::uint8_t b = 0;
+        serializeTwoByteInteger(cache, a, b);
+        emitBytes(a, b);
+    }
+
+    void Compiler::emitBinaryOp(OpCode op) {
+        if (foldBinaryOp(op) == false &&
+            emitSuperinstruction(op) == false)
+        {
+            emitOpCode(op);
+        }
+    }
+
+    bool Compiler::foldUnaryOp(OpCode op) {
+        Value value;
+        if (constantExpression(value) == false) {
+            return false;
+        }
+
+        Value result;
+        if (op == OpCode::NOT) {
+            result = Value(value.isFalsey());
+        } else if (op == OpCode::NEGATE && value.isNumber()) {
+            result = Value(-value.asNumber());
+        } else {
+            // a runtime error, leave it to the VM
+            return false;
+        }
+
+        removeInstructions(1);
+        emitValue(result);
+
+        return true;
+    }
+
+    bool Compiler::foldBinaryOp(OpCode op) {
+        const std::size_t first = frame.previousInstruction;
+        const std::size_t second = frame.lastInstruction;
+        Value b;
+        if (first == NO_INSTRUCTION ||
+            frame.lastJumpTarget > first ||
+            constantExpression(b) == false)
+        {
+            return false;
+        }
+
+        const Chunk& chunk = frame.function->chunk;
+        Value a;
+        if (first + instructionLength(chunk, first) != second ||
+            constantAt(first, a) == false)
+        {
+            return false;
+        }
+
+        Value result;
+        if (a.isNumber() && b.isNumber()) {
+            const double x = a.asNumber();
+            const double y = b.asNumber();
+            switch (op) {
+                case OpCode::ADD: { result = Value(x + y); } break;
+                case OpCode::SUBTRACT: { result = Value(x - y); } break;
+                case OpCode::MULTIPLY: { result = Value(x * y); } break;
+                case OpCode::DIVIDE: { result = Value(x / y); } break;
+                case OpCode::LESS: { result = Value(x < y); } break;
+                case OpCode::LESS_EQUAL: { result = Value(x <= y); } break;
+                case OpCode::GREATER: { result = Value(x > y); } break;
+                case OpCode::GREATER_EQUAL: { result = Value(x >= y); } break;
+                case OpCode::EQUAL: { result = Value(a == b); } break;
+                case OpCode::NOT_EQUAL: { result = Value(a != b); } break;
+                default: { return false; } break;
+            }
+        } else if (op == OpCode::EQUAL || op == OpCode::NOT_EQUAL) {
+            // the strings of a compilation are interned as well
+            result = Value((a == b) == (op == OpCode::EQUAL));
+        } else if (op == OpCode::ADD && a.isString() && b.isString()) {
+            const String& x = a.asString();
+            const String& y = b.asString();
+            std::string chars;
+            chars.reserve(x.size() + y.size());
+            chars.append(x.c_str(), x.size());
+            chars.append(y.c_str(), y.size());
+            result = makeString(chars);
+            if (result.isNil()) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+
+        removeInstructions(2);
+        emitValue(result);
+
+        return true;
+    }
+
+    bool Compiler::constantAt(std::size_t offset, Value& value) const {
+        const Chunk& chunk = frame.function->chunk;
+        switch (static_cast<OpCode>(chunk.code[offset])) {
+            case OpCode::CONSTANT: {
+                value = chunk.constants[chunk.code[offset + 1]];
+            } break;
+            case OpCode::CONSTANT_16: {
+                value = chunk.constants[parseTwoByteInteger(chunk.code[offset + 1],
+                                                            chunk.code[offset + 2])];
+            } break;
+            case OpCode::TRUE: {
+                value = Value(true);
+            } break;
+            case OpCode::FALSE: {
+                value = Value(false);
+            } break;
+            case OpCode::NIL: {
+                value = Value::nil();
+            } break;
+            default: {
+                return false;
+            } break;
+        }
+
+        return true;
+    }
+
+    bool Compiler::constantExpression(Value& value) const {
+        const std::size_t last = frame.lastInstruction;
+        if (last == NO_INSTRUCTION || frame.lastJumpTarget > last) {
+            return false;
+        }
+
+        const Chunk& chunk = frame.function->chunk;
+        return last + instructionLength(chunk, last) == currentChunkCodeOffset() &&
+               constantAt(last, value);
+    }
+
+    void Compiler::emitValue(const Value& value) {
+        if (value.isBoolean()) {
+            emitOpCode(value.asBoolean() ? OpCode::TRUE : OpCode::FALSE);
+        } else if (value.isNil()) {
+            emitOpCode(OpCode::NIL);
+        } else {
+            emitConstant(value);
+        }
+    }
+
+    void Compiler::removeInstructions(std::size_t count) {
+        Chunk& chunk = frame.function->chunk;
+        const std::size_t start =
+            count == 1 ? frame.lastInstruction : frame.previousInstruction;
+
+        // literals always get a new constant, drop it if nothing else uses it
+        const std::size_t offsets[] = {frame.lastInstruction, frame.previousInstruction};
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::size_t offset = offsets[i];
+            std::size_t idx = 0;
+            switch (static_cast<OpCode>(chunk.code[offset])) {
+                case OpCode::CONSTANT: {
+                    idx = chunk.code[offset + 1];
+                } break;
+                case OpCode::CONSTANT_16: {
+                    idx = parseTwoByteInteger(chunk.code[offset + 1], chunk.code[offset + 2]);
+                } break;
+                default: {
+                    continue;
+                } break;
+            }
+            if (idx + 1 == chunk.constants.getCount()) {
+                chunk.constants.removeBack();
+            }
+        }
+
+        const std::size_t removed = currentChunkCodeOffset() - start;
+        chunk.code.removeLastN(removed);
+        chunk.lines.removeLastN(removed);
+
+        if (count == 1) {
+            frame.lastInstruction = frame.previousInstruction;
+            frame.previousInstruction = frame.thirdInstruction;
+        } else {
+            frame.lastInstruction = frame.thirdInstruction;
+            frame.previousInstruction = NO_INSTRUCTION;
+        }
+        frame.thirdInstruction = NO_INSTRUCTION;
+    }
+
+    void Compiler::deadStatement() {
+        Chunk& chunk = frame.function->chunk;
+        const std::size_t start = currentChunkCodeOffset();
+        const std::size_t constants = chunk.constants.getCount();
+        const std::size_t caches = chunk.propertyCaches.getCount();
+        const std::size_t breaks = loop.breaksToPatch.getCount();
+        statement();
+
+        // nothing outside the statement refers to what it has added
+        const std::size_t removed = currentChunkCodeOffset() - start;
+        chunk.code.removeLastN(removed);
+        chunk.lines.removeLastN(removed);
+        chunk.constants.removeLastN(chunk.constants.getCount() - constants);
+        chunk.propertyCaches.removeLastN(chunk.propertyCaches.getCount() - caches);
+        loop.breaksToPatch.removeLastN(loop.breaksToPatch.getCount() - breaks);
+
+        frame.lastInstruction = NO_INSTRUCTION;
+        frame.previousInstruction = NO_INSTRUCTION;
+        frame.thirdInstruction = NO_INSTRUCTION;
+        frame.lastJumpTarget = start;
+    }
+
+    bool Compiler::emitSuperinstruction(OpCode op) {
+        // Only the one-byte forms of READ_LOCAL and CONSTANT are fused,
+        // so forceLongInstructions disables superinstructions.
+        const std::size_t first = frame.previousInstruction;
+        const std::size_t second = frame.lastInstruction;
+        if (first == NO_INSTRUCTION ||
+            second != first + 2 ||
+            currentChunkCodeOffset() != second + 2 ||
+            frame.lastJumpTarget > first)
+        {
+            return false;
+        }
+
+        Chunk& chunk = frame.function->chunk;
+        const auto firstOp = static_cast<OpCode>(chunk.code[first]);
+        const auto secondOp = static_cast<OpCode>(chunk.code[second]);
+        if (firstOp != OpCode::READ_LOCAL) {
+            return false;
+        }
+
+        OpCode fused = op;
+        if (secondOp == OpCode::READ_LOCAL) {
+            switch (op) {
+                case OpCode::ADD: { fused = OpCode::ADD_LOCALS; } break;
+                case OpCode::LESS: { fused = OpCode::LESS_LOCALS; } break;
+                default: { } break;
+            }
+        } else if (secondOp == OpCode::CONSTANT) {
+            switch (op) {
+                case OpCode::ADD: { fused = OpCode::ADD_LOCAL_CONST; } break;
+                case OpCode::SUBTRACT: { fused = OpCode::SUBTRACT_LOCAL_CONST; } break;
+                case OpCode::LESS: { fused = OpCode::LESS_LOCAL_CONST; } break;
+                default: { } break;
+            }
+        }
+        if (fused == op) {
+            return false;
+        }
+
+        const std::uint8_t a = chunk.code[first + 1];
+        const std::uint8_t b = chunk.code[second + 1];
+        chunk.code.removeLastN(4);
+        chunk.lines.removeLastN(4);
+        frame.lastInstruction = NO_INSTRUCTION;
+
+        emitOpCode(fused);
+        emitBytes(a, b);
+
+        return true;
+    }
+
+    std::size_t Compiler::emitConditionJump() {
+        // A condition which ends with a comparison is fused with the jump,
+        // unless a jump lands right after the comparison (e.g. 'and').
+        OpCode jump = OpCode::POP_JMP_IF_FALSE;
+        const std::size_t last = frame.lastInstruction;
+        if (last != NO_INSTRUCTION &&
+            currentChunkCodeOffset() == last + 1 &&
+            frame.lastJumpTarget <= last)
+        {
+            Chunk& chunk = frame.function->chunk;
+            switch (static_cast<OpCode>(chunk.code[last])) {
+                case OpCode::LESS: { jump = OpCode::JMP_IF_NOT_LESS; } break;
+                case OpCode::LESS_EQUAL: { jump = OpCode::JMP_IF_NOT_LESS_EQUAL; } break;
+                case OpCode::GREATER: { jump = OpCode::JMP_IF_NOT_GREATER; } break;
+                case OpCode::GREATER_EQUAL: { jump = OpCode::JMP_IF_NOT_GREATER_EQUAL; } break;
+                default: { } break;
+            }
+
+            if (jump != OpCode::POP_JMP_IF_FALSE) {
+                chunk.code.removeLastN(1);
+                chunk.lines.removeLastN(1);
+                frame.lastInstruction = frame.previousInstruction;
+                frame.previousInstruction = frame.thirdInstruction;
+                frame.thirdInstruction = NO_INSTRUCTION;
+            }
+        }
+
+        return emitJump(jump);
+    }
+
+    std::size_t Compiler::markLoopStart() {
+        frame.lastJumpTarget = currentChunkCodeOffset();
+        return frame.lastJumpTarget;
+    }
+
     void Compiler::emitLoop(std::size_t loopStart) {
         const std::size_t current = currentChunkCodeOffset();
         if (current <= loopStart) {
@@ -1291,9 +1691,13 @@ namespace cpplox {
 
         frame.function->chunk.code[offset] = a;
         frame.function->chunk.code[offset + 1] = b;
+        frame.lastJumpTarget = current;
     }
 
     void Compiler::emitOpCode(OpCode op) {
+        frame.thirdInstruction = frame.previousInstruction;
+        frame.previousInstruction = frame.lastInstruction;
+        frame.lastInstruction = currentChunkCodeOffset();
         emitByte(static_cast<std::uint8_t>(op));
     }
 
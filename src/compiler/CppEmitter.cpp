@@ -0,0 +1,616 @@
+#include "cpplox/compiler/CppEmitter.hpp"
+#include "cpplox/runtime/Function.hpp"
+#include "cpplox/runtime/GlobalTable.hpp"
+#include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
+#include "cpplox/core/Vector.hpp"
+#include "cpplox/core/Value.hpp"
+
+#include <bit>
+#include <iterator>
+#include <string_view>
+#include <fmt/format.h>
+
+namespace cpplox {
+    namespace {
+        std::size_t indexOf(const Vector<const Function*>& functions, const Function* f) {
+            for (std::size_t i = 0; i < functions.getCount(); ++i) {
+                if (functions[i] == f) {
+                    return i;
+                }
+            }
+            return functions.getCount();
+        }
+
+        // the functions reachable from script through the constants, script first
+        Vector<const Function*> collectFunctions(const Function& script) {
+            Vector<const Function*> functions;
+            functions.insertBack(&script);
+            for (std::size_t i = 0; i < functions.getCount(); ++i) {
+                const Vector<Value>& constants = functions[i]->chunk.constants;
+                for (std::size_t k = 0; k < constants.getCount(); ++k) {
+                    if (constants[k].isObject() == false) {
+                        continue;
+                    }
+                    const auto* f = constants[k].asObject()->as<Function>();
+                    if (f != nullptr && indexOf(functions, f) == functions.getCount()) {
+                        functions.insertBack(f);
+                    }
+                }
+            }
+
+            return functions;
+        }
+
+        // a C++ string literal of chars, everything but printable ASCII
+        // escaped as octal, which never takes in the characters after it
+        std::string literal(std::string_view chars) {
+            std::string result = "\"";
+            for (const char c : chars) {
+                const auto byte = static_cast<unsigned char>(c);
+                if (c == '"' || c == '\\') {
+                    result += '\\';
+                    result += c;
+                } else if (byte >= 0x20 && byte < 0x7F) {
+                    result += c;
+                } else {
+                    fmt::format_to(std::back_inserter(result), "\\{:03o}", byte);
+                }
+            }
+            result += '"';
+            return result;
+        }
+
+        template <typename T>
+        void emitArray(std::string& out,
+                       std::string_view type,
+                       std::string_view name,
+                       const Vector<T>& values) {
+            fmt::format_to(std::back_inserter(out), "const {} {}[] = {{", type, name);
+            for (std::size_t i = 0; i < values.getCount(); ++i) {
+                out += (i % 16 == 0) ? "\n    " : " ";
+                fmt::format_to(std::back_inserter(out), "{},", values[i]);
+            }
+            out += "\n};\n";
+        }
+
+        void emitConstants(std::string& out,
+                           std::size_t index,
+                           const Vector<Value>& constants,
+                           const Vector<const Function*>& functions) {
+            fmt::format_to(std::back_inserter(out), "const ConstantImage constants{}[] = {{\n", index);
+            for (std::size_t i = 0; i < constants.getCount(); ++i) {
+                const Value& c = constants[i];
+                if (c.isNumber()) {
+                    fmt::format_to(std::back_inserter(out),
+                                   "    {{Kind::NUMBER, 0x{:016x}u}}, // {}\n",
+                                   std::bit_cast<std::uint64_t>(c.asNumber()),
+                                   c.asNumber());
+                } else if (c.isBoolean()) {
+                    fmt::format_to(std::back_inserter(out),
+                                   "    {{Kind::BOOLEAN, {}}},\n",
+                                   c.asBoolean() ? 1 : 0);
+                } else if (c.isString()) {
+                    const String& s = c.asString();
+                    fmt::format_to(std::back_inserter(out),
+                                   "    {{Kind::STRING, {}, {}}},\n",
+                                   s.size(),
+                                   literal(std::string_view(s.c_str(), s.size())));
+                } else if (c.isObject() && c.asObject()->as<Function>() != nullptr) {
+                    fmt::format_to(std::back_inserter(out),
+                                   "    {{Kind::FUNCTION, {}}},\n",
+                                   indexOf(functions, c.asObject()->as<Function>()));
+                } else {
+                    out += "    {Kind::NIL},\n";
+                }
+            }
+            out += "};\n";
+        }
+
+        // a line of the block of an instruction
+        template <typename... Args>
+        void emitLine(std::string& out, fmt::format_string<Args...> format, Args&&... args) {
+            out += "        ";
+            fmt::format_to(std::back_inserter(out), format, std::forward<Args>(args)...);
+            out += '\n';
+        }
+
+        // the stub runs the instruction at offset and leaves the stack
+        // end in sp, or reports a runtime error
+        void emitStub(std::string& out, std::string_view stub, std::size_t offset) {
+            emitLine(out, "sp = Stubs::{}(vm, sp, code + {});", stub, offset);
+            emitLine(out, "if (sp == nullptr) {{ return {{}}; }}");
+        }
+
+        // the runtime error of the instruction at offset
+        std::string error(std::string_view stub, std::size_t offset) {
+            return fmt::format("Stubs::{}(vm, sp, code + {}); return {{}};", stub, offset);
+        }
+
+        std::string numbers(std::string_view a, std::string_view b) {
+            return fmt::format("{}.isNumber() && {}.isNumber()", a, b);
+        }
+
+        // reports the error of the instruction at offset unless a and b are numbers
+        void emitNumbersCheck(std::string& out,
+                              std::string_view a,
+                              std::string_view b,
+                              std::size_t offset) {
+            emitLine(out,
+                     "if (({}) == false) {{ {} }}",
+                     numbers(a, b),
+                     error("numbersError", offset));
+        }
+
+        // a source operand of a register instruction
+        std::string registerOperand(std::uint8_t rk) {
+            return (rk & RK_CONSTANT) != 0 ? fmt::format("k[{}]", rk & ~RK_CONSTANT)
+                                           : fmt::format("slots[{}]", rk);
+        }
+
+        // the C++ operator of an arithmetic or a comparison instruction,
+        // + for the additions and everything else
+        const char* binaryOperator(OpCode op) {
+            switch (op) {
+                case OpCode::SUBTRACT:
+                case OpCode::SUBTRACT_LOCAL_CONST:
+                case OpCode::SUBTRACT_RK: {
+                    return "-";
+                } break;
+                case OpCode::MULTIPLY:
+                case OpCode::MULTIPLY_RK: {
+                    return "*";
+                } break;
+                case OpCode::DIVIDE:
+                case OpCode::DIVIDE_RK: {
+                    return "/";
+                } break;
+                case OpCode::LESS:
+                case OpCode::LESS_LOCALS:
+                case OpCode::LESS_LOCAL_CONST:
+                case OpCode::JMP_IF_NOT_LESS:
+                case OpCode::JMP_IF_NOT_LESS_RK: {
+                    return "<";
+                } break;
+                case OpCode::LESS_EQUAL:
+                case OpCode::JMP_IF_NOT_LESS_EQUAL:
+                case OpCode::JMP_IF_NOT_LESS_EQUAL_RK: {
+                    return "<=";
+                } break;
+                case OpCode::GREATER:
+                case OpCode::JMP_IF_NOT_GREATER:
+                case OpCode::JMP_IF_NOT_GREATER_RK: {
+                    return ">";
+                } break;
+                case OpCode::GREATER_EQUAL:
+                case OpCode::JMP_IF_NOT_GREATER_EQUAL:
+                case OpCode::JMP_IF_NOT_GREATER_EQUAL_RK: {
+                    return ">=";
+                } break;
+                default: {
+                    return "+";
+                } break;
+            }
+        }
+
+        // the offset a jump instruction at offset continues at if it is taken
+        std::size_t jumpTarget(const Chunk& chunk, std::size_t offset, std::size_t length) {
+            const std::size_t jump = parseTwoByteInteger(chunk.code[offset + 1],
+                                                         chunk.code[offset + 2]);
+            const auto op = static_cast<OpCode>(chunk.code[offset]);
+            return op == OpCode::LOOP ? offset + length - jump : offset + length + jump;
+        }
+
+        // the interpreter performs the instruction, the code of the
+        // frame resumes after it
+        bool leavesCode(OpCode op) {
+            switch (op) {
+                case OpCode::CALL:
+                case OpCode::TAIL_CALL:
+                case OpCode::INVOKE:
+                case OpCode::INVOKE_16:
+                case OpCode::SUPER_INVOKE:
+                case OpCode::SUPER_INVOKE_16: {
+                    return true;
+                } break;
+                default: {
+                    return false;
+                } break;
+            }
+        }
+
+        // What the interpreter does for the instruction at offset, inline
+        // for the values it handles inline and through the stubs of the
+        // VM for the rest. False if the instruction is unknown.
+        bool emitInstruction(std::string& out,
+                             const Chunk& chunk,
+                             std::size_t offset,
+                             std::size_t length) {
+            const std::uint8_t* const ip = chunk.code.data() + offset;
+            const auto op = static_cast<OpCode>(*ip);
+            const char* const binary = binaryOperator(op);
+
+            switch (op) {
+                case OpCode::CONSTANT:
+                case OpCode::CONSTANT_16: {
+                    emitLine(out, "*sp++ = k[{}];", operandOf(ip, OpCode::CONSTANT));
+                } break;
+                case OpCode::NIL: {
+                    emitLine(out, "*sp++ = Value::nil();");
+                } break;
+                case OpCode::TRUE:
+                case OpCode::FALSE: {
+                    emitLine(out, "*sp++ = Value({});", op == OpCode::TRUE);
+                } break;
+                case OpCode::POP: {
+                    emitLine(out, "--sp;");
+                } break;
+                case OpCode::POP_N:
+                case OpCode::POP_N_16: {
+                    emitLine(out, "sp -= {};", operandOf(ip, OpCode::POP_N));
+                } break;
+                case OpCode::READ_LOCAL:
+                case OpCode::READ_LOCAL_16: {
+                    emitLine(out, "*sp++ = slots[{}];", operandOf(ip, OpCode::READ_LOCAL));
+                } break;
+                case OpCode::SET_LOCAL:
+                case OpCode::SET_LOCAL_16: {
+                    emitLine(out, "slots[{}] = sp[-1];", operandOf(ip, OpCode::SET_LOCAL));
+                } break;
+                case OpCode::SET_LOCAL_POP: {
+                    emitLine(out, "slots[{}] = *--sp;", ip[1]);
+                } break;
+                case OpCode::NOT: {
+                    emitLine(out, "sp[-1] = Value(sp[-1].isFalsey());");
+                } break;
+                case OpCode::NEGATE: {
+                    emitLine(out,
+                             "if (sp[-1].isNumber() == false) {{ {} }}",
+                             error("numberError", offset));
+                    emitLine(out, "sp[-1] = Value(-sp[-1].asNumber());");
+                } break;
+                case OpCode::EQUAL:
+                case OpCode::NOT_EQUAL: {
+                    emitLine(out,
+                             "sp[-2] = Value(sp[-2] {} sp[-1]);",
+                             op == OpCode::EQUAL ? "==" : "!=");
+                    emitLine(out, "--sp;");
+                } break;
+                // the bytecode is emitted before the interpreter quickens any ADD
+                case OpCode::ADD:
+                case OpCode::ADD_NUM:
+                case OpCode::ADD_STR: {
+                    emitLine(out, "if ({}) {{", numbers("sp[-2]", "sp[-1]"));
+                    emitLine(out, "    sp[-2] = Value(sp[-2].asNumber() + sp[-1].asNumber());");
+                    emitLine(out, "    --sp;");
+                    emitLine(out, "}} else {{");
+                    emitLine(out, "    sp = Stubs::add(vm, sp, code + {});", offset);
+                    emitLine(out, "    if (sp == nullptr) {{ return {{}}; }}");
+                    emitLine(out, "}}");
+                } break;
+                case OpCode::SUBTRACT:
+                case OpCode::MULTIPLY:
+                case OpCode::DIVIDE:
+                case OpCode::LESS:
+                case OpCode::LESS_EQUAL:
+                case OpCode::GREATER:
+                case OpCode::GREATER_EQUAL: {
+                    emitNumbersCheck(out, "sp[-2]", "sp[-1]", offset);
+                    emitLine(out,
+                             "sp[-2] = Value(sp[-2].asNumber() {} sp[-1].asNumber());",
+                             binary);
+                    emitLine(out, "--sp;");
+                } break;
+                case OpCode::ADD_LOCALS:
+                case OpCode::ADD_LOCAL_CONST: {
+                    const std::string a = fmt::format("slots[{}]", ip[1]);
+                    const std::string b = fmt::format("{}[{}]",
+                                                      op == OpCode::ADD_LOCALS ? "slots" : "k",
+                                                      ip[2]);
+                    emitLine(out, "if ({}) {{", numbers(a, b));
+                    emitLine(out, "    *sp++ = Value({}.asNumber() + {}.asNumber());", a, b);
+                    emitLine(out, "}} else {{");
+                    emitLine(out, "    sp = Stubs::{}(vm, sp, code + {});",
+                             op == OpCode::ADD_LOCALS ? "addLocals" : "addLocalConst",
+                             offset);
+                    emitLine(out, "    if (sp == nullptr) {{ return {{}}; }}");
+                    emitLine(out, "}}");
+                } break;
+                case OpCode::LESS_LOCALS:
+                case OpCode::SUBTRACT_LOCAL_CONST:
+                case OpCode::LESS_LOCAL_CONST: {
+                    const std::string a = fmt::format("slots[{}]", ip[1]);
+                    const std::string b = fmt::format("{}[{}]",
+                                                      op == OpCode::LESS_LOCALS ? "slots" : "k",
+                                                      ip[2]);
+                    emitNumbersCheck(out, a, b, offset);
+                    emitLine(out, "*sp++ = Value({}.asNumber() {} {}.asNumber());", a, binary, b);
+                } break;
+                case OpCode::JMP:
+                case OpCode::LOOP: {
+                    emitLine(out, "goto at{};", jumpTarget(chunk, offset, length));
+                } break;
+                case OpCode::JMP_IF_FALSE: {
+                    emitLine(out,
+                             "if (sp[-1].isFalsey()) {{ goto at{}; }}",
+                             jumpTarget(chunk, offset, length));
+                } break;
+                case OpCode::POP_JMP_IF_FALSE:
+                case OpCode::POP_JMP_IF_TRUE: {
+                    emitLine(out, "if ((--sp)->isFalsey() == {}) {{ goto at{}; }}",
+                             op == OpCode::POP_JMP_IF_FALSE,
+                             jumpTarget(chunk, offset, length));
+                } break;
+                case OpCode::JMP_IF_NOT_LESS:
+                case OpCode::JMP_IF_NOT_LESS_EQUAL:
+                case OpCode::JMP_IF_NOT_GREATER:
+                case OpCode::JMP_IF_NOT_GREATER_EQUAL: {
+                    emitNumbersCheck(out, "sp[-2]", "sp[-1]", offset);
+                    emitLine(out, "sp -= 2;");
+                    emitLine(out,
+                             "if ((sp[0].asNumber() {} sp[1].asNumber()) == false) {{ "
+                             "goto at{}; }}",
+                             binary,
+                             jumpTarget(chunk, offset, length));
+                } break;
+                case OpCode::MOVE: {
+                    emitLine(out, "slots[{}] = {};", ip[1], registerOperand(ip[2]));
+                } break;
+                case OpCode::ADD_RK: {
+                    const std::string a = registerOperand(ip[2]);
+                    const std::string b = registerOperand(ip[3]);
+                    emitLine(out, "if ({}) {{", numbers(a, b));
+                    emitLine(out,
+                             "    slots[{}] = Value({}.asNumber() + {}.asNumber());",
+                             ip[1],
+                             a,
+                             b);
+                    emitLine(out, "}} else {{");
+                    emitLine(out, "    sp = Stubs::addRegisters(vm, sp, code + {});", offset);
+                    emitLine(out, "    if (sp == nullptr) {{ return {{}}; }}");
+                    emitLine(out, "}}");
+                } break;
+                case OpCode::SUBTRACT_RK:
+                case OpCode::MULTIPLY_RK:
+                case OpCode::DIVIDE_RK: {
+                    const std::string a = registerOperand(ip[2]);
+                    const std::string b = registerOperand(ip[3]);
+                    emitNumbersCheck(out, a, b, offset);
+                    emitLine(out,
+                             "slots[{}] = Value({}.asNumber() {} {}.asNumber());",
+                             ip[1],
+                             a,
+                             binary,
+                             b);
+                } break;
+                case OpCode::JMP_IF_NOT_LESS_RK:
+                case OpCode::JMP_IF_NOT_LESS_EQUAL_RK:
+                case OpCode::JMP_IF_NOT_GREATER_RK:
+                case OpCode::JMP_IF_NOT_GREATER_EQUAL_RK: {
+                    const std::string a = registerOperand(ip[3]);
+                    const std::string b = registerOperand(ip[4]);
+                    emitNumbersCheck(out, a, b, offset);
+                    emitLine(out,
+                             "if (({}.asNumber() {} {}.asNumber()) == false) {{ goto at{}; }}",
+                             a,
+                             binary,
+                             b,
+                             jumpTarget(chunk, offset, length));
+                } break;
+                case OpCode::DEFINE_GLOBAL:
+                case OpCode::DEFINE_GLOBAL_16: {
+                    emitLine(out, "globals[{}] = *--sp;", operandOf(ip, OpCode::DEFINE_GLOBAL));
+                } break;
+                case OpCode::READ_GLOBAL:
+                case OpCode::READ_GLOBAL_16: {
+                    const std::size_t slot = operandOf(ip, OpCode::READ_GLOBAL);
+                    emitLine(out,
+                             "if (globals[{}].isUndefined()) {{ {} }}",
+                             slot,
+                             error("readGlobal", offset));
+                    emitLine(out, "*sp++ = globals[{}];", slot);
+                } break;
+                case OpCode::SET_GLOBAL:
+                case OpCode::SET_GLOBAL_16: {
+                    const std::size_t slot = operandOf(ip, OpCode::SET_GLOBAL);
+                    emitLine(out,
+                             "if (globals[{}].isUndefined()) {{ {} }}",
+                             slot,
+                             error("setGlobal", offset));
+                    emitLine(out, "globals[{}] = sp[-1];", slot);
+                } break;
+                case OpCode::PRINT: {
+                    emitStub(out, "print", offset);
+                } break;
+                case OpCode::MAKE_CLOSURE:
+                case OpCode::MAKE_CLOSURE_16: {
+                    emitStub(out, "makeClosure", offset);
+                } break;
+                case OpCode::READ_UPVALUE: {
+                    emitStub(out, "readUpvalue", offset);
+                } break;
+                case OpCode::SET_UPVALUE: {
+                    emitStub(out, "setUpvalue", offset);
+                } break;
+                case OpCode::CLOSE_UPVALUE: {
+                    emitStub(out, "closeUpvalue", offset);
+                } break;
+                case OpCode::MAKE_CLASS:
+                case OpCode::MAKE_CLASS_16: {
+                    emitStub(out, "makeClass", offset);
+                } break;
+                case OpCode::METHOD:
+                case OpCode::METHOD_16: {
+                    emitStub(out, "method", offset);
+                } break;
+                case OpCode::INHERIT: {
+                    emitStub(out, "inherit", offset);
+                } break;
+                case OpCode::GET_SUPER:
+                case OpCode::GET_SUPER_16: {
+                    emitStub(out, "getSuper", offset);
+                } break;
+                case OpCode::GET_PROPERTY:
+                case OpCode::GET_PROPERTY_16: {
+                    emitStub(out, "getProperty", offset);
+                } break;
+                case OpCode::SET_PROPERTY:
+                case OpCode::SET_PROPERTY_16: {
+                    emitStub(out, "setProperty", offset);
+                } break;
+                case OpCode::CALL:
+                case OpCode::TAIL_CALL:
+                case OpCode::INVOKE:
+                case OpCode::INVOKE_16:
+                case OpCode::SUPER_INVOKE:
+                case OpCode::SUPER_INVOKE_16:
+                case OpCode::RETURN: {
+                    emitLine(out, "return {{sp, code + {}}};", offset);
+                } break;
+                default: {
+                    return false;
+                } break;
+            }
+
+            return true;
+        }
+
+        // Emits the C++ code of the function with the given index, which
+        // has a block for each instruction. Only the jump targets and the
+        // places the VM resumes the code at are labeled. False if some of
+        // its code can't be translated, the function stays interpreted.
+        bool emitCode(std::string& out, std::size_t index, const Chunk& chunk) {
+            const std::size_t codeSize = chunk.code.getCount();
+            Vector<std::size_t> lengths(codeSize);
+            Vector<bool> labeled(codeSize + 1);
+            Vector<std::size_t> resumePoints;
+            resumePoints.insertBack(0);
+            labeled[0] = true;
+            for (std::size_t offset = 0; offset < codeSize; offset += lengths[offset]) {
+                lengths[offset] = instructionLength(chunk, offset);
+                const auto op = static_cast<OpCode>(chunk.code[offset]);
+                if (isJump(op)) {
+                    labeled[jumpTarget(chunk, offset, lengths[offset])] = true;
+                } else if (leavesCode(op)) {
+                    labeled[offset + lengths[offset]] = true;
+                    resumePoints.insertBack(offset + lengths[offset]);
+                }
+            }
+
+            std::string body;
+            for (std::size_t offset = 0; offset < codeSize; offset += lengths[offset]) {
+                if (labeled[offset]) {
+                    fmt::format_to(std::back_inserter(body), "at{}:\n", offset);
+                }
+                body += "    {\n";
+                if (emitInstruction(body, chunk, offset, lengths[offset]) == false) {
+                    return false;
+                }
+                body += "    }\n";
+            }
+            // the code always ends with a return
+            if (labeled[codeSize]) {
+                fmt::format_to(std::back_inserter(body), "at{}:\n", codeSize);
+            }
+            body += "    return {};\n";
+
+            fmt::format_to(std::back_inserter(out),
+                           "AotExit run{}(const AotFrame& frame,\n"
+                           "              Value* sp,\n"
+                           "              std::size_t resumeAt) {{\n"
+                           "    [[maybe_unused]] VM* const vm = frame.vm;\n"
+                           "    [[maybe_unused]] Value* const slots = frame.slots;\n"
+                           "    [[maybe_unused]] const std::uint8_t* const code = frame.code;\n"
+                           "    [[maybe_unused]] const Value* const k = frame.constants;\n"
+                           "    [[maybe_unused]] Value* const globals = frame.globals;\n"
+                           "    switch (resumeAt) {{\n",
+                           index);
+            for (std::size_t i = 0; i < resumePoints.getCount(); ++i) {
+                fmt::format_to(std::back_inserter(out),
+                               "    case {0}: goto at{0};\n",
+                               resumePoints[i]);
+            }
+            out += "    default: return {sp, code + resumeAt};\n"
+                   "    }\n";
+            out += body;
+            out += "}\n";
+            return true;
+        }
+    } // namespace
+
+    std::string emitCpp(const Function& script, const GlobalTable& globals) {
+        const Vector<const Function*> functions = collectFunctions(script);
+        Vector<bool> translated(functions.getCount());
+        std::string out;
+
+        out += "// Generated by cpplox --emit-cpp, do not edit.\n"
+               "#include \"cpplox/vm/Program.hpp\"\n"
+               "\n"
+               "namespace {\n"
+               "using cpplox::AotExit;\n"
+               "using cpplox::AotFrame;\n"
+               "using cpplox::ConstantImage;\n"
+               "using cpplox::FunctionImage;\n"
+               "using cpplox::Stubs;\n"
+               "using cpplox::Value;\n"
+               "using cpplox::VM;\n"
+               "using Kind = ConstantImage::Kind;\n";
+
+        for (std::size_t i = 0; i < functions.getCount(); ++i) {
+            const Chunk& chunk = functions[i]->chunk;
+            fmt::format_to(std::back_inserter(out),
+                           "\n// {}\n",
+                           std::string_view(functions[i]->name.c_str(), functions[i]->name.size()));
+            emitArray(out, "std::uint8_t", fmt::format("code{}", i), chunk.code);
+            emitArray(out, "unsigned", fmt::format("lines{}", i), chunk.lines);
+            if (chunk.constants.isEmpty() == false) {
+                emitConstants(out, i, chunk.constants, functions);
+            }
+            translated[i] = emitCode(out, i, chunk);
+        }
+
+        out += "\nconst FunctionImage functions[] = {\n";
+        for (std::size_t i = 0; i < functions.getCount(); ++i) {
+            const Function& f = *functions[i];
+            const bool hasConstants = f.chunk.constants.isEmpty() == false;
+            fmt::format_to(std::back_inserter(out),
+                           "    {{{}, {}, {}, {}, code{}, lines{}, {}, {}, {}, {}, {}}},\n",
+                           literal(std::string_view(f.name.c_str(), f.name.size())),
+                           f.arity,
+                           f.upvaluesCount,
+                           f.maxStackSize,
+                           i,
+                           i,
+                           f.chunk.code.getCount(),
+                           hasConstants ? fmt::format("constants{}", i) : "nullptr",
+                           f.chunk.constants.getCount(),
+                           f.chunk.propertyCaches.getCount(),
+                           translated[i] ? fmt::format("run{}", i) : "nullptr");
+        }
+        out += "};\n";
+
+        if (globals.size() > 0) {
+            out += "\nconst char* const globals[] = {\n";
+            for (std::size_t slot = 0; slot < globals.size(); ++slot) {
+                const String& name = globals.nameOf(slot);
+                fmt::format_to(std::back_inserter(out),
+                               "    {},\n",
+                               literal(std::string_view(name.c_str(), name.size())));
+            }
+            out += "};\n";
+        }
+
+        fmt::format_to(std::back_inserter(out),
+                       "\nconst cpplox::ProgramImage program = {{functions, {}, {}, {}}};\n"
+                       "}} // namespace\n"
+                       "\n"
+                       "int main() {{\n"
+                       "    return cpplox::runProgram(program);\n"
+                       "}}\n",
+                       functions.getCount(),
+                       globals.size() > 0 ? "globals" : "nullptr",
+                       globals.size());
+
+        return out;
+    }
+} // namespace cpplox
@@ -111,12 +111,7 @@ namespace cpplox {
     }
 
     void String::updateHash() {
-        // FNV-1a
-        hash = 2166136261u;
-        for (std::size_t i = 0; i < len; i++) {
-            hash ^= static_cast<std::uint8_t>(content[i]);
-            hash *= 16777619;
-        }
+        hash = hashOf(std::string_view(c_str(), len));
     }
 
     const char* String::c_str() const {
@@ -160,6 +155,17 @@ namespace cpplox {
         return *this;
     }
 
+    std::uint32_t hashOf(std::string_view chars) {
+        // FNV-1a
+        std::uint32_t hash = 2166136261u;
+        for (const char c : chars) {
+            hash ^= static_cast<std::uint8_t>(c);
+            hash *= 16777619;
+        }
+
+        return hash;
+    }
+
     bool operator==(const String& lhs, const String& rhs) {
         return lhs.size() == rhs.size() &&
                lhs.hashValue() == rhs.hashValue() &&
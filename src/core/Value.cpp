@@ -1,84 +1,36 @@
 #include "cpplox/core/Value.hpp"
-#include "cpplox/core/String.hpp"
 
 namespace cpplox {
-    Value::Value(String&& s)
-        : type(ValueType::STRING)
-        , as{.string = new String(std::move(s))}
-    {}
-
-    Value::Value(std::string_view s)
-        : type(ValueType::STRING)
-        , as{.string = new String(s)}
-    {}
-
-    Value& Value::operator=(const Value& other) {
-        if (this != &other) {
-            destroy();
-            copy(other);
+#ifdef CPPLOX_NAN_BOXING
+    ValueType Value::internalType() const {
+        if (isNumber()) {
+            return ValueType::NUMBER;
         }
-
-        return *this;
-    }
-
-    Value& Value::operator=(Value&& other) noexcept {
-        if (this != &other) {
-            destroy();
-            move(std::move(other));
+        if (isObject()) {
+            return ValueType::OBJECT;
         }
-
-        return *this;
-    }
-
-    void Value::move(Value&& other) {
-        type = other.type;
-        switch (other.type) {
-            case ValueType::NIL: {
-            } break;
-            case ValueType::BOOL: {
-                this->as.boolean = other.as.boolean;
-            } break;
-            case ValueType::NUMBER: {
-                this->as.number = other.as.number;
-            } break;
-            case ValueType::STRING: {
-                this->as.string = other.as.string;
-            } break;
-            case ValueType::OBJECT: {
-                this->as.object = other.as.object;
-            } break;
+        if (isString()) {
+            return ValueType::STRING;
+        }
+        if (isBoolean()) {
+            return ValueType::BOOL;
+        }
+        if (isUndefined()) {
+            return ValueType::UNDEFINED;
         }
 
-        other.type = ValueType::NIL;
-        other.as.boolean = false;
+        return ValueType::NIL;
     }
 
-    void Value::copy(const Value& other) {
-        type = other.type;
-        switch (other.type) {
-            case ValueType::NIL: {
-            } break;
-            case ValueType::BOOL: {
-                this->as.boolean = other.as.boolean;
-            } break;
-            case ValueType::NUMBER: {
-                this->as.number = other.as.number;
-            } break;
-            case ValueType::STRING: {
-                this->as.string = new String(*other.as.string);
-            } break;
-            case ValueType::OBJECT: {
-                this->as.object = other.as.object;
-            } break;
+    bool Value::operator==(const Value& rhs) const {
+        if (isNumber() && rhs.isNumber()) {
+            return asNumber() == rhs.asNumber();
         }
-    }
 
-    void Value::destroy() {
-        if (type == ValueType::STRING) {
-            delete (this->as.string);
-        }
+        // strings are interned, so equal strings are the same object
+        return bits == rhs.bits;
     }
-
+#else
     bool Value::operator==(const Value& rhs) const {
         if (type != rhs.type) {
             return false;
@@ -92,12 +44,13 @@ namespace cpplox {
                 return asNumber() == rhs.asNumber();
             } break;
             case ValueType::STRING: {
-                return asString() == rhs.asString();
+                return as.string == rhs.as.string;
             } break;
             case ValueType::OBJECT: {
                 return asObject() == rhs.asObject();
             } break;
-            case ValueType::NIL: {
+            case ValueType::NIL:
+            case ValueType::UNDEFINED: {
                 return true;
             } break;
         }
@@ -108,4 +61,5 @@ namespace cpplox {
     bool Value::isFalsey() const {
         return isNil() || (isBoolean() && (asBoolean() == false));
     }
+#endif
 } // namespace cpplox
\ No newline at end of file
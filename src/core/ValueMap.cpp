@@ -19,7 +19,7 @@ namespace cpplox {
         std::size_t tableSize = table.getCount();
         for (std::size_t slot = 0; slot < tableSize; ++slot) {
             const Entry& entry = src.table[slot];
-            if (entry.isEmpty == false) {
+            if (entry.key != nullptr) {
                 table[slot] = entry;
             }
         }
@@ -51,28 +51,26 @@ namespace cpplox {
         return *this;
     }
 
-    void ValueMap::insert(String key, Value v) {
+    void ValueMap::insert(const String* key, Value v) {
         growIfFillingUp();
 
         std::size_t slot = findSlot(key);
         Entry& entry = table[slot];
-        entry.key = std::move(key);
-        entry.value = std::move(v);
-
-        if (entry.isEmpty) {
-            entry.isEmpty = false;
+        if (entry.key == nullptr) {
+            entry.key = key;
             ++count;
         }
+        entry.value = v;
     }
 
-    bool ValueMap::find(const String& key, Value& v) const {
+    bool ValueMap::find(const String* key, Value& v) const {
         if (isEmpty()) {
             return false;
         }
 
         std::size_t slot = findSlot(key);
         const Entry& e = table[slot];
-        if (e.isEmpty == false) {
+        if (e.key != nullptr) {
             v = e.value;
             return true;
         } else {
@@ -80,13 +78,13 @@ namespace cpplox {
         }
     }
 
-    bool ValueMap::contains(const String& key) const {
+    bool ValueMap::contains(const String* key) const {
         if (isEmpty()) {
             return false;
         }
 
         std::size_t slot = findSlot(key);
-        return table[slot].isEmpty == false;
+        return table[slot].key != nullptr;
     }
 
     bool ValueMap::isEmpty() const {
@@ -97,47 +95,50 @@ namespace cpplox {
         *this = ValueMap();
     }
 
-    bool ValueMap::remove(const String& key, Value& v) {
+    bool ValueMap::remove(const String* key, Value& v) {
         if (isEmpty()) {
             return false;
         }
 
         std::size_t slot = findSlot(key);
         Entry& entry = table[slot];
-        if (entry.isEmpty) {
+        if (entry.key == nullptr) {
             return false;
         }
 
-        entry.isEmpty = true;
-        entry.key = String{};
-        v = std::move(entry.value);
+        v = entry.value;
+        entry = Entry{};
+        --count;
 
+        // re-insert the rest of the cluster so that lookups
+        // don't stop at the freed slot
         Vector<Entry> entries;
         std::size_t tableSize = table.getCount();
-        slot = slot + 1 % tableSize;
+        slot = (slot + 1) % tableSize;
         for (;;) {
             Entry& e = table[slot];
-            if (e.isEmpty) {
+            if (e.key == nullptr) {
                 break;
             }
 
-            entries.insertBack(std::move(e));
-            e.isEmpty = true;
+            entries.insertBack(e);
+            e = Entry{};
+            --count;
 
-            slot = slot + 1 % tableSize;
+            slot = (slot + 1) % tableSize;
         }
         insertEntries(entries, *this);
 
         return true;
     }
 
-    std::size_t ValueMap::findSlot(const String& key) const {
+    std::size_t ValueMap::findSlot(const String* key) const {
         std::size_t tableSize = table.getCount();
-        std::size_t slot = key.hashValue() % tableSize;
+        std::size_t slot = key->hashValue() % tableSize;
 
         for (;;) {
             const Entry& entry = table[slot];
-            if (entry.isEmpty || entry.key == key) {
+            if (entry.key == nullptr || entry.key == key) {
                 return slot;
             }
 
@@ -160,7 +161,7 @@ namespace cpplox {
         std::size_t tableSize = table.getCount();
         for (std::size_t slot = 0; slot < tableSize; ++slot) {
             const Entry& e = table[slot];
-            if (e.isEmpty == false) {
+            if (e.key != nullptr) {
                 map.insert(e.key, e.value);
             }
         }
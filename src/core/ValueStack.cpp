@@ -1,37 +1,31 @@
 #include "cpplox/core/ValueStack.hpp"
 
 namespace cpplox {
-    void ValueStack::reserve(std::size_t size) {
-        stack.reserve(size);
+    ValueStack::ValueStack(std::size_t capacity)
+        : items(new Value[capacity]{})
+        , top(items)
+        , limit(items + capacity)
+    {
     }
 
-    Value ValueStack::pop() {
-        Value v = std::move(stack.back());
-        stack.removeBack();
-        return v;
+    ValueStack::~ValueStack() {
+        delete[] items;
     }
 
-    void ValueStack::popN(std::size_t n) {
-        for (; n > 0; --n) {
-            if (isEmpty()) {
-                break;
-            }
-
-            stack.removeBack();
-        }
-    }
-
-    const Value& ValueStack::peekN(std::size_t n) const {
-        const std::size_t i = stack.getCount() - 1 - n;
-        return stack[i];
+    Value ValueStack::pop() {
+        --top;
+        return std::move(*top);
     }
 
-    Value& ValueStack::peekN(std::size_t n) {
-        const std::size_t i = stack.getCount() - 1 - n;
-        return stack[i];
+    void ValueStack::popN(std::size_t n) {
+        const std::size_t count = size();
+        top -= (n < count) ? n : count;
     }
 
     void ValueStack::clear() {
-        stack.clear();
+        for (Value* v = items; v != top; ++v) {
+            *v = Value::nil();
+        }
+        top = items;
     }
-} // namespace cpplox
\ No newline at end of file
+} // namespace cpplox
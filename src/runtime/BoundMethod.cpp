@@ -9,9 +9,6 @@ namespace cpplox {
 
     void BoundMethod::trace(gc::Visitor& v) {
         v.visit(method);
-
-        if (receiver.isObject()) {
-            v.visit(receiver.asObject());
-        }
+        v.visit(receiver);
     }
 } // namespace cpplox
\ No newline at end of file
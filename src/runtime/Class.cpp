@@ -1,16 +1,19 @@
 #include "cpplox/runtime/Class.hpp"
+#include "cpplox/runtime/Shape.hpp"
 
 namespace cpplox {
-    Class::Class(const String& name)
+    Class::Class(const String& name, Shape* rootShape)
         : Object(Class::TYPE)
         , name(name)
+        , rootShape(rootShape)
     {}
 
     void Class::trace(gc::Visitor& v) {
-        methods.forEachValue([&v](Value& val) {
-            if (val.isObject()) {
-                v.visit(val.asObject());
-            }
+        v.visit(rootShape);
+
+        methods.forEachEntry([&v](const String* name, Value& method) {
+            v.visit(Value(name));
+            v.visit(method);
         });
     }
-}
\ No newline at end of file
+}
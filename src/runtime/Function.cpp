@@ -1,4 +1,6 @@
 #include "cpplox/runtime/Function.hpp"
+#include "cpplox/runtime/Closure.hpp"
+#include "cpplox/runtime/Shape.hpp"
 #include "cpplox/core/Algorithm.hpp"
 
 namespace cpplox {
@@ -9,8 +11,13 @@ namespace cpplox {
 
     void Function::trace(gc::Visitor& v) {
         forEach(chunk.constants, [&v](Value& val) {
-            if (val.isObject()) {
-                v.visit(val.asObject());
+            v.visit(val);
+        });
+        forEach(chunk.propertyCaches, [&v](PropertyCache& cache) {
+            for (PropertyCache::Entry& e : cache.entries) {
+                v.visit(const_cast<Shape*>(e.shape));
+                v.visit(e.next);
+                v.visit(e.method);
             }
         });
     }
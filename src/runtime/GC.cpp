@@ -1,10 +1,16 @@
 #include "cpplox/runtime/GC.hpp"
+#include "cpplox/runtime/StringObject.hpp"
+
+#include <cstdint>
 
 namespace cpplox::gc {
-    class Marker : public Visitor {
-    public:
-        void visit(Object* obj) override;
-    };
+    void Visitor::visit(const Value& v) {
+        if (v.isObject()) {
+            visit(const_cast<Object*>(v.asObject()));
+        } else if (v.isString()) {
+            visit(StringObject::from(v.asString()));
+        }
+    }
 
     void Marker::visit(Object* obj) {
         if (obj == nullptr || obj->isReachable) {
@@ -17,23 +23,42 @@ namespace cpplox::gc {
 #endif
 
         obj->isReachable = true;
-        obj->trace(*this);
+        gray.insertBack(obj);
     }
 
-    void traceRoot(Object* obj) {
-#ifdef CPPLOX_DEBUG_LOG_GC
-        println("Start trace with root of type {} at {}",
-                static_cast<int>(obj->type()),
-                static_cast<void*>(obj));
+    void Marker::trace() {
+        while (trace(SIZE_MAX) == false) {}
+    }
+
+    bool Marker::trace(std::size_t count) {
+        for (; count > 0 && gray.isEmpty() == false; --count) {
+            Object* obj = gray.back();
+            gray.removeBack();
+#if defined(__GNUC__) || defined(__clang__)
+            // the next gray object is traced right after this one,
+            // fetch it while the children of this one are visited
+            if (gray.isEmpty() == false) {
+                __builtin_prefetch(gray.back());
+            }
 #endif
+            obj->trace(*this);
+        }
 
-        Marker marker;
-        marker.visit(obj);
+        return gray.isEmpty();
+    }
 
-#ifdef CPPLOX_DEBUG_LOG_GC
-        println("End trace with root at {}",
-                static_cast<void*>(obj));
-#endif
+    void Marker::retrace(Object* obj) {
+        gray.insertBack(obj);
+    }
+
+    bool isYoung(const Value& v) {
+        if (v.isObject()) {
+            return v.asObject()->isOld == false;
+        }
+        if (v.isString()) {
+            return StringObject::from(v.asString())->isOld == false;
+        }
+        return false;
     }
 
     void freeObject(Object* obj) {
@@ -0,0 +1,73 @@
+#include "cpplox/runtime/GlobalTable.hpp"
+
+#include <cstring>
+
+namespace cpplox {
+    static inline const std::size_t INDEX_DEFAULT_SIZE = 64;
+    static inline const std::size_t INDEX_GROWTH_FACTOR = 2;
+
+    GlobalTable::GlobalTable() : index(INDEX_DEFAULT_SIZE) {}
+
+    std::size_t GlobalTable::slotFor(std::string_view name) {
+        std::size_t slot = 0;
+        if (find(name, slot)) {
+            return slot;
+        }
+
+        growIndexIfFillingUp();
+
+        slot = slots.getCount();
+        names.insertBack(String(name));
+        slots.insertBack(Value::undefined());
+        index[findIndex(name, names.back().hashValue())] = slot + 1;
+
+        return slot;
+    }
+
+    bool GlobalTable::find(std::string_view name, std::size_t& slot) const {
+        const std::size_t entry = index[findIndex(name, hashOf(name))];
+        if (entry == 0) {
+            return false;
+        }
+
+        slot = entry - 1;
+        return true;
+    }
+
+    std::size_t GlobalTable::findIndex(std::string_view name, std::uint32_t hash) const {
+        const std::size_t indexSize = index.getCount();
+        std::size_t i = hash % indexSize;
+
+        for (;;) {
+            const std::size_t entry = index[i];
+            if (entry == 0) {
+                return i;
+            }
+
+            const String& n = names[entry - 1];
+            if (n.hashValue() == hash &&
+                n.size() == name.size() &&
+                std::memcmp(n.c_str(), name.data(), name.size()) == 0)
+            {
+                return i;
+            }
+
+            i = (i + 1) % indexSize;
+        }
+    }
+
+    void GlobalTable::growIndexIfFillingUp() {
+        // keep the load factor at most 0.75
+        if ((names.getCount() + 1) * 4 <= index.getCount() * 3) {
+            return;
+        }
+
+        index = Vector<std::size_t>(index.getCount() * INDEX_GROWTH_FACTOR);
+        const std::size_t count = names.getCount();
+        for (std::size_t slot = 0; slot < count; ++slot) {
+            const String& n = names[slot];
+            const std::string_view chars(n.c_str(), n.size());
+            index[findIndex(chars, n.hashValue())] = slot + 1;
+        }
+    }
+} // namespace cpplox
@@ -1,19 +1,32 @@
 #include "cpplox/runtime/Instance.hpp"
 #include "cpplox/runtime/Class.hpp"
+#include "cpplox/runtime/Shape.hpp"
 
 namespace cpplox {
     Instance::Instance(Class* c)
         : Object(Instance::TYPE)
         , klass(c)
-    {}
+        , shape(c->rootShape)
+    {
+        fields.reserve(c->fieldCountHint);
+    }
 
     void Instance::trace(gc::Visitor& v) {
         v.visit(klass);
+        v.visit(shape);
+
+        for (std::size_t i = 0; i < fields.getCount(); ++i) {
+            v.visit(fields[i]);
+        }
+    }
+
+    bool Instance::getField(const String* name, Value& result) const {
+        std::size_t slot = 0;
+        if (shape->find(name, slot)) {
+            result = fields[slot];
+            return true;
+        }
 
-        fields.forEachValue([&v](Value& val) {
-            if (val.isObject()) {
-                v.visit(val.asObject());
-            }
-        });
+        return false;
     }
-} // namespace cpplox
\ No newline at end of file
+} // namespace cpplox
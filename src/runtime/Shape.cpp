@@ -0,0 +1,54 @@
+#include "cpplox/runtime/Shape.hpp"
+#include "cpplox/runtime/StringObject.hpp"
+
+namespace cpplox {
+    Shape::Shape(const Shape& parent, const String* name)
+        : Object(Shape::TYPE)
+    {
+        names.reserve(parent.names.getCount() + 1);
+        for (std::size_t i = 0; i < parent.names.getCount(); ++i) {
+            names.insertBack(parent.names[i]);
+        }
+        names.insertBack(name);
+    }
+
+    void Shape::trace(gc::Visitor& v) {
+        // The names must outlive the shape, as another string
+        // allocated at the same address would match them.
+        for (std::size_t i = 0; i < names.getCount(); ++i) {
+            v.visit(StringObject::from(*names[i]));
+        }
+        for (std::size_t i = 0; i < transitions.getCount(); ++i) {
+            v.visit(transitions[i].next);
+        }
+    }
+
+    bool Shape::find(const String* name, std::size_t& slot) const {
+        // Instances have few fields, a linear scan
+        // over pointers beats hashing the name.
+        const std::size_t count = names.getCount();
+        const String* const* data = names.data();
+        for (std::size_t i = 0; i < count; ++i) {
+            if (data[i] == name) {
+                slot = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    Shape* Shape::transition(const String* name) const {
+        for (std::size_t i = 0; i < transitions.getCount(); ++i) {
+            if (transitions[i].name == name) {
+                return transitions[i].next;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void Shape::addTransition(const String* name, Shape* next) {
+        transitions.insertBack(Transition{.name = name, .next = next});
+    }
+} // namespace cpplox
@@ -0,0 +1,15 @@
+#include "cpplox/runtime/StringObject.hpp"
+
+namespace cpplox {
+    StringObject::StringObject(std::string_view chars)
+        : Object(StringObject::TYPE)
+        , String(chars)
+    {}
+
+    StringObject::StringObject(String&& s)
+        : Object(StringObject::TYPE)
+        , String(std::move(s))
+    {}
+
+    void StringObject::trace(gc::Visitor&) {}
+} // namespace cpplox
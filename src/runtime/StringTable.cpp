@@ -0,0 +1,70 @@
+#include "cpplox/runtime/StringTable.hpp"
+#include "cpplox/runtime/StringObject.hpp"
+
+#include <cstring>
+
+namespace cpplox {
+    static inline const std::size_t TABLE_DEFAULT_SIZE = 64;
+    static inline const std::size_t TABLE_GROWTH_FACTOR = 2;
+
+    StringTable::StringTable() : table(TABLE_DEFAULT_SIZE) {}
+
+    StringObject* StringTable::find(std::string_view chars) const {
+        return table[findSlot(chars, hashOf(chars))];
+    }
+
+    StringObject* StringTable::find(const String& s) const {
+        return table[findSlot(std::string_view(s.c_str(), s.size()), s.hashValue())];
+    }
+
+    void StringTable::insert(StringObject* s) {
+        growIfFillingUp();
+
+        const std::string_view chars(s->c_str(), s->size());
+        table[findSlot(chars, s->hashValue())] = s;
+        ++count;
+    }
+
+    void StringTable::removeUnreachable() {
+        rebuild(table.getCount(), true);
+    }
+
+    std::size_t StringTable::findSlot(std::string_view chars, std::uint32_t hash) const {
+        const std::size_t tableSize = table.getCount();
+        std::size_t slot = hash % tableSize;
+
+        for (;;) {
+            const StringObject* s = table[slot];
+            if (s == nullptr ||
+                (s->hashValue() == hash &&
+                 s->size() == chars.size() &&
+                 std::memcmp(s->c_str(), chars.data(), chars.size()) == 0))
+            {
+                return slot;
+            }
+
+            slot = (slot + 1) % tableSize;
+        }
+    }
+
+    void StringTable::growIfFillingUp() {
+        // keep the load factor at most 0.75
+        if ((count + 1) * 4 > table.getCount() * 3) {
+            rebuild(table.getCount() * TABLE_GROWTH_FACTOR, false);
+        }
+    }
+
+    void StringTable::rebuild(std::size_t tableSize, bool onlyReachable) {
+        Vector<StringObject*> old(std::move(table));
+        table = Vector<StringObject*>(tableSize);
+        count = 0;
+
+        const std::size_t oldSize = old.getCount();
+        for (std::size_t i = 0; i < oldSize; ++i) {
+            StringObject* s = old[i];
+            if (s != nullptr && (s->isReachable || onlyReachable == false)) {
+                insert(s);
+            }
+        }
+    }
+} // namespace cpplox
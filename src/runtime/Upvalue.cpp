@@ -2,8 +2,8 @@
 
 namespace cpplox {
     void Upvalue::trace(gc::Visitor& v) {
-        if (location != nullptr && location->isObject()) {
-            v.visit(location->asObject());
-        }
+        // an open upvalue refers to a stack slot, which is a root
+        // the program writes to while the marking runs on a thread
+        v.visit(closed);
     }
 }
\ No newline at end of file
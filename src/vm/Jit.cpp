@@ -0,0 +1,795 @@
+#include "cpplox/vm/Jit.hpp"
+
+#ifdef CPPLOX_JIT
+
+#include "cpplox/vm/VM.hpp"
+#include "cpplox/vm/X64Assembler.hpp"
+#include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
+#include "cpplox/runtime/Function.hpp"
+#include "cpplox/runtime/Closure.hpp"
+
+#include <bit>
+#include <cstring>
+#include <new>
+#include <sys/mman.h>
+
+namespace cpplox {
+    using x64::Cond;
+    using x64::Label;
+    using x64::Reg;
+    using x64::Xmm;
+
+    namespace {
+        constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+        constexpr std::size_t PAGE_SIZE = 4096;
+        constexpr std::size_t CODE_ALIGNMENT = 16;
+        // bail-outs after which the machine code of a function is dropped,
+        // its bytecode has seen other operand types since it was compiled
+        constexpr std::uint32_t MAX_BAILOUTS = 8;
+        // the machine code dropped of a function after which it stays
+        // interpreted, the memory of dropped code is not reused
+        constexpr std::uint32_t MAX_RECOMPILES = 4;
+
+        // The registers which hold the state of the frame for the whole
+        // function. They are callee-saved, so the stubs preserve them.
+        constexpr Reg VM_REG = Reg::RBX;
+        constexpr Reg SLOTS = Reg::R12;
+        constexpr Reg SP = Reg::R13;
+        constexpr Reg NIL = Reg::R14;
+        constexpr Reg NAN_BITS = Reg::R15;
+
+        std::uint64_t bitsOf(const Value& v) {
+            return std::bit_cast<std::uint64_t>(v);
+        }
+
+        template <typename T>
+        std::uint64_t addressOf(T* p) {
+            return reinterpret_cast<std::uintptr_t>(p);
+        }
+
+        std::int32_t slotOffset(std::size_t index) {
+            return static_cast<std::int32_t>(index * sizeof(Value));
+        }
+
+        std::size_t roundUp(std::size_t size, std::size_t alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+    } // namespace
+
+    class Jit::Generator {
+    public:
+        Generator(const Chunk& chunk, Value* const* globals)
+            : chunk(chunk)
+            , globals(globals)
+        {}
+
+        bool generate();
+
+        const Vector<std::uint8_t>& code() const { return a.code(); }
+        bool isResumePoint(std::size_t offset) const { return resumable[offset]; }
+        // the offset of the machine code of the instruction at offset
+        std::size_t codeOffsetOf(std::size_t offset) const {
+            return a.offsetOf(labels[offset]);
+        }
+
+    private:
+        struct SlowPath {
+            Label entry;
+            Label resume;
+            // bails out to the interpreter if there is none
+            Stub stub = nullptr;
+            const std::uint8_t* ip = nullptr;
+        };
+
+        void prologue();
+        void epilogue();
+        bool instruction(std::size_t offset, std::size_t length);
+        void slowPaths();
+
+        // A stub called out of line when the inline code can't handle the
+        // operands, it runs the whole instruction and resumes after it.
+        Label slowPath(Stub stub, std::size_t offset, std::size_t length);
+        // Leaves the machine code for the interpreter to run the instruction
+        // at offset, when the operands don't have the types its specialized
+        // code expects. The interpreter comes back at the next back edge.
+        Label bailOut(std::size_t offset);
+        void callStub(Stub stub, const std::uint8_t* ip);
+        // leaves the machine code, the interpreter runs the instruction at ip
+        void exit(const std::uint8_t* ip);
+
+        void push(Reg r);
+        // the n-th value from the top of the stack, 0 is the top
+        void loadTop(Reg dst, std::size_t n);
+        void loadLocal(Reg dst, std::size_t index);
+        // dst = a source operand of a register instruction
+        void loadRK(Reg dst, std::uint8_t rk);
+        // dst = the address of the global variable values
+        void loadGlobals(Reg dst);
+        void jumpIfNotNumber(Reg value, Label target);
+        // xmm0 = rax, xmm1 = rcx if both are numbers
+        void numberOperands(Label notNumbers);
+        // rax = the Value of the boolean in rax (0 or 1)
+        void boolValue();
+        // compares value to the falsey values, below or equal if it is one
+        void testFalsey(Reg value);
+        Label jumpTarget(std::size_t offset, std::size_t length, bool backward) const;
+
+    private:
+        const Chunk& chunk;
+        // where the VM keeps the address of the globals, which
+        // stays the same while the code runs
+        Value* const* globals = nullptr;
+        x64::Assembler a;
+        // indexed by bytecode offset, only instruction starts have one,
+        // the one at the end of the code marks falling off it
+        Vector<Label> labels;
+        Vector<bool> resumable;
+        Vector<SlowPath> slow;
+        Label epilogueLabel;
+        Label errorLabel;
+        std::uint64_t nilBits = 0;
+        std::uint64_t falseBits = 0;
+        std::uint64_t undefinedBits = 0;
+    };
+
+    bool Jit::Generator::generate() {
+        const std::size_t codeSize = chunk.code.getCount();
+        labels = Vector<Label>(codeSize + 1);
+        resumable = Vector<bool>(codeSize + 1);
+
+        nilBits = bitsOf(Value::nil());
+        falseBits = bitsOf(Value(false));
+        undefinedBits = bitsOf(Value::undefined());
+        // boolValue relies on true following false, testFalsey
+        // on false following nil
+        if (falseBits != nilBits + 1 || bitsOf(Value(true)) != falseBits + 1) {
+            return false;
+        }
+
+        Vector<std::size_t> lengths(codeSize);
+        for (std::size_t offset = 0; offset < codeSize;) {
+            lengths[offset] = instructionLength(chunk, offset);
+            labels[offset] = a.newLabel();
+            offset += lengths[offset];
+        }
+        labels[codeSize] = a.newLabel();
+        epilogueLabel = a.newLabel();
+        errorLabel = a.newLabel();
+
+        prologue();
+        resumable[0] = true;
+        for (std::size_t offset = 0; offset < codeSize; offset += lengths[offset]) {
+            a.bind(labels[offset]);
+            if (instruction(offset, lengths[offset]) == false) {
+                return false;
+            }
+        }
+
+        // the code always ends with a return
+        a.bind(labels[codeSize]);
+        a.jmp(errorLabel);
+        slowPaths();
+        epilogue();
+
+        return a.finish();
+    }
+
+    void Jit::Generator::prologue() {
+        // JitExit entry(VM* vm, Value* slots, Value* sp, const void* target)
+        a.push(Reg::RBX);
+        a.push(Reg::R12);
+        a.push(Reg::R13);
+        a.push(Reg::R14);
+        a.push(Reg::R15);
+        a.mov(VM_REG, Reg::RDI);
+        a.mov(SLOTS, Reg::RSI);
+        a.mov(SP, Reg::RDX);
+        a.mov(NIL, nilBits);
+        a.mov(NAN_BITS, Value::NAN_BITS);
+        // five pushes after the return address keep rsp 16-byte aligned for calls
+        a.jmp(Reg::RCX);
+    }
+
+    void Jit::Generator::epilogue() {
+        a.bind(errorLabel);
+        a.xor_(Reg::RAX, Reg::RAX);
+        a.bind(epilogueLabel);
+        a.pop(Reg::R15);
+        a.pop(Reg::R14);
+        a.pop(Reg::R13);
+        a.pop(Reg::R12);
+        a.pop(Reg::RBX);
+        a.ret();
+    }
+
+    void Jit::Generator::slowPaths() {
+        for (std::size_t i = 0; i < slow.getCount(); ++i) {
+            const SlowPath& path = slow[i];
+            a.bind(path.entry);
+            if (path.stub == nullptr) {
+                exit(path.ip);
+                continue;
+            }
+            callStub(path.stub, path.ip);
+            a.jmp(path.resume);
+        }
+    }
+
+    Label Jit::Generator::slowPath(Stub stub, std::size_t offset, std::size_t length) {
+        const Label entry = a.newLabel();
+        slow.insertBack(SlowPath{
+            .entry = entry,
+            .resume = labels[offset + length],
+            .stub = stub,
+            .ip = chunk.code.data() + offset,
+        });
+        return entry;
+    }
+
+    Label Jit::Generator::bailOut(std::size_t offset) {
+        return slowPath(nullptr, offset, 0);
+    }
+
+    void Jit::Generator::callStub(Stub stub, const std::uint8_t* ip) {
+        a.mov(Reg::RDI, VM_REG);
+        a.mov(Reg::RSI, SP);
+        a.mov(Reg::RDX, addressOf(ip));
+        a.mov(Reg::RAX, reinterpret_cast<std::uintptr_t>(stub));
+        a.call(Reg::RAX);
+        a.test(Reg::RAX, Reg::RAX);
+        a.jcc(Cond::E, errorLabel);
+        a.mov(SP, Reg::RAX);
+    }
+
+    void Jit::Generator::exit(const std::uint8_t* ip) {
+        a.mov(Reg::RAX, SP);
+        a.mov(Reg::RDX, addressOf(ip));
+        a.jmp(epilogueLabel);
+    }
+
+    void Jit::Generator::push(Reg r) {
+        a.store(SP, 0, r);
+        a.add(SP, static_cast<std::int32_t>(sizeof(Value)));
+    }
+
+    void Jit::Generator::loadTop(Reg dst, std::size_t n) {
+        a.load(dst, SP, -slotOffset(n + 1));
+    }
+
+    void Jit::Generator::loadLocal(Reg dst, std::size_t index) {
+        a.load(dst, SLOTS, slotOffset(index));
+    }
+
+    void Jit::Generator::loadRK(Reg dst, std::uint8_t rk) {
+        if ((rk & RK_CONSTANT) != 0) {
+            a.mov(dst, bitsOf(chunk.constants[rk & ~RK_CONSTANT]));
+        } else {
+            loadLocal(dst, rk);
+        }
+    }
+
+    void Jit::Generator::loadGlobals(Reg dst) {
+        a.mov(dst, addressOf(globals));
+        a.load(dst, dst, 0);
+    }
+
+    void Jit::Generator::jumpIfNotNumber(Reg value, Label target) {
+        a.mov(Reg::RDX, value);
+        a.and_(Reg::RDX, NAN_BITS);
+        a.cmp(Reg::RDX, NAN_BITS);
+        a.jcc(Cond::E, target);
+    }
+
+    void Jit::Generator::numberOperands(Label notNumbers) {
+        jumpIfNotNumber(Reg::RAX, notNumbers);
+        jumpIfNotNumber(Reg::RCX, notNumbers);
+        a.movq(Xmm::XMM0, Reg::RAX);
+        a.movq(Xmm::XMM1, Reg::RCX);
+    }
+
+    void Jit::Generator::boolValue() {
+        a.add(Reg::RAX, NIL);
+        a.add(Reg::RAX, static_cast<std::int32_t>(falseBits - nilBits));
+    }
+
+    void Jit::Generator::testFalsey(Reg value) {
+        a.mov(Reg::RCX, value);
+        a.sub(Reg::RCX, NIL);
+        a.cmp(Reg::RCX, static_cast<std::int32_t>(falseBits - nilBits));
+    }
+
+    Label Jit::Generator::jumpTarget(std::size_t offset,
+                                     std::size_t length,
+                                     bool backward) const {
+        const std::size_t next = offset + length;
+        const std::size_t jump = parseTwoByteInteger(chunk.code[offset + 1],
+                                                     chunk.code[offset + 2]);
+        return labels[backward ? next - jump : next + jump];
+    }
+
+    bool Jit::Generator::instruction(std::size_t offset, std::size_t length) {
+        const std::uint8_t* const ip = chunk.code.data() + offset;
+        const OpCode op = static_cast<OpCode>(*ip);
+        const std::int32_t VALUE_SIZE = sizeof(Value);
+
+        switch (op) {
+            case OpCode::CONSTANT:
+            case OpCode::CONSTANT_16: {
+                a.mov(Reg::RAX, bitsOf(chunk.constants[operandOf(ip, OpCode::CONSTANT)]));
+                push(Reg::RAX);
+            } break;
+            case OpCode::NIL: {
+                push(NIL);
+            } break;
+            case OpCode::TRUE:
+            case OpCode::FALSE: {
+                a.mov(Reg::RAX, bitsOf(Value(op == OpCode::TRUE)));
+                push(Reg::RAX);
+            } break;
+            case OpCode::POP: {
+                a.sub(SP, VALUE_SIZE);
+            } break;
+            case OpCode::POP_N:
+            case OpCode::POP_N_16: {
+                a.sub(SP, slotOffset(operandOf(ip, OpCode::POP_N)));
+            } break;
+            case OpCode::READ_LOCAL:
+            case OpCode::READ_LOCAL_16: {
+                loadLocal(Reg::RAX, operandOf(ip, OpCode::READ_LOCAL));
+                push(Reg::RAX);
+            } break;
+            case OpCode::SET_LOCAL:
+            case OpCode::SET_LOCAL_16: {
+                loadTop(Reg::RAX, 0);
+                a.store(SLOTS, slotOffset(operandOf(ip, OpCode::SET_LOCAL)), Reg::RAX);
+            } break;
+            case OpCode::SET_LOCAL_POP: {
+                loadTop(Reg::RAX, 0);
+                a.sub(SP, VALUE_SIZE);
+                a.store(SLOTS, slotOffset(ip[1]), Reg::RAX);
+            } break;
+            case OpCode::NOT: {
+                loadTop(Reg::RAX, 0);
+                testFalsey(Reg::RAX);
+                a.set(Cond::BE, Reg::RAX);
+                boolValue();
+                a.store(SP, -VALUE_SIZE, Reg::RAX);
+            } break;
+            case OpCode::NEGATE: {
+                loadTop(Reg::RAX, 0);
+                jumpIfNotNumber(Reg::RAX, slowPath(&Stubs::numberError, offset, length));
+                a.btc(Reg::RAX, 63);
+                a.store(SP, -VALUE_SIZE, Reg::RAX);
+            } break;
+            case OpCode::EQUAL:
+            case OpCode::NOT_EQUAL: {
+                // numbers compare as doubles (NaN != NaN, 0 == -0),
+                // everything else by identity of the bits
+                const Label compareBits = a.newLabel();
+                const Label done = a.newLabel();
+                loadTop(Reg::RAX, 1);
+                loadTop(Reg::RCX, 0);
+                numberOperands(compareBits);
+                a.ucomisd(Xmm::XMM0, Xmm::XMM1);
+                a.set(Cond::E, Reg::RAX);
+                a.set(Cond::NP, Reg::RDX);
+                a.and_(Reg::RAX, Reg::RDX);
+                a.jmp(done);
+                a.bind(compareBits);
+                a.cmp(Reg::RAX, Reg::RCX);
+                a.set(Cond::E, Reg::RAX);
+                a.bind(done);
+                if (op == OpCode::NOT_EQUAL) {
+                    a.xor_(Reg::RAX, 1);
+                }
+                boolValue();
+                a.sub(SP, VALUE_SIZE);
+                a.store(SP, -VALUE_SIZE, Reg::RAX);
+            } break;
+            // The interpreter has quickened an ADD to the form of the
+            // operands it has seen, the code is specialized for them.
+            // A generic ADD has seen both or none yet.
+            case OpCode::ADD_STR: {
+                callStub(&Stubs::add, ip);
+            } break;
+            case OpCode::ADD:
+            case OpCode::ADD_NUM:
+            case OpCode::SUBTRACT:
+            case OpCode::MULTIPLY:
+            case OpCode::DIVIDE: {
+                const bool isAdd = op == OpCode::ADD || op == OpCode::ADD_NUM;
+                loadTop(Reg::RAX, 1);
+                loadTop(Reg::RCX, 0);
+                Label notNumbers;
+                if (op == OpCode::ADD_NUM) {
+                    notNumbers = bailOut(offset);
+                } else {
+                    notNumbers = slowPath(isAdd ? &Stubs::add : &Stubs::numbersError,
+                                          offset,
+                                          length);
+                }
+                numberOperands(notNumbers);
+                if (isAdd) {
+                    a.addsd(Xmm::XMM0, Xmm::XMM1);
+                } else if (op == OpCode::SUBTRACT) {
+                    a.subsd(Xmm::XMM0, Xmm::XMM1);
+                } else if (op == OpCode::MULTIPLY) {
+                    a.mulsd(Xmm::XMM0, Xmm::XMM1);
+                } else {
+                    a.divsd(Xmm::XMM0, Xmm::XMM1);
+                }
+                a.movq(Reg::RAX, Xmm::XMM0);
+                a.sub(SP, VALUE_SIZE);
+                a.store(SP, -VALUE_SIZE, Reg::RAX);
+            } break;
+            case OpCode::LESS:
+            case OpCode::LESS_EQUAL:
+            case OpCode::GREATER:
+            case OpCode::GREATER_EQUAL: {
+                // ucomisd sets the flags of an unsigned comparison, with
+                // all of them set for NaN, so a < b is tested as b > a
+                loadTop(Reg::RAX, 1);
+                loadTop(Reg::RCX, 0);
+                numberOperands(slowPath(&Stubs::numbersError, offset, length));
+                const bool swap = op == OpCode::LESS || op == OpCode::LESS_EQUAL;
+                a.ucomisd(swap ? Xmm::XMM1 : Xmm::XMM0, swap ? Xmm::XMM0 : Xmm::XMM1);
+                const bool strict = op == OpCode::LESS || op == OpCode::GREATER;
+                a.set(strict ? Cond::A : Cond::AE, Reg::RAX);
+                boolValue();
+                a.sub(SP, VALUE_SIZE);
+                a.store(SP, -VALUE_SIZE, Reg::RAX);
+            } break;
+            case OpCode::ADD_LOCALS:
+            case OpCode::LESS_LOCALS: {
+                loadLocal(Reg::RAX, ip[1]);
+                loadLocal(Reg::RCX, ip[2]);
+                if (op == OpCode::ADD_LOCALS) {
+                    numberOperands(slowPath(&Stubs::addLocals, offset, length));
+                    a.addsd(Xmm::XMM0, Xmm::XMM1);
+                    a.movq(Reg::RAX, Xmm::XMM0);
+                } else {
+                    numberOperands(slowPath(&Stubs::numbersError, offset, length));
+                    a.ucomisd(Xmm::XMM1, Xmm::XMM0);
+                    a.set(Cond::A, Reg::RAX);
+                    boolValue();
+                }
+                push(Reg::RAX);
+            } break;
+            case OpCode::ADD_LOCAL_CONST:
+            case OpCode::SUBTRACT_LOCAL_CONST:
+            case OpCode::LESS_LOCAL_CONST: {
+                const Value& constant = chunk.constants[ip[2]];
+                const Label slowLabel = slowPath(
+                    op == OpCode::ADD_LOCAL_CONST ? &Stubs::addLocalConst : &Stubs::numbersError,
+                    offset,
+                    length);
+                if (constant.isNumber() == false) {
+                    a.jmp(slowLabel);
+                    break;
+                }
+
+                loadLocal(Reg::RAX, ip[1]);
+                jumpIfNotNumber(Reg::RAX, slowLabel);
+                a.movq(Xmm::XMM0, Reg::RAX);
+                a.mov(Reg::RCX, bitsOf(constant));
+                a.movq(Xmm::XMM1, Reg::RCX);
+                if (op == OpCode::ADD_LOCAL_CONST) {
+                    a.addsd(Xmm::XMM0, Xmm::XMM1);
+                    a.movq(Reg::RAX, Xmm::XMM0);
+                } else if (op == OpCode::SUBTRACT_LOCAL_CONST) {
+                    a.subsd(Xmm::XMM0, Xmm::XMM1);
+                    a.movq(Reg::RAX, Xmm::XMM0);
+                } else {
+                    a.ucomisd(Xmm::XMM1, Xmm::XMM0);
+                    a.set(Cond::A, Reg::RAX);
+                    boolValue();
+                }
+                push(Reg::RAX);
+            } break;
+            case OpCode::JMP: {
+                a.jmp(jumpTarget(offset, length, false));
+            } break;
+            case OpCode::LOOP: {
+                // the interpreter enters a running loop at its start
+                const std::size_t next = offset + length;
+                resumable[next - parseTwoByteInteger(ip[1], ip[2])] = true;
+                a.jmp(jumpTarget(offset, length, true));
+            } break;
+            case OpCode::JMP_IF_FALSE: {
+                loadTop(Reg::RAX, 0);
+                testFalsey(Reg::RAX);
+                a.jcc(Cond::BE, jumpTarget(offset, length, false));
+            } break;
+            case OpCode::POP_JMP_IF_FALSE:
+            case OpCode::POP_JMP_IF_TRUE: {
+                loadTop(Reg::RAX, 0);
+                a.sub(SP, VALUE_SIZE);
+                testFalsey(Reg::RAX);
+                a.jcc(op == OpCode::POP_JMP_IF_FALSE ? Cond::BE : Cond::A,
+                      jumpTarget(offset, length, false));
+            } break;
+            case OpCode::JMP_IF_NOT_LESS:
+            case OpCode::JMP_IF_NOT_LESS_EQUAL:
+            case OpCode::JMP_IF_NOT_GREATER:
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL: {
+                loadTop(Reg::RAX, 1);
+                loadTop(Reg::RCX, 0);
+                numberOperands(slowPath(&Stubs::numbersError, offset, length));
+                a.sub(SP, 2 * VALUE_SIZE);
+                const bool swap = op == OpCode::JMP_IF_NOT_LESS ||
+                                  op == OpCode::JMP_IF_NOT_LESS_EQUAL;
+                a.ucomisd(swap ? Xmm::XMM1 : Xmm::XMM0, swap ? Xmm::XMM0 : Xmm::XMM1);
+                // the negation of A is BE and of AE is B, both taken for NaN
+                const bool strict = op == OpCode::JMP_IF_NOT_LESS ||
+                                    op == OpCode::JMP_IF_NOT_GREATER;
+                a.jcc(strict ? Cond::BE : Cond::B, jumpTarget(offset, length, false));
+            } break;
+            case OpCode::MOVE: {
+                loadRK(Reg::RAX, ip[2]);
+                a.store(SLOTS, slotOffset(ip[1]), Reg::RAX);
+            } break;
+            case OpCode::ADD_RK:
+            case OpCode::SUBTRACT_RK:
+            case OpCode::MULTIPLY_RK:
+            case OpCode::DIVIDE_RK: {
+                loadRK(Reg::RAX, ip[2]);
+                loadRK(Reg::RCX, ip[3]);
+                numberOperands(slowPath(op == OpCode::ADD_RK ? &Stubs::addRegisters
+                                                             : &Stubs::numbersError,
+                                        offset,
+                                        length));
+                if (op == OpCode::ADD_RK) {
+                    a.addsd(Xmm::XMM0, Xmm::XMM1);
+                } else if (op == OpCode::SUBTRACT_RK) {
+                    a.subsd(Xmm::XMM0, Xmm::XMM1);
+                } else if (op == OpCode::MULTIPLY_RK) {
+                    a.mulsd(Xmm::XMM0, Xmm::XMM1);
+                } else {
+                    a.divsd(Xmm::XMM0, Xmm::XMM1);
+                }
+                a.movq(Reg::RAX, Xmm::XMM0);
+                a.store(SLOTS, slotOffset(ip[1]), Reg::RAX);
+            } break;
+            case OpCode::JMP_IF_NOT_LESS_RK:
+            case OpCode::JMP_IF_NOT_LESS_EQUAL_RK:
+            case OpCode::JMP_IF_NOT_GREATER_RK:
+            case OpCode::JMP_IF_NOT_GREATER_EQUAL_RK: {
+                loadRK(Reg::RAX, ip[3]);
+                loadRK(Reg::RCX, ip[4]);
+                numberOperands(slowPath(&Stubs::numbersError, offset, length));
+                const bool swap = op == OpCode::JMP_IF_NOT_LESS_RK ||
+                                  op == OpCode::JMP_IF_NOT_LESS_EQUAL_RK;
+                a.ucomisd(swap ? Xmm::XMM1 : Xmm::XMM0, swap ? Xmm::XMM0 : Xmm::XMM1);
+                const bool strict = op == OpCode::JMP_IF_NOT_LESS_RK ||
+                                    op == OpCode::JMP_IF_NOT_GREATER_RK;
+                a.jcc(strict ? Cond::BE : Cond::B, jumpTarget(offset, length, false));
+            } break;
+            case OpCode::PRINT: {
+                callStub(&Stubs::print, ip);
+            } break;
+            case OpCode::DEFINE_GLOBAL:
+            case OpCode::DEFINE_GLOBAL_16: {
+                loadGlobals(Reg::RDX);
+                loadTop(Reg::RAX, 0);
+                a.sub(SP, VALUE_SIZE);
+                a.store(Reg::RDX, slotOffset(operandOf(ip, OpCode::DEFINE_GLOBAL)), Reg::RAX);
+            } break;
+            case OpCode::READ_GLOBAL:
+            case OpCode::READ_GLOBAL_16: {
+                // an undefined variable is reported by the stub
+                loadGlobals(Reg::RDX);
+                a.load(Reg::RAX, Reg::RDX, slotOffset(operandOf(ip, OpCode::READ_GLOBAL)));
+                a.mov(Reg::RCX, undefinedBits);
+                a.cmp(Reg::RAX, Reg::RCX);
+                a.jcc(Cond::E, slowPath(&Stubs::readGlobal, offset, length));
+                push(Reg::RAX);
+            } break;
+            case OpCode::SET_GLOBAL:
+            case OpCode::SET_GLOBAL_16: {
+                const std::int32_t slot = slotOffset(operandOf(ip, OpCode::SET_GLOBAL));
+                loadGlobals(Reg::RDX);
+                a.load(Reg::RAX, Reg::RDX, slot);
+                a.mov(Reg::RCX, undefinedBits);
+                a.cmp(Reg::RAX, Reg::RCX);
+                a.jcc(Cond::E, slowPath(&Stubs::setGlobal, offset, length));
+                loadTop(Reg::RAX, 0);
+                a.store(Reg::RDX, slot, Reg::RAX);
+            } break;
+            case OpCode::MAKE_CLOSURE:
+            case OpCode::MAKE_CLOSURE_16: {
+                callStub(&Stubs::makeClosure, ip);
+            } break;
+            case OpCode::READ_UPVALUE: {
+                callStub(&Stubs::readUpvalue, ip);
+            } break;
+            case OpCode::SET_UPVALUE: {
+                callStub(&Stubs::setUpvalue, ip);
+            } break;
+            case OpCode::CLOSE_UPVALUE: {
+                callStub(&Stubs::closeUpvalue, ip);
+            } break;
+            case OpCode::MAKE_CLASS:
+            case OpCode::MAKE_CLASS_16: {
+                callStub(&Stubs::makeClass, ip);
+            } break;
+            case OpCode::METHOD:
+            case OpCode::METHOD_16: {
+                callStub(&Stubs::method, ip);
+            } break;
+            case OpCode::INHERIT: {
+                callStub(&Stubs::inherit, ip);
+            } break;
+            case OpCode::GET_SUPER:
+            case OpCode::GET_SUPER_16: {
+                callStub(&Stubs::getSuper, ip);
+            } break;
+            case OpCode::GET_PROPERTY:
+            case OpCode::GET_PROPERTY_16: {
+                callStub(&Stubs::getProperty, ip);
+            } break;
+            case OpCode::SET_PROPERTY:
+            case OpCode::SET_PROPERTY_16: {
+                callStub(&Stubs::setProperty, ip);
+            } break;
+            // The interpreter runs calls and returns, and continues in the
+            // machine code of the callee or the caller. Execution comes
+            // back here after the call has returned.
+            case OpCode::CALL:
+            case OpCode::TAIL_CALL:
+            case OpCode::INVOKE:
+            case OpCode::INVOKE_16:
+            case OpCode::SUPER_INVOKE:
+            case OpCode::SUPER_INVOKE_16: {
+                exit(ip);
+                resumable[offset + length] = true;
+            } break;
+            case OpCode::RETURN: {
+                exit(ip);
+            } break;
+            default: {
+                return false;
+            } break;
+        }
+
+        return true;
+    }
+
+    Jit::Jit(VM& vm)
+        : vm(vm)
+    {}
+
+    Jit::~Jit() {
+        for (std::size_t i = 0; i < codes.getCount(); ++i) {
+            delete codes[i];
+        }
+        for (std::size_t i = 0; i < blocks.getCount(); ++i) {
+            munmap(blocks[i].memory, blocks[i].size);
+        }
+    }
+
+    bool Jit::compile(Function& f) {
+        Generator generator(f.chunk, &globals);
+        const std::uint8_t* code = generator.generate() ? install(generator.code())
+                                                        : nullptr;
+        JitCode* jitCode = code != nullptr ? new (std::nothrow) JitCode : nullptr;
+        if (jitCode == nullptr) {
+            f.jitFailed = true;
+            return false;
+        }
+
+        // the entry sequence is at the start of the code
+        jitCode->entry = reinterpret_cast<JitEntry>(code);
+        const std::size_t codeSize = f.chunk.code.getCount();
+        jitCode->resumePoints = Vector<const void*>(codeSize);
+        for (std::size_t offset = 0; offset < codeSize; ++offset) {
+            if (generator.isResumePoint(offset)) {
+                jitCode->resumePoints[offset] = code + generator.codeOffsetOf(offset);
+            }
+        }
+
+        codes.insertBack(jitCode);
+        f.jitCode = jitCode;
+        return true;
+    }
+
+    const std::uint8_t* Jit::install(const Vector<std::uint8_t>& code) {
+        const std::size_t size = code.getCount();
+        if (blocks.isEmpty() || blocks.back().size - blocks.back().used < size) {
+            const std::size_t blockSize = size > BLOCK_SIZE ? roundUp(size, PAGE_SIZE)
+                                                            : BLOCK_SIZE;
+            void* memory = mmap(nullptr,
+                                blockSize,
+                                PROT_READ | PROT_EXEC,
+                                MAP_PRIVATE | MAP_ANONYMOUS,
+                                -1,
+                                0);
+            if (memory == MAP_FAILED) {
+                return nullptr;
+            }
+            blocks.insertBack(CodeBlock{
+                .memory = static_cast<std::uint8_t*>(memory),
+                .size = blockSize,
+            });
+        }
+
+        // a block is writable only while code is copied into it
+        CodeBlock& block = blocks.back();
+        if (mprotect(block.memory, block.size, PROT_READ | PROT_WRITE) != 0) {
+            return nullptr;
+        }
+        std::uint8_t* start = block.memory + block.used;
+        std::memcpy(start, code.data(), size);
+        block.used += roundUp(size, CODE_ALIGNMENT);
+        if (mprotect(block.memory, block.size, PROT_READ | PROT_EXEC) != 0) {
+            return nullptr;
+        }
+
+        return start;
+    }
+
+    bool Jit::resume() {
+        VM::CallFrame& frame = vm.frames.back();
+        Function* function = frame.closure->function;
+        const std::size_t offset = static_cast<std::size_t>(frame.ip - function->chunk.code.data());
+        const void* target = function->jitCode->resumePoints[offset];
+        if (target == nullptr) {
+            return true;
+        }
+
+        // the stubs never push or pop frames, so frame stays valid
+        const JitExit exit = function->jitCode->entry(&vm,
+                                                      vm.stack.data() + frame.bp,
+                                                      vm.stack.end(),
+                                                      target);
+        if (exit.sp == nullptr) {
+            return false;
+        }
+
+        frame.ip = exit.ip;
+        vm.stack.setEnd(exit.sp);
+        if (isBailOut(exit.ip) && ++function->jitCode->bailOuts > MAX_BAILOUTS) {
+            drop(*function);
+        }
+        return true;
+    }
+
+    void Jit::drop(Function& f) {
+        // no frame runs the code, it leaves before every call
+        for (std::size_t i = 0; i < codes.getCount(); ++i) {
+            if (codes[i] == f.jitCode) {
+                codes.removeAt(i);
+                break;
+            }
+        }
+        delete f.jitCode;
+        f.jitCode = nullptr;
+
+        if (++f.recompileCount > MAX_RECOMPILES) {
+            f.jitFailed = true;
+        } else {
+            // compiled again from the bytecode quickened since, once it is hot
+            f.callCount = 0;
+            f.backEdgeCount = 0;
+        }
+    }
+
+    bool Jit::isBailOut(const std::uint8_t* ip) {
+        switch (static_cast<OpCode>(*ip)) {
+            case OpCode::CALL:
+            case OpCode::TAIL_CALL:
+            case OpCode::INVOKE:
+            case OpCode::INVOKE_16:
+            case OpCode::SUPER_INVOKE:
+            case OpCode::SUPER_INVOKE_16:
+            case OpCode::RETURN: {
+                return false;
+            } break;
+            default: {
+                return true;
+            } break;
+        }
+    }
+} // namespace cpplox
+
+#endif
@@ -0,0 +1,139 @@
+#include "cpplox/vm/Program.hpp"
+#include "cpplox/vm/VM.hpp"
+#include "cpplox/runtime/Function.hpp"
+#include "cpplox/runtime/StringObject.hpp"
+#include "cpplox/runtime/GlobalTable.hpp"
+#include "cpplox/runtime/GC.hpp"
+#include "cpplox/core/Algorithm.hpp"
+#include "cpplox/core/StringFormatter.hpp"
+#include "cpplox/log/Log.hpp"
+
+#include <bit>
+#include <locale>
+#include <string_view>
+
+namespace cpplox {
+    namespace {
+        template <typename T, typename... Args>
+        T* makeObject(Vector<Object*>& objects, Args&&... args) {
+            T* obj = gc::makeObject<T>(std::forward<Args>(args)...);
+            if (obj != nullptr) {
+                objects.insertBack(obj);
+            }
+            return obj;
+        }
+
+        bool loadConstant(const ConstantImage& image,
+                          const Vector<Function*>& functions,
+                          Vector<Object*>& objects,
+                          Value& result) {
+            switch (image.kind) {
+            case ConstantImage::Kind::NIL: {
+                result = Value::nil();
+            } break;
+            case ConstantImage::Kind::BOOLEAN: {
+                result = Value(image.payload != 0);
+            } break;
+            case ConstantImage::Kind::NUMBER: {
+                result = Value(std::bit_cast<double>(image.payload));
+            } break;
+            case ConstantImage::Kind::STRING: {
+                // the VM interns the strings when it takes the objects
+                const std::string_view chars(image.chars, image.payload);
+                auto* s = makeObject<StringObject>(objects, chars);
+                if (s == nullptr) {
+                    return false;
+                }
+                result = s->asValue();
+            } break;
+            case ConstantImage::Kind::FUNCTION: {
+                if (image.payload >= functions.getCount()) {
+                    return false;
+                }
+                result = Value(functions[image.payload]);
+            } break;
+            }
+
+            return true;
+        }
+
+        // creates the functions of program and their constants, every
+        // object created is added to objects, nullptr on failure
+        Function* loadProgram(const ProgramImage& program,
+                              GlobalTable& globals,
+                              Vector<Object*>& objects) {
+            // the code indexes the globals by the slots the compiler gave
+            // them, a fresh table hands out the same slots in order
+            for (std::size_t slot = 0; slot < program.globalsCount; ++slot) {
+                if (globals.slotFor(program.globals[slot]) != slot) {
+                    return nullptr;
+                }
+            }
+
+            Vector<Function*> functions;
+            functions.reserve(program.functionsCount);
+            for (std::size_t i = 0; i < program.functionsCount; ++i) {
+                const FunctionImage& image = program.functions[i];
+                auto* f = makeObject<Function>(objects, std::string_view(image.name));
+                if (f == nullptr) {
+                    return nullptr;
+                }
+                f->arity = image.arity;
+                f->upvaluesCount = image.upvaluesCount;
+                f->maxStackSize = image.maxStackSize;
+                f->aotEntry = image.entry;
+                functions.insertBack(f);
+            }
+
+            for (std::size_t i = 0; i < program.functionsCount; ++i) {
+                const FunctionImage& image = program.functions[i];
+                Chunk& chunk = functions[i]->chunk;
+                chunk.code.reserve(image.codeSize);
+                chunk.lines.reserve(image.codeSize);
+                for (std::size_t k = 0; k < image.codeSize; ++k) {
+                    chunk.code.insertBack(image.code[k]);
+                    chunk.lines.insertBack(image.lines[k]);
+                }
+
+                chunk.constants.reserve(image.constantsCount);
+                for (std::size_t k = 0; k < image.constantsCount; ++k) {
+                    Value constant;
+                    if (loadConstant(image.constants[k], functions, objects, constant) == false) {
+                        return nullptr;
+                    }
+                    chunk.constants.insertBack(constant);
+                }
+
+                chunk.propertyCaches.reserve(image.propertyCachesCount);
+                for (std::size_t k = 0; k < image.propertyCachesCount; ++k) {
+                    chunk.propertyCaches.insertBack(PropertyCache{});
+                }
+            }
+
+            return functions.isEmpty() ? nullptr : functions[0];
+        }
+    } // namespace
+
+    int runProgram(const ProgramImage& program) {
+        std::locale::global(std::locale("en_US.UTF-8"));
+
+        VM vm;
+        Vector<Object*> objects;
+        Function* script = loadProgram(program, vm.globalTable(), objects);
+        if (script == nullptr) {
+            forEach(objects, [](Object* o) {
+                gc::freeObject(o);
+            });
+            errorln("Runtime error: Failed to load the program");
+            return 70;
+        }
+
+        const InterpretResult r = vm.interpret(script, std::move(objects));
+        if (r.code == InterpretResultCode::RUNTIME_ERROR) {
+            errorln("Runtime error: {}", r.error);
+            return 70;
+        }
+
+        return 0;
+    }
+} // namespace cpplox
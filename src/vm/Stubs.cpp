@@ -0,0 +1,250 @@
+#include "cpplox/vm/Stubs.hpp"
+#include "cpplox/vm/VM.hpp"
+#include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
+#include "cpplox/runtime/Function.hpp"
+#include "cpplox/runtime/Closure.hpp"
+#include "cpplox/runtime/Upvalue.hpp"
+#include "cpplox/runtime/Class.hpp"
+#include "cpplox/runtime/Instance.hpp"
+
+namespace cpplox {
+    // Makes the state of the frame visible to the VM: errors report the
+    // line of ip and the GC sees the values up to sp.
+    void Stubs::syncState(VM& vm, Value* sp, const std::uint8_t* ip) {
+        vm.frames.back().ip = ip + 1;
+        vm.stack.setEnd(sp);
+    }
+
+    Value* Stubs::numbersError(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        vm->runtimeError("Operands must be numbers.");
+        return nullptr;
+    }
+
+    Value* Stubs::numberError(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        vm->runtimeError("Operand must be a number.");
+        return nullptr;
+    }
+
+    Value* Stubs::add(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        Value result;
+        if (vm->addValues(sp[-2], sp[-1], result) == false) {
+            return nullptr;
+        }
+        sp[-2] = result;
+        return sp - 1;
+    }
+
+    Value* Stubs::addLocals(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        const Value* slots = vm->stack.data() + vm->frames.back().bp;
+        Value result;
+        if (vm->addValues(slots[ip[1]], slots[ip[2]], result) == false) {
+            return nullptr;
+        }
+        *sp = result;
+        return sp + 1;
+    }
+
+    Value* Stubs::addLocalConst(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        const VM::CallFrame& frame = vm->frames.back();
+        const Value& local = vm->stack.at(frame.bp + ip[1]);
+        const Value& constant = frame.closure->function->chunk.constants[ip[2]];
+        Value result;
+        if (vm->addValues(local, constant, result) == false) {
+            return nullptr;
+        }
+        *sp = result;
+        return sp + 1;
+    }
+
+    Value* Stubs::addRegisters(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        const VM::CallFrame& frame = vm->frames.back();
+        Value* slots = vm->stack.data() + frame.bp;
+        const Value* constants = frame.closure->function->chunk.constants.data();
+        const auto rk = [slots, constants](std::uint8_t operand) -> const Value& {
+            return (operand & RK_CONSTANT) != 0 ? constants[operand & ~RK_CONSTANT]
+                                                : slots[operand];
+        };
+        Value result;
+        if (vm->addValues(rk(ip[2]), rk(ip[3]), result) == false) {
+            return nullptr;
+        }
+        slots[ip[1]] = result;
+        return sp;
+    }
+
+    Value* Stubs::print(VM* vm, Value* sp, const std::uint8_t*) {
+        vm->printValue(sp[-1]);
+        return sp - 1;
+    }
+
+    Value* Stubs::readGlobal(VM* vm, Value* sp, const std::uint8_t* ip) {
+        const std::size_t slot = operandOf(ip, OpCode::READ_GLOBAL);
+        const Value& value = vm->globals.values()[slot];
+        if (value.isUndefined()) {
+            syncState(*vm, sp, ip);
+            vm->runtimeError("Undefined variable '\"{}\"'.", vm->globals.nameOf(slot));
+            return nullptr;
+        }
+        *sp = value;
+        return sp + 1;
+    }
+
+    Value* Stubs::setGlobal(VM* vm, Value* sp, const std::uint8_t* ip) {
+        const std::size_t slot = operandOf(ip, OpCode::SET_GLOBAL);
+        Value& value = vm->globals.values()[slot];
+        if (value.isUndefined()) {
+            syncState(*vm, sp, ip);
+            vm->runtimeError("Undefined variable '\"{}\"'.", vm->globals.nameOf(slot));
+            return nullptr;
+        }
+        value = sp[-1];
+        return sp;
+    }
+
+    Value* Stubs::makeClosure(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        Chunk& chunk = vm->frames.back().closure->function->chunk;
+        Value& value = chunk.constants[operandOf(ip, OpCode::MAKE_CLOSURE)];
+        Function* function = value.isObject() ? value.asObject()->as<Function>()
+                                              : nullptr;
+        if (function == nullptr) {
+            vm->runtimeError("Internal error.");
+            return nullptr;
+        }
+
+        const std::uint8_t* upvalues = ip + operandEnd(ip, OpCode::MAKE_CLOSURE);
+        if (vm->makeClosure(function, upvalues) == false) {
+            return nullptr;
+        }
+        return vm->stack.end();
+    }
+
+    Value* Stubs::readUpvalue(VM* vm, Value* sp, const std::uint8_t* ip) {
+        *sp = *(vm->frames.back().closure->upvalues[ip[1]]->location);
+        return sp + 1;
+    }
+
+    Value* Stubs::setUpvalue(VM* vm, Value* sp, const std::uint8_t* ip) {
+        Upvalue* upvalue = vm->frames.back().closure->upvalues[ip[1]];
+        const VM::HeapLock lock = vm->beforeStore(*(upvalue->location));
+        *(upvalue->location) = sp[-1];
+        vm->writeBarrier(upvalue, sp[-1]);
+        return sp;
+    }
+
+    Value* Stubs::closeUpvalue(VM* vm, Value* sp, const std::uint8_t*) {
+        vm->closeUpvalues(static_cast<std::size_t>(sp - 1 - vm->stack.data()));
+        return sp - 1;
+    }
+
+    Value* Stubs::makeClass(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        const Chunk& chunk = vm->frames.back().closure->function->chunk;
+        const Value& name = chunk.constants[operandOf(ip, OpCode::MAKE_CLASS)];
+        if (name.isString() && vm->makeClass(name.asString()) == false) {
+            return nullptr;
+        }
+        return vm->stack.end();
+    }
+
+    Value* Stubs::method(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        const Chunk& chunk = vm->frames.back().closure->function->chunk;
+        const Value& name = chunk.constants[operandOf(ip, OpCode::METHOD)];
+        if (name.isString()) {
+            vm->defineMethod(name.asString());
+        }
+        return vm->stack.end();
+    }
+
+    Value* Stubs::inherit(VM* vm, Value* sp, const std::uint8_t* ip) {
+        syncState(*vm, sp, ip);
+        if (vm->inherit() == false) {
+            return nullptr;
+        }
+        return vm->stack.end();
+    }
+
+    Value* Stubs::getSuper(VM* vm, Value* sp, const std::uint8_t* ip) {
+        const Chunk& chunk = vm->frames.back().closure->function->chunk;
+        const Value& name = chunk.constants[operandOf(ip, OpCode::GET_SUPER)];
+        Value superclass = sp[-1];
+        syncState(*vm, sp - 1, ip);
+        Class* super = superclass.asObject()->as<Class>();
+        if (super != nullptr && vm->bindMethod(super, name.asString()) == false) {
+            return nullptr;
+        }
+        return vm->stack.end();
+    }
+
+    Value* Stubs::getProperty(VM* vm, Value* sp, const std::uint8_t* ip) {
+        Chunk& chunk = vm->frames.back().closure->function->chunk;
+        const Value& name = chunk.constants[operandOf(ip, OpCode::GET_PROPERTY)];
+        const std::size_t cacheAt = operandEnd(ip, OpCode::GET_PROPERTY);
+        PropertyCache& cache =
+            chunk.propertyCaches[parseTwoByteInteger(ip[cacheAt], ip[cacheAt + 1])];
+
+        Value& instance = sp[-1];
+        Instance* inst = instance.isObject() ? instance.asObject()->as<Instance>()
+                                             : nullptr;
+        if (inst == nullptr) {
+            syncState(*vm, sp, ip);
+            vm->runtimeError("Only instances have properties.");
+            return nullptr;
+        }
+
+        const PropertyCache::Entry* hit = cache.find(inst->shape);
+        if (hit != nullptr && hit->method == nullptr) {
+            instance = inst->fields[hit->slot];
+            return sp;
+        }
+
+        syncState(*vm, sp, ip);
+        const bool ok = hit != nullptr ? vm->bindMethod(hit->method)
+                                       : vm->getProperty(inst, name.asString(), cache);
+        return ok ? vm->stack.end() : nullptr;
+    }
+
+    Value* Stubs::setProperty(VM* vm, Value* sp, const std::uint8_t* ip) {
+        Chunk& chunk = vm->frames.back().closure->function->chunk;
+        const Value& name = chunk.constants[operandOf(ip, OpCode::SET_PROPERTY)];
+        const std::size_t cacheAt = operandEnd(ip, OpCode::SET_PROPERTY);
+        PropertyCache& cache =
+            chunk.propertyCaches[parseTwoByteInteger(ip[cacheAt], ip[cacheAt + 1])];
+
+        Value& instance = sp[-2];
+        Instance* inst = instance.isObject() ? instance.asObject()->as<Instance>()
+                                             : nullptr;
+        if (inst == nullptr) {
+            syncState(*vm, sp, ip);
+            vm->runtimeError("Only instances have fields.");
+            return nullptr;
+        }
+
+        const PropertyCache::Entry* hit = cache.find(inst->shape);
+        if (hit != nullptr && hit->next == nullptr) {
+            const VM::HeapLock lock = vm->beforeStore(inst->fields[hit->slot]);
+            inst->fields[hit->slot] = sp[-1];
+            vm->writeBarrier(inst, sp[-1]);
+        } else if (hit != nullptr) {
+            const VM::HeapLock lock = vm->beforeStore(inst);
+            inst->shape = hit->next;
+            inst->fields.insertBack(sp[-1]);
+            vm->writeBarrier(inst);
+        } else {
+            syncState(*vm, sp, ip);
+            if (vm->setProperty(inst, name.asString(), sp[-1], cache) == false) {
+                return nullptr;
+            }
+        }
+        instance = sp[-1];
+        return sp - 1;
+    }
+} // namespace cpplox
@@ -1,4 +1,5 @@
 #include "cpplox/vm/VM.hpp"
+#include "cpplox/vm/Program.hpp"
 #include "cpplox/bytecode/Disassembler.hpp"
 #include "cpplox/bytecode/OpCode.hpp"
 #include "cpplox/bytecode/Bytecode.hpp"
@@ -8,22 +9,53 @@
 #include "cpplox/runtime/Upvalue.hpp"
 #include "cpplox/runtime/Class.hpp"
 #include "cpplox/runtime/Instance.hpp"
+#include "cpplox/runtime/Shape.hpp"
 #include "cpplox/runtime/BoundMethod.hpp"
+#include "cpplox/runtime/StringObject.hpp"
 #include "cpplox/runtime/GC.hpp"
 #include "cpplox/log/Log.hpp"
 #include "cpplox/core/Algorithm.hpp"
 #include "cpplox/core/Format.hpp"
 
+#include <algorithm>
 #include <iterator>
+#include <system_error>
 #include <fmt/format.h>
 
 namespace cpplox {
+    namespace {
+        // the allocations between two steps of an incremental collection
+        constexpr std::uint64_t GC_STEP_BYTES = 64 * 1024;
+        // the objects a step handles between two looks at the clock
+        constexpr std::size_t GC_STEP_OBJECTS = 32;
+    } // namespace
+
+    VM::VM(const VMOptions& opts)
+        : stack(opts.stackSize)
+        , nurserySize(opts.nurserySize)
+        , incrementalGC(opts.incrementalGC || opts.concurrentGC)
+        , concurrentGC(opts.concurrentGC)
+        , gcPauseBudget(opts.gcPauseBudget)
+#ifdef CPPLOX_JIT
+        , jitThreshold(opts.jitThreshold)
+        , osrThreshold(opts.osrThreshold)
+        , jit(*this)
+#endif
+    {
+        initString = internString(std::string_view("init"));
+    }
+
     VM::~VM() {
-        // ok for now, will be managed by the runtime GC
-        forEach(gcObjects, [](Object* o) {
-            gc::freeObject(o);
-        });
-        gcObjects.clear();
+        if (markerThread.joinable()) {
+            markerThread.join();
+        }
+        for (Object* list : {nursery, oldObjects}) {
+            while (list != nullptr) {
+                Object* next = list->next;
+                gc::freeObject(list);
+                list = next;
+            }
+        }
     }
 
     InterpretResult VM::interpret(Function* func, Vector<Object*>&& objects) {
@@ -39,20 +71,34 @@ namespace cpplox {
         }
 
         addObjects(std::move(objects));
-        stack.reserve(2056);
+#ifdef CPPLOX_JIT
+        jit.setGlobals(globals.values());
+#endif
         frames.reserve(512);
 
+        // the script is kept on the stack while its closure is allocated
+        if (stack.capacity() == 0) {
+            runtimeError("Stack overflow.");
+            result.code = InterpretResultCode::RUNTIME_ERROR;
+            result.error = std::move(error);
+            return result;
+        }
+
         stack.push(Value(func));
         Closure* closure = makeObject<Closure>(func);
-        if (closure != nullptr) {
+        if (closure == nullptr) {
+            result.code = InterpretResultCode::RUNTIME_ERROR;
+        } else {
             stack.pop();
             stack.push(Value(closure));
-            call(closure, 0);
-
-            result.code = run();
-        }
-        else {
-            result.code = InterpretResultCode::RUNTIME_ERROR;
+            if (call(closure, 0)) {
+                result.code = run();
+            } else {
+                result.code = InterpretResultCode::RUNTIME_ERROR;
+            }
+#ifdef CPPLOX_DEBUG_TRACE_EXECUTION
+            println("=== {} instructions executed ===", executedInstructions);
+#endif
         }
 
         result.error = std::move(error);
@@ -64,433 +110,898 @@ namespace cpplox {
     }
 
     void VM::addObjects(Vector<Object*>&& objects) {
+        // The compiler interns strings only within a single compilation.
+        // Intern them in the VM table and make the constants refer to the
+        // interned strings, so that equal strings are the same object.
+        forEach(objects, [this] (Object* o) {
+            StringObject* s = o->as<StringObject>();
+            if (s != nullptr && strings.find(*s) == nullptr) {
+                strings.insert(s);
+            }
+        });
         forEach(objects, [this] (Object* o) {
-            gcObjects.insertBack(o);
-            bytesAllocated += objectSize(o);
+            Function* f = o->as<Function>();
+            if (f != nullptr) {
+                forEach(f->chunk.constants, [this] (Value& c) {
+                    if (c.isString()) {
+                        StringObject* s = strings.find(c.asString());
+                        stringFound(s);
+                        c = s->asValue();
+                    }
+                });
+            }
+        });
+
+        forEach(objects, [this] (Object* o) {
+            StringObject* s = o->as<StringObject>();
+            if (s != nullptr && strings.find(*s) != s) {
+                gc::freeObject(s);
+            } else {
+                track(o);
+            }
         });
         objects.clear();
     }
 
+    StringObject* VM::internString(std::string_view chars) {
+        StringObject* s = strings.find(chars);
+        if (s == nullptr) {
+            s = makeObject<StringObject>(chars);
+            if (s != nullptr) {
+                strings.insert(s);
+            }
+        } else {
+            stringFound(s);
+        }
+
+        return s;
+    }
+
+    StringObject* VM::internString(String&& chars) {
+        StringObject* s = strings.find(chars);
+        if (s == nullptr) {
+            s = makeObject<StringObject>(std::move(chars));
+            if (s != nullptr) {
+                strings.insert(s);
+            }
+        } else {
+            stringFound(s);
+        }
+
+        return s;
+    }
+
+    StringObject* VM::concatenate(const String& a, const String& b) {
+        String result;
+        result.reserve(a.size() + b.size() + 1);
+        result += a;
+        result += b;
+
+        return internString(std::move(result));
+    }
+
+#ifdef CPPLOX_COMPUTED_GOTO
+    // labels as values are a GNU extension
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
     InterpretResultCode VM::run() {
-        CallFrame* frame = &frames.back();
+        // The hot interpreter state lives in locals. It is written back to
+        // the current CallFrame and the ValueStack only before calling out
+        // to code which inspects them - calls, returns, allocations (GC)
+        // and runtime errors.
+        CallFrame* frame = nullptr;
+        const std::uint8_t* ip = nullptr;
+        Value* constants = nullptr;
+        Value* slots = nullptr;
+        Value* sp = nullptr;
+
+        const auto storeState = [&] {
+            frame->ip = ip;
+            stack.setEnd(sp);
+        };
+        const auto loadState = [&] {
+            frame = &frames.back();
+            ip = frame->ip;
+            constants = frame->closure->function->chunk.constants.data();
+            slots = stack.data() + frame->bp;
+            sp = stack.end();
+        };
+        loadState();
 
-        const auto readByte = [&frame] {
-            return *(frame->ip++);
+        const auto readByte = [&ip] {
+            return *(ip++);
         };
         const auto readIdx16 = [&readByte] {
             auto a = readByte();
             auto b = readByte();
             return parseTwoByteInteger(a, b);
         };
-        const auto readConstant = [&frame, &readByte] {
-            return frame->closure->function->chunk.constants[readByte()];
+        const auto readConstant = [&constants, &readByte]() -> Value& {
+            return constants[readByte()];
+        };
+        const auto readConstant16 = [&constants, &readIdx16]() -> Value& {
+            return constants[readIdx16()];
         };
-        const auto readConstant16 = [&frame, &readIdx16] {
-            return frame->closure->function->chunk.constants[readIdx16()];
+        // a source operand of a register instruction
+        const auto readRK = [&constants, &slots, &readByte]() -> const Value& {
+            const std::uint8_t rk = readByte();
+            return (rk & RK_CONSTANT) != 0 ? constants[rk & ~RK_CONSTANT] : slots[rk];
+        };
+
+        // Rewrites the opcode of the current instruction, which has no
+        // operands, to a form specialized for the operands it has seen.
+        const auto quicken = [&ip](OpCode op) {
+            const_cast<std::uint8_t*>(ip)[-1] = static_cast<std::uint8_t>(op);
+        };
+
+        const auto pop = [&sp] {
+            return std::move(*(--sp));
+        };
+        const auto peek = [&sp]() -> Value& {
+            return sp[-1];
+        };
+        const auto peekN = [&sp](std::size_t n) -> Value& {
+            return sp[-1 - static_cast<std::ptrdiff_t>(n)];
         };
 
 #ifdef CPPLOX_DEBUG_TRACE_EXECUTION
         Disassembler disassembler;
+    #define VM_TRACE() \
+        ++executedInstructions; \
+        disassembler.disassembleInstruction( \
+            frame->closure->function->chunk, \
+            ip - frame->closure->function->chunk.code.data())
+#else
+    #define VM_TRACE()
 #endif
 
-        for (;;) {
-#ifdef CPPLOX_DEBUG_TRACE_EXECUTION
-            disassembler.disassembleInstruction(frame->closure->function->chunk,
-                                                frame->ip - frame->closure->function->chunk.code.data());
+#ifdef CPPLOX_COMPUTED_GOTO
+        // Direct threading: every handler ends with its own indirect jump
+        // to the next handler instead of going back through a single switch.
+        void* dispatchTable[256];
+        for (void*& target : dispatchTable) {
+            target = &&op_UNKNOWN;
+        }
+    #define VM_TARGET(op) \
+        dispatchTable[static_cast<std::uint8_t>(OpCode::op)] = &&op_##op
+        VM_TARGET(RETURN);
+        VM_TARGET(CONSTANT);
+        VM_TARGET(CONSTANT_16);
+        VM_TARGET(NIL);
+        VM_TARGET(TRUE);
+        VM_TARGET(FALSE);
+        VM_TARGET(NOT);
+        VM_TARGET(NEGATE);
+        VM_TARGET(EQUAL);
+        VM_TARGET(NOT_EQUAL);
+        VM_TARGET(LESS);
+        VM_TARGET(LESS_EQUAL);
+        VM_TARGET(GREATER);
+        VM_TARGET(GREATER_EQUAL);
+        VM_TARGET(ADD);
+        VM_TARGET(SUBTRACT);
+        VM_TARGET(MULTIPLY);
+        VM_TARGET(DIVIDE);
+        VM_TARGET(PRINT);
+        VM_TARGET(POP);
+        VM_TARGET(POP_N);
+        VM_TARGET(POP_N_16);
+        VM_TARGET(DEFINE_GLOBAL);
+        VM_TARGET(DEFINE_GLOBAL_16);
+        VM_TARGET(READ_GLOBAL);
+        VM_TARGET(READ_GLOBAL_16);
+        VM_TARGET(SET_GLOBAL);
+        VM_TARGET(SET_GLOBAL_16);
+        VM_TARGET(READ_LOCAL);
+        VM_TARGET(READ_LOCAL_16);
+        VM_TARGET(SET_LOCAL);
+        VM_TARGET(SET_LOCAL_16);
+        VM_TARGET(JMP_IF_FALSE);
+        VM_TARGET(JMP);
+        VM_TARGET(LOOP);
+        VM_TARGET(CALL);
+        VM_TARGET(MAKE_CLOSURE);
+        VM_TARGET(MAKE_CLOSURE_16);
+        VM_TARGET(READ_UPVALUE);
+        VM_TARGET(SET_UPVALUE);
+        VM_TARGET(CLOSE_UPVALUE);
+        VM_TARGET(MAKE_CLASS);
+        VM_TARGET(MAKE_CLASS_16);
+        VM_TARGET(SET_PROPERTY);
+        VM_TARGET(SET_PROPERTY_16);
+        VM_TARGET(GET_PROPERTY);
+        VM_TARGET(GET_PROPERTY_16);
+        VM_TARGET(METHOD);
+        VM_TARGET(METHOD_16);
+        VM_TARGET(INVOKE);
+        VM_TARGET(INVOKE_16);
+        VM_TARGET(INHERIT);
+        VM_TARGET(GET_SUPER);
+        VM_TARGET(GET_SUPER_16);
+        VM_TARGET(SUPER_INVOKE);
+        VM_TARGET(SUPER_INVOKE_16);
+        VM_TARGET(ADD_NUM);
+        VM_TARGET(ADD_STR);
+        VM_TARGET(ADD_LOCALS);
+        VM_TARGET(LESS_LOCALS);
+        VM_TARGET(ADD_LOCAL_CONST);
+        VM_TARGET(SUBTRACT_LOCAL_CONST);
+        VM_TARGET(LESS_LOCAL_CONST);
+        VM_TARGET(POP_JMP_IF_FALSE);
+        VM_TARGET(JMP_IF_NOT_LESS);
+        VM_TARGET(JMP_IF_NOT_LESS_EQUAL);
+        VM_TARGET(JMP_IF_NOT_GREATER);
+        VM_TARGET(JMP_IF_NOT_GREATER_EQUAL);
+        VM_TARGET(POP_JMP_IF_TRUE);
+        VM_TARGET(SET_LOCAL_POP);
+        VM_TARGET(TAIL_CALL);
+        VM_TARGET(MOVE);
+        VM_TARGET(ADD_RK);
+        VM_TARGET(SUBTRACT_RK);
+        VM_TARGET(MULTIPLY_RK);
+        VM_TARGET(DIVIDE_RK);
+        VM_TARGET(JMP_IF_NOT_LESS_RK);
+        VM_TARGET(JMP_IF_NOT_LESS_EQUAL_RK);
+        VM_TARGET(JMP_IF_NOT_GREATER_RK);
+        VM_TARGET(JMP_IF_NOT_GREATER_EQUAL_RK);
+    #undef VM_TARGET
+
+    #define VM_CASE(op) case OpCode::op: op_##op
+    #define VM_DEFAULT default: op_UNKNOWN
+    #define VM_DISPATCH() \
+        VM_TRACE(); \
+        opCode = static_cast<OpCode>(readByte()); \
+        goto *dispatchTable[static_cast<std::uint8_t>(opCode)]
+#else
+    #define VM_CASE(op) case OpCode::op
+    #define VM_DEFAULT default
+    #define VM_DISPATCH() continue
+#endif
+
+    // call() has already checked that the frame fits on the stack
+    #define VM_PUSH(value) (*(sp++) = (value))
+
+#ifdef CPPLOX_JIT
+    // hands the current frame over to its machine code, if it has any,
+    // which returns at the next call or return or when it bails out
+    #define VM_ENTER_JIT() \
+        if (frame->closure->function->jitCode != nullptr) { \
+            storeState(); \
+            if (jit.resume() == false) { \
+                return InterpretResultCode::RUNTIME_ERROR; \
+            } \
+            loadState(); \
+        }
+#else
+    #define VM_ENTER_JIT()
 #endif
 
+    // hands the current frame over to the C++ code of its function, if the
+    // program has been built ahead of time, or else to its machine code
+    #define VM_ENTER_CODE() \
+        if (frame->closure->function->aotEntry != nullptr) { \
+            storeState(); \
+            if (resumeAot() == false) { \
+                return InterpretResultCode::RUNTIME_ERROR; \
+            } \
+            loadState(); \
+        } \
+        VM_ENTER_JIT()
+
 #define BINARY_OP(op) \
-            bool bOk = numBinaryOp([](double a, double b) { return Value(a op b); }); \
+            bool bOk = numBinaryOp(sp, [](double a, double b) { return Value(a op b); }); \
             if (bOk == false) { \
+               storeState(); \
+               runtimeError("Operands must be numbers."); \
                return InterpretResultCode::RUNTIME_ERROR; \
             }
 
-            const auto opCode = static_cast<OpCode>(readByte());
+// pops two numbers and jumps if the comparison does not hold
+#define COMPARE_JUMP(op) \
+            const std::size_t offset = readIdx16(); \
+            const Value& b = sp[-1]; \
+            const Value& a = sp[-2]; \
+            if (a.isNumber() == false || b.isNumber() == false) { \
+               storeState(); \
+               runtimeError("Operands must be numbers."); \
+               return InterpretResultCode::RUNTIME_ERROR; \
+            } \
+            const bool holds = a.asNumber() op b.asNumber(); \
+            sp -= 2; \
+            if (holds == false) { \
+                ip += offset; \
+            }
+
+// dst = a op b on the registers and constants of the frame
+#define REGISTER_OP(op) \
+            Value& dst = slots[readByte()]; \
+            const Value& a = readRK(); \
+            const Value& b = readRK(); \
+            if (a.isNumber() == false || b.isNumber() == false) { \
+               storeState(); \
+               runtimeError("Operands must be numbers."); \
+               return InterpretResultCode::RUNTIME_ERROR; \
+            } \
+            dst = Value(a.asNumber() op b.asNumber());
+
+// jumps if the comparison of two registers or constants does not hold
+#define REGISTER_COMPARE_JUMP(op) \
+            const std::size_t offset = readIdx16(); \
+            const Value& a = readRK(); \
+            const Value& b = readRK(); \
+            if (a.isNumber() == false || b.isNumber() == false) { \
+               storeState(); \
+               runtimeError("Operands must be numbers."); \
+               return InterpretResultCode::RUNTIME_ERROR; \
+            } \
+            if ((a.asNumber() op b.asNumber()) == false) { \
+                ip += offset; \
+            }
+
+        VM_ENTER_CODE();
+
+        OpCode opCode;
+        for (;;) {
+            VM_TRACE();
+
+            opCode = static_cast<OpCode>(readByte());
             switch (opCode) {
-                case OpCode::ADD: {
-                    if (stack.peek().isString() && stack.peekN(1).isString()) {
-                        Value b = stack.pop();
-                        Value& a = stack.peek();
-                        a.asString() += b.asString();
-                    }
-                    else if (stack.peek().isNumber() && stack.peekN(1).isNumber()) {
-                        double b = stack.pop().asNumber();
-                        double a = stack.pop().asNumber();
-                        stack.push(Value(a + b));
+                // A quickened ADD which sees other operand types falls
+                // back to the generic one and rewrites itself to ADD.
+                VM_CASE(ADD_STR): {
+                    Value& b = peek();
+                    Value& a = peekN(1);
+                    if (a.isString() && b.isString()) {
+                        storeState();
+                        StringObject* result = concatenate(a.asString(), b.asString());
+                        if (result == nullptr) {
+                            return InterpretResultCode::RUNTIME_ERROR;
+                        }
+                        a = result->asValue();
+                        --sp;
+                        VM_DISPATCH();
+                    }
+                    quicken(OpCode::ADD);
+                } [[fallthrough]];
+                VM_CASE(ADD_NUM): {
+                    Value& b = peek();
+                    Value& a = peekN(1);
+                    if (a.isNumber() && b.isNumber()) {
+                        a = Value(a.asNumber() + b.asNumber());
+                        --sp;
+                        VM_DISPATCH();
+                    }
+                    quicken(OpCode::ADD);
+                } [[fallthrough]];
+                VM_CASE(ADD): {
+                    Value& b = peek();
+                    Value& a = peekN(1);
+                    if (a.isString() && b.isString()) {
+                        quicken(OpCode::ADD_STR);
+                        storeState();
+                        StringObject* result = concatenate(a.asString(), b.asString());
+                        if (result == nullptr) {
+                            return InterpretResultCode::RUNTIME_ERROR;
+                        }
+                        a = result->asValue();
+                        --sp;
+                    }
+                    else if (a.isNumber() && b.isNumber()) {
+                        quicken(OpCode::ADD_NUM);
+                        a = Value(a.asNumber() + b.asNumber());
+                        --sp;
                     } else {
+                        storeState();
                         runtimeError("Operands must be two numbers or two strings.");
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
-                } break;
-                case OpCode::SUBTRACT: {
+                } VM_DISPATCH();
+                VM_CASE(ADD_LOCALS): {
+                    const Value& a = slots[readByte()];
+                    const Value& b = slots[readByte()];
+                    if (a.isNumber() && b.isNumber()) {
+                        VM_PUSH(Value(a.asNumber() + b.asNumber()));
+                    } else {
+                        storeState();
+                        Value result;
+                        if (addValues(a, b, result) == false) {
+                            return InterpretResultCode::RUNTIME_ERROR;
+                        }
+                        VM_PUSH(result);
+                    }
+                } VM_DISPATCH();
+                VM_CASE(ADD_LOCAL_CONST): {
+                    const Value& a = slots[readByte()];
+                    const Value& b = readConstant();
+                    if (a.isNumber() && b.isNumber()) {
+                        VM_PUSH(Value(a.asNumber() + b.asNumber()));
+                    } else {
+                        storeState();
+                        Value result;
+                        if (addValues(a, b, result) == false) {
+                            return InterpretResultCode::RUNTIME_ERROR;
+                        }
+                        VM_PUSH(result);
+                    }
+                } VM_DISPATCH();
+                VM_CASE(SUBTRACT_LOCAL_CONST): {
+                    const Value& a = slots[readByte()];
+                    const Value& b = readConstant();
+                    if (a.isNumber() == false || b.isNumber() == false) {
+                        storeState();
+                        runtimeError("Operands must be numbers.");
+                        return InterpretResultCode::RUNTIME_ERROR;
+                    }
+                    VM_PUSH(Value(a.asNumber() - b.asNumber()));
+                } VM_DISPATCH();
+                VM_CASE(LESS_LOCALS): {
+                    const Value& a = slots[readByte()];
+                    const Value& b = slots[readByte()];
+                    if (a.isNumber() == false || b.isNumber() == false) {
+                        storeState();
+                        runtimeError("Operands must be numbers.");
+                        return InterpretResultCode::RUNTIME_ERROR;
+                    }
+                    VM_PUSH(Value(a.asNumber() < b.asNumber()));
+                } VM_DISPATCH();
+                VM_CASE(LESS_LOCAL_CONST): {
+                    const Value& a = slots[readByte()];
+                    const Value& b = readConstant();
+                    if (a.isNumber() == false || b.isNumber() == false) {
+                        storeState();
+                        runtimeError("Operands must be numbers.");
+                        return InterpretResultCode::RUNTIME_ERROR;
+                    }
+                    VM_PUSH(Value(a.asNumber() < b.asNumber()));
+                } VM_DISPATCH();
+                VM_CASE(SUBTRACT): {
                     BINARY_OP(-);
-                } break;
-                case OpCode::DIVIDE: {
+                } VM_DISPATCH();
+                VM_CASE(DIVIDE): {
                     BINARY_OP(/);
-                } break;
-                case OpCode::MULTIPLY: {
+                } VM_DISPATCH();
+                VM_CASE(MULTIPLY): {
                     BINARY_OP(*);
-                } break;
-                case OpCode::LESS: {
+                } VM_DISPATCH();
+                VM_CASE(LESS): {
                     BINARY_OP(<);
-                } break;
-                case OpCode::LESS_EQUAL: {
+                } VM_DISPATCH();
+                VM_CASE(LESS_EQUAL): {
                     BINARY_OP(<=);
-                } break;
-                case OpCode::GREATER: {
+                } VM_DISPATCH();
+                VM_CASE(GREATER): {
                     BINARY_OP(>);
-                } break;
-                case OpCode::GREATER_EQUAL: {
+                } VM_DISPATCH();
+                VM_CASE(GREATER_EQUAL): {
                     BINARY_OP(>=);
-                } break;
-                case OpCode::EQUAL: {
-                    Value b = stack.pop();
-                    Value a = stack.pop();
-                    stack.push(Value(a == b));
-                } break;
-                case OpCode::NOT_EQUAL: {
-                    Value b = stack.pop();
-                    Value a = stack.pop();
-                    stack.push(Value(a != b));
-                } break;
-                case OpCode::NEGATE: {
-                    if (stack.peek().isNumber()) {
-                        double x = stack.pop().asNumber();
-                        stack.push(Value(-x));
+                } VM_DISPATCH();
+                VM_CASE(EQUAL): {
+                    const bool equal = peekN(1) == peek();
+                    --sp;
+                    peek() = Value(equal);
+                } VM_DISPATCH();
+                VM_CASE(NOT_EQUAL): {
+                    const bool notEqual = peekN(1) != peek();
+                    --sp;
+                    peek() = Value(notEqual);
+                } VM_DISPATCH();
+                VM_CASE(NEGATE): {
+                    if (peek().isNumber()) {
+                        peek() = Value(-peek().asNumber());
                     } else {
+                        storeState();
                         runtimeError("Operand must be a number.");
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
-                } break;
-                case OpCode::NOT: {
-                    const bool v = stack.pop().isFalsey();
-                    stack.push(Value(v));
-                } break;
-                case OpCode::CONSTANT: {
-                    stack.push(readConstant());
-                } break;
-                case OpCode::CONSTANT_16: {
-                    stack.push(readConstant16());
-                } break;
-                case OpCode::TRUE: {
-                    stack.push(Value(true));
-                } break;
-                case OpCode::FALSE: {
-                    stack.push(Value(false));
-                } break;
-                case OpCode::NIL: {
-                    stack.push(Value::nil());
-                } break;
-                case OpCode::PRINT: {
-                    printValue(stack.peek());
-                    stack.pop();
-                } break;
-                case OpCode::POP: {
-                    stack.pop();
-                } break;
-                case OpCode::POP_N:
-                case OpCode::POP_N_16: {
+                } VM_DISPATCH();
+                VM_CASE(NOT): {
+                    peek() = Value(peek().isFalsey());
+                } VM_DISPATCH();
+                VM_CASE(CONSTANT): {
+                    VM_PUSH(readConstant());
+                } VM_DISPATCH();
+                VM_CASE(CONSTANT_16): {
+                    VM_PUSH(readConstant16());
+                } VM_DISPATCH();
+                VM_CASE(TRUE): {
+                    VM_PUSH(Value(true));
+                } VM_DISPATCH();
+                VM_CASE(FALSE): {
+                    VM_PUSH(Value(false));
+                } VM_DISPATCH();
+                VM_CASE(NIL): {
+                    VM_PUSH(Value::nil());
+                } VM_DISPATCH();
+                VM_CASE(PRINT): {
+                    printValue(peek());
+                    --sp;
+                } VM_DISPATCH();
+                VM_CASE(POP): {
+                    --sp;
+                } VM_DISPATCH();
+                VM_CASE(POP_N):
+                VM_CASE(POP_N_16): {
                     const std::size_t n =
                         opCode == OpCode::POP_N ? readByte() : readIdx16();
-                    stack.popN(n);
-                } break;
-                case OpCode::DEFINE_GLOBAL:
-                case OpCode::DEFINE_GLOBAL_16: {
-                    Value name = opCode == OpCode::DEFINE_GLOBAL
-                                     ? readConstant()
-                                     : readConstant16();
-                    if (name.isString()) {
-                        globals.insert(name.asString(), stack.peek());
-                        stack.pop();
-                    } else {
-                        runtimeError("Internal error.");
+                    sp -= n;
+                } VM_DISPATCH();
+                VM_CASE(DEFINE_GLOBAL):
+                VM_CASE(DEFINE_GLOBAL_16): {
+                    const std::size_t slot =
+                        opCode == OpCode::DEFINE_GLOBAL ? readByte() : readIdx16();
+                    globals.values()[slot] = pop();
+                } VM_DISPATCH();
+                VM_CASE(READ_GLOBAL):
+                VM_CASE(READ_GLOBAL_16): {
+                    const std::size_t slot =
+                        opCode == OpCode::READ_GLOBAL ? readByte() : readIdx16();
+                    const Value& value = globals.values()[slot];
+                    if (value.isUndefined()) [[unlikely]] {
+                        storeState();
+                        runtimeError("Undefined variable '\"{}\"'.", globals.nameOf(slot));
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
-                } break;
-                case OpCode::READ_GLOBAL:
-                case OpCode::READ_GLOBAL_16: {
-                    Value name = opCode == OpCode::READ_GLOBAL
-                                     ? readConstant()
-                                     : readConstant16();
-                    if (name.isString()) {
-                        Value value;
-                        bool exists = globals.find(name.asString(), value);
-                        if (exists) {
-                            stack.push(value);
-                        } else {
-                            runtimeError("Undefined variable '{}'.", name);
-                            return InterpretResultCode::RUNTIME_ERROR;
-                        }
-                    } else {
-                        runtimeError("Internal error.");
+                    VM_PUSH(value);
+                } VM_DISPATCH();
+                VM_CASE(SET_GLOBAL):
+                VM_CASE(SET_GLOBAL_16): {
+                    const std::size_t slot =
+                        opCode == OpCode::SET_GLOBAL ? readByte() : readIdx16();
+                    Value& value = globals.values()[slot];
+                    if (value.isUndefined()) [[unlikely]] {
+                        storeState();
+                        runtimeError("Undefined variable '\"{}\"'.", globals.nameOf(slot));
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
-                } break;
-                case OpCode::SET_GLOBAL:
-                case OpCode::SET_GLOBAL_16: {
-                    Value name = opCode == OpCode::SET_GLOBAL
-                                     ? readConstant()
-                                     : readConstant16();
-                    if (name.isString()) {
-                        bool exists = globals.contains(name.asString());
-                        if (exists) {
-                            globals.insert(name.asString(), stack.peek());
-                        } else {
-                            runtimeError("Undefined variable '{}'.", name);
-                            return InterpretResultCode::RUNTIME_ERROR;
-                        }
-                    } else {
-                        runtimeError("Internal error.");
-                        return InterpretResultCode::RUNTIME_ERROR;
-                    }
-                } break;
-                case OpCode::READ_LOCAL:
-                case OpCode::READ_LOCAL_16: {
-                    std::size_t idx =
+                    value = peek();
+                } VM_DISPATCH();
+                VM_CASE(READ_LOCAL):
+                VM_CASE(READ_LOCAL_16): {
+                    const std::size_t idx =
                         opCode == OpCode::READ_LOCAL ? readByte() : readIdx16();
-                    idx += frame->bp;
-                    stack.push(stack.at(idx));
-                } break;
-                case OpCode::SET_LOCAL:
-                case OpCode::SET_LOCAL_16: {
-                    std::size_t idx =
+                    VM_PUSH(slots[idx]);
+                } VM_DISPATCH();
+                VM_CASE(SET_LOCAL):
+                VM_CASE(SET_LOCAL_16): {
+                    const std::size_t idx =
                         opCode == OpCode::SET_LOCAL ? readByte() : readIdx16();
-                    idx += frame->bp;
-                    stack.at(idx) = stack.peek();
-                } break;
-                case OpCode::JMP_IF_FALSE: {
+                    slots[idx] = peek();
+                } VM_DISPATCH();
+                VM_CASE(SET_LOCAL_POP): {
+                    slots[readByte()] = pop();
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_FALSE): {
                     const std::size_t offset = readIdx16();
-                    if (stack.peek().isFalsey()) {
-                        frame->ip += offset;
+                    if (peek().isFalsey()) {
+                        ip += offset;
                     }
-                } break;
-                case OpCode::JMP: {
+                } VM_DISPATCH();
+                VM_CASE(POP_JMP_IF_FALSE): {
                     const std::size_t offset = readIdx16();
-                    frame->ip += offset;
-                } break;
-                case OpCode::LOOP: {
+                    if (pop().isFalsey()) {
+                        ip += offset;
+                    }
+                } VM_DISPATCH();
+                VM_CASE(POP_JMP_IF_TRUE): {
                     const std::size_t offset = readIdx16();
-                    frame->ip -= offset;
-                } break;
-                case OpCode::MAKE_CLOSURE:
-                case OpCode::MAKE_CLOSURE_16: {
-                    Value val = opCode == OpCode::MAKE_CLOSURE
-                                    ? readConstant()
-                                    : readConstant16();
+                    if (pop().isFalsey() == false) {
+                        ip += offset;
+                    }
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_LESS): {
+                    COMPARE_JUMP(<);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_LESS_EQUAL): {
+                    COMPARE_JUMP(<=);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_GREATER): {
+                    COMPARE_JUMP(>);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_GREATER_EQUAL): {
+                    COMPARE_JUMP(>=);
+                } VM_DISPATCH();
+                VM_CASE(JMP): {
+                    const std::size_t offset = readIdx16();
+                    ip += offset;
+                } VM_DISPATCH();
+                VM_CASE(LOOP): {
+                    const std::size_t offset = readIdx16();
+                    ip -= offset;
+                    compileIfHotLoop(frame->closure->function);
+                    VM_ENTER_JIT();
+                } VM_DISPATCH();
+                VM_CASE(MAKE_CLOSURE):
+                VM_CASE(MAKE_CLOSURE_16): {
+                    Value& val = opCode == OpCode::MAKE_CLOSURE
+                                     ? readConstant()
+                                     : readConstant16();
                     if (val.isObject() == false) {
+                        storeState();
                         runtimeError("Internal error.");
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
 
                     Function* function = val.asObject()->as<Function>();
                     if (function != nullptr) {
-                        Closure* closure = makeObject<Closure>(function);
-                        if (closure != nullptr) {
-                            stack.push(Value(closure));
-                            const std::size_t upvc = readByte();
-                            for (std::size_t i = 0; i < upvc; ++i) {
-                                const bool isLocal = readByte() == 1;
-                                const std::size_t index =
-                                    isLocal ? readIdx16() : readByte();
-                                if (isLocal) {
-                                    closure->upvalues[i] =
-                                        captureUpvalue(frame->bp + index);
-                                    if (closure->upvalues[i] == nullptr) {
-                                        return InterpretResultCode::RUNTIME_ERROR;
-                                    }
-                                } else {
-                                    closure->upvalues[i] = frame->closure->upvalues[index];
-                                }
-                            }
-                        }
-                        else {
+                        storeState();
+                        if (makeClosure(function, ip) == false) {
                             return InterpretResultCode::RUNTIME_ERROR;
                         }
+                        sp = stack.end();
                     }
-                } break;
-                case OpCode::CLOSE_UPVALUE: {
-                    closeUpvalues(stack.size() - 1);
-                    stack.pop();
-                } break;
-                case OpCode::READ_UPVALUE: {
+                } VM_DISPATCH();
+                VM_CASE(CLOSE_UPVALUE): {
+                    closeUpvalues(static_cast<std::size_t>(sp - 1 - stack.data()));
+                    --sp;
+                } VM_DISPATCH();
+                VM_CASE(READ_UPVALUE): {
                     const auto idx = readByte();
-                    stack.push(*(frame->closure->upvalues[idx]->location));
-                } break;
-                case OpCode::SET_UPVALUE: {
-                    const auto idx = readByte();
-                    *(frame->closure->upvalues[idx]->location) = stack.peek();
-                } break;
-                case OpCode::CALL: {
+                    VM_PUSH(*(frame->closure->upvalues[idx]->location));
+                } VM_DISPATCH();
+                VM_CASE(SET_UPVALUE): {
+                    Upvalue* upvalue = frame->closure->upvalues[readByte()];
+                    const HeapLock lock = beforeStore(*(upvalue->location));
+                    *(upvalue->location) = peek();
+                    writeBarrier(upvalue, peek());
+                } VM_DISPATCH();
+                VM_CASE(CALL): {
                     const std::uint8_t argc = readByte();
-                    Value& fun = stack.peekN(argc);
-                    if (callValue(fun, argc) == false) {
+                    storeState();
+                    if (callValue(peekN(argc), argc) == false) {
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
-                    frame = &frames.back();
-                } break;
-                case OpCode::RETURN: {
-                    Value result = stack.pop();
-                    const std::size_t poppedBP = frame->bp;
-                    closeUpvalues(poppedBP);
+                    loadState();
+                    VM_ENTER_CODE();
+                } VM_DISPATCH();
+                VM_CASE(TAIL_CALL): {
+                    const std::uint8_t argc = readByte();
+                    storeState();
+                    if (tailCallValue(peekN(argc), argc) == false) {
+                        return InterpretResultCode::RUNTIME_ERROR;
+                    }
+                    loadState();
+                    VM_ENTER_CODE();
+                } VM_DISPATCH();
+                VM_CASE(RETURN): {
+                    Value result = pop();
+                    closeUpvalues(frame->bp);
 
                     frames.removeBack();
                     if (frames.isEmpty()) {
+                        stack.setEnd(sp);
                         return InterpretResultCode::OK;
                     }
-                    frame = &frames.back();
 
-                    const std::size_t popCnt = stack.size() - poppedBP;
-                    stack.popN(popCnt);
-                    stack.push(result);
-                } break;
-                case OpCode::MAKE_CLASS:
-                case OpCode::MAKE_CLASS_16: {
-                    Value name = opCode == OpCode::MAKE_CLASS
-                                    ? readConstant()
-                                    : readConstant16();
+                    sp = slots;
+                    *(sp++) = std::move(result);
+                    stack.setEnd(sp);
+                    loadState();
+                    VM_ENTER_CODE();
+                } VM_DISPATCH();
+                VM_CASE(MAKE_CLASS):
+                VM_CASE(MAKE_CLASS_16): {
+                    const Value& name = opCode == OpCode::MAKE_CLASS
+                                            ? readConstant()
+                                            : readConstant16();
                     if (name.isString()) {
-                        Class* classObj = makeObject<Class>(name.asString());
-                        if (classObj != nullptr) {
-                            stack.push(Value(classObj));
-                        }
-                        else {
+                        storeState();
+                        if (makeClass(name.asString()) == false) {
                             return InterpretResultCode::RUNTIME_ERROR;
                         }
+                        sp = stack.end();
                     }
-                } break;
-                case OpCode::METHOD:
-                case OpCode::METHOD_16: {
-                    Value name = opCode == OpCode::METHOD
-                                    ? readConstant()
-                                    : readConstant16();
+                } VM_DISPATCH();
+                VM_CASE(METHOD):
+                VM_CASE(METHOD_16): {
+                    const Value& name = opCode == OpCode::METHOD
+                                            ? readConstant()
+                                            : readConstant16();
                     if (name.isString()) {
+                        storeState();
                         defineMethod(name.asString());
+                        sp = stack.end();
                     }
-                } break;
-                case OpCode::GET_PROPERTY:
-                case OpCode::GET_PROPERTY_16: {
-                    Value name = opCode == OpCode::GET_PROPERTY
-                                     ? readConstant()
-                                     : readConstant16();
-                    Value instance = stack.peek();
-                    if (instance.isObject() == false ||
-                        instance.asObject()->hasType(ObjectType::INSTANCE) == false)
-                    {
+                } VM_DISPATCH();
+                VM_CASE(GET_PROPERTY):
+                VM_CASE(GET_PROPERTY_16): {
+                    const Value& name = opCode == OpCode::GET_PROPERTY
+                                            ? readConstant()
+                                            : readConstant16();
+                    PropertyCache& cache =
+                        frame->closure->function->chunk.propertyCaches[readIdx16()];
+                    Value& instance = peek();
+                    Instance* inst = instance.isObject()
+                                         ? instance.asObject()->as<Instance>()
+                                         : nullptr;
+                    if (inst == nullptr) {
+                        storeState();
                         runtimeError("Only instances have properties.");
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
 
-                    if (name.isString()) {
-                        Instance* inst = instance.asObject()->as<Instance>();
-                        if (inst != nullptr) {
-                            Value property;
-                            if (inst->fields.find(name.asString(), property)) {
-                                stack.pop(); // instance
-                                stack.push(property);
-                            } else {
-                                const bool bound =
-                                    bindMethod(inst->klass, name.asString());
-                                if (bound == false) {
-                                    return InterpretResultCode::RUNTIME_ERROR;
-                                }
-                            }
+                    const PropertyCache::Entry* hit = cache.find(inst->shape);
+                    if (hit != nullptr && hit->method == nullptr) {
+                        instance = inst->fields[hit->slot];
+                    } else {
+                        storeState();
+                        const bool ok = hit != nullptr
+                                            ? bindMethod(hit->method)
+                                            : getProperty(inst, name.asString(), cache);
+                        if (ok == false) {
+                            return InterpretResultCode::RUNTIME_ERROR;
                         }
+                        sp = stack.end();
                     }
-                } break;
-                case OpCode::SET_PROPERTY:
-                case OpCode::SET_PROPERTY_16: {
-                    Value instance = stack.peekN(1);
-                    if (instance.isObject() == false ||
-                        instance.asObject()->hasType(ObjectType::INSTANCE) == false)
-                    {
+                } VM_DISPATCH();
+                VM_CASE(SET_PROPERTY):
+                VM_CASE(SET_PROPERTY_16): {
+                    const Value& name = opCode == OpCode::SET_PROPERTY
+                                            ? readConstant()
+                                            : readConstant16();
+                    PropertyCache& cache =
+                        frame->closure->function->chunk.propertyCaches[readIdx16()];
+                    Value& instance = peekN(1);
+                    Instance* inst = instance.isObject()
+                                         ? instance.asObject()->as<Instance>()
+                                         : nullptr;
+                    if (inst == nullptr) {
+                        storeState();
                         runtimeError("Only instances have fields.");
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
 
-                    Value name = opCode == OpCode::SET_PROPERTY
-                                     ? readConstant()
-                                     : readConstant16();
-                    if (name.isString()) {
-                        Instance* inst = instance.asObject()->as<Instance>();
-                        if (inst != nullptr) {
-                            inst->fields.insert(name.asString(), stack.peek());
-                            Value val = stack.pop();
-                            stack.pop();
-                            stack.push(val);
+                    const PropertyCache::Entry* hit = cache.find(inst->shape);
+                    if (hit != nullptr && hit->next == nullptr) {
+                        const HeapLock lock = beforeStore(inst->fields[hit->slot]);
+                        inst->fields[hit->slot] = peek();
+                        writeBarrier(inst, peek());
+                    } else if (hit != nullptr) {
+                        // the instance has reached the next shape before,
+                        // so the field count hint covers it
+                        const HeapLock lock = beforeStore(inst);
+                        inst->shape = hit->next;
+                        inst->fields.insertBack(peek());
+                        writeBarrier(inst);
+                    } else {
+                        storeState();
+                        if (setProperty(inst, name.asString(), peek(), cache) == false) {
+                            return InterpretResultCode::RUNTIME_ERROR;
                         }
                     }
-                } break;
-                case OpCode::INVOKE:
-                case OpCode::INVOKE_16: {
-                    Value name = opCode == OpCode::INVOKE
-                                     ? readConstant()
-                                     : readConstant16();
+                    instance = pop();
+                } VM_DISPATCH();
+                VM_CASE(INVOKE):
+                VM_CASE(INVOKE_16): {
+                    const Value& name = opCode == OpCode::INVOKE
+                                            ? readConstant()
+                                            : readConstant16();
                     const auto argc = readByte();
+                    PropertyCache& cache =
+                        frame->closure->function->chunk.propertyCaches[readIdx16()];
                     if (name.isString()) {
-                        if (invoke(name.asString(), argc) == false) {
+                        storeState();
+                        if (invoke(name.asString(), argc, cache) == false) {
                             return InterpretResultCode::RUNTIME_ERROR;
                         }
-                        frame = &frames.back();
+                        loadState();
+                        VM_ENTER_CODE();
                     }
-                } break;
-                case OpCode::INHERIT: {
-                    Value& subclass = stack.peek();
-                    Value& superclass = stack.peekN(1);
-
-                    if (superclass.isObject() == false ||
-                        superclass.asObject()->hasType(ObjectType::CLASS) == false)
-                    {
-                        runtimeError("Can only inherit classes.");
+                } VM_DISPATCH();
+                VM_CASE(INHERIT): {
+                    storeState();
+                    if (inherit() == false) {
                         return InterpretResultCode::RUNTIME_ERROR;
                     }
-
-                    Class* subclassObj = subclass.asObject()->as<Class>();
-                    Class* superclassObj = superclass.asObject()->as<Class>();
-                    subclassObj->methods = superclassObj->methods;
-
-                    stack.pop(); // subclass
-                } break;
-                case OpCode::GET_SUPER:
-                case OpCode::GET_SUPER_16: {
-                    Value name = opCode == OpCode::GET_SUPER ? readConstant()
-                                                             : readConstant16();
-                    Value superclass = stack.pop();
+                    sp = stack.end();
+                } VM_DISPATCH();
+                VM_CASE(GET_SUPER):
+                VM_CASE(GET_SUPER_16): {
+                    const Value& name = opCode == OpCode::GET_SUPER
+                                            ? readConstant()
+                                            : readConstant16();
+                    Value superclass = pop();
                     Class* super = superclass.asObject()->as<Class>();
                     if (super != nullptr) {
+                        storeState();
                         const bool bound = bindMethod(super, name.asString());
                         if (bound == false) {
                             return InterpretResultCode::RUNTIME_ERROR;
                         }
+                        sp = stack.end();
                     }
-                } break;
-                case OpCode::SUPER_INVOKE:
-                case OpCode::SUPER_INVOKE_16: {
-                    Value name = opCode == OpCode::SUPER_INVOKE
-                                     ? readConstant()
-                                     : readConstant16();
+                } VM_DISPATCH();
+                VM_CASE(SUPER_INVOKE):
+                VM_CASE(SUPER_INVOKE_16): {
+                    const Value& name = opCode == OpCode::SUPER_INVOKE
+                                            ? readConstant()
+                                            : readConstant16();
                     const std::uint8_t argc = readByte();
+                    PropertyCache& cache =
+                        frame->closure->function->chunk.propertyCaches[readIdx16()];
                     if (name.isString()) {
-                        Value super = stack.pop();
+                        Value super = pop();
                         Class* superClass = super.asObject()->as<Class>();
                         if (superClass != nullptr) {
-                            bool ok = invokeFromClass(superClass, name.asString(), argc);
+                            storeState();
+                            bool ok = invokeFromClass(superClass,
+                                                      name.asString(),
+                                                      argc,
+                                                      cache);
                             if (ok == false) {
                                 return InterpretResultCode::RUNTIME_ERROR;
                             }
-                            frame = &frames.back();
+                            loadState();
+                            VM_ENTER_CODE();
                         }
                     }
-                } break;
-                default: {
+                } VM_DISPATCH();
+                VM_CASE(MOVE): {
+                    Value& dst = slots[readByte()];
+                    dst = readRK();
+                } VM_DISPATCH();
+                VM_CASE(ADD_RK): {
+                    Value& dst = slots[readByte()];
+                    const Value& a = readRK();
+                    const Value& b = readRK();
+                    if (a.isNumber() && b.isNumber()) {
+                        dst = Value(a.asNumber() + b.asNumber());
+                    } else {
+                        storeState();
+                        Value result;
+                        if (addValues(a, b, result) == false) {
+                            return InterpretResultCode::RUNTIME_ERROR;
+                        }
+                        dst = result;
+                    }
+                } VM_DISPATCH();
+                VM_CASE(SUBTRACT_RK): {
+                    REGISTER_OP(-);
+                } VM_DISPATCH();
+                VM_CASE(MULTIPLY_RK): {
+                    REGISTER_OP(*);
+                } VM_DISPATCH();
+                VM_CASE(DIVIDE_RK): {
+                    REGISTER_OP(/);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_LESS_RK): {
+                    REGISTER_COMPARE_JUMP(<);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_LESS_EQUAL_RK): {
+                    REGISTER_COMPARE_JUMP(<=);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_GREATER_RK): {
+                    REGISTER_COMPARE_JUMP(>);
+                } VM_DISPATCH();
+                VM_CASE(JMP_IF_NOT_GREATER_EQUAL_RK): {
+                    REGISTER_COMPARE_JUMP(>=);
+                } VM_DISPATCH();
+                VM_DEFAULT: {
+                    storeState();
                     runtimeError("Unknown opcode");
                     return InterpretResultCode::RUNTIME_ERROR;
-                } break;
+                }
             }
+        }
 
+#undef REGISTER_COMPARE_JUMP
+#undef REGISTER_OP
+#undef COMPARE_JUMP
 #undef BINARY_OP
-        }
+#undef VM_ENTER_CODE
+#undef VM_ENTER_JIT
+#undef VM_PUSH
+#undef VM_DISPATCH
+#undef VM_DEFAULT
+#undef VM_CASE
+#undef VM_TRACE
     }
 
+#ifdef CPPLOX_COMPUTED_GOTO
+    #pragma GCC diagnostic pop
+#endif
+
     void VM::printValue(const Value& v) const {
         if (v.isObject() == false) {
             println("{}", v);
@@ -522,34 +1033,84 @@ namespace cpplox {
                             method->method->function->arity);
                 } break;
                 case ObjectType::UPVALUE: { } break;
+                // strings are never stored as objects
+                case ObjectType::STRING: { } break;
+                case ObjectType::SHAPE: { } break;
             }
         }
     }
 
-    bool VM::invoke(const String& name, std::uint8_t argc) {
-        Value instance = stack.peekN(argc);
-        if (instance.isObject()) {
-            Instance* inst = instance.asObject()->as<Instance>();
-            if (inst != nullptr) {
-                Value field;
-                if (inst->fields.find(name, field)) {
-                    stack.peekN(argc) = field;
-                    return callValue(field, argc);
-                } else {
-                    return invokeFromClass(inst->klass, name, argc);
-                }
+    bool VM::addValues(const Value& a, const Value& b, Value& result) {
+        if (a.isNumber() && b.isNumber()) {
+            result = Value(a.asNumber() + b.asNumber());
+        } else if (a.isString() && b.isString()) {
+            StringObject* s = concatenate(a.asString(), b.asString());
+            if (s == nullptr) {
+                return false;
             }
+            result = s->asValue();
+        } else {
+            runtimeError("Operands must be two numbers or two strings.");
+            return false;
         }
 
-        runtimeError("Only instances have properties.");
-        return false;
+        return true;
+    }
+
+    bool VM::invoke(const String& name, std::uint8_t argc, PropertyCache& cache) {
+        Value& receiver = stack.peekN(argc);
+        Instance* inst = receiver.isObject() ? receiver.asObject()->as<Instance>()
+                                             : nullptr;
+        if (inst == nullptr) {
+            runtimeError("Only instances have properties.");
+            return false;
+        }
+
+        const PropertyCache::Entry* hit = cache.find(inst->shape);
+        if (hit != nullptr && hit->method != nullptr) {
+            return call(hit->method, argc);
+        }
+
+        std::size_t slot = 0;
+        if (hit != nullptr) {
+            slot = hit->slot;
+        } else if (inst->shape->find(&name, slot)) {
+            fillPropertyCache(cache, {
+                .shape = inst->shape,
+                .slot = static_cast<std::uint32_t>(slot),
+            });
+        } else {
+            Value method;
+            if (inst->klass->methods.find(&name, method) == false) {
+                runtimeError("Undefined property '{}'.", name);
+                return false;
+            }
+
+            Closure* closure = method.asObject()->as<Closure>();
+            fillPropertyCache(cache, {.shape = inst->shape, .method = closure});
+            return call(closure, argc);
+        }
+
+        // a field holding a callable
+        Value field = inst->fields[slot];
+        receiver = field;
+        return callValue(field, argc);
     }
 
-    bool
-    VM::invokeFromClass(Class* klass, const String& methodName, std::uint8_t argc) {
+    bool VM::invokeFromClass(Class* klass,
+                             const String& methodName,
+                             std::uint8_t argc,
+                             PropertyCache& cache) {
+        const PropertyCache::Entry* hit = cache.find(klass->rootShape);
+        if (hit != nullptr) {
+            return call(hit->method, argc);
+        }
+
         Value method;
-        if (klass->methods.find(methodName, method)) {
-            return call(method.asObject()->as<Closure>(), argc);
+        if (klass->methods.find(&methodName, method)) {
+            Closure* closure = method.asObject()->as<Closure>();
+            fillPropertyCache(cache, {.shape = klass->rootShape, .method = closure});
+            return call(closure, argc);
         }
 
         runtimeError("Undefined property '{}'.", methodName);
@@ -579,7 +1140,7 @@ namespace cpplox {
                         if (inst != nullptr) {
                             stack.at(stack.size() - argc - 1) = Value(inst);
                             Value initializer;
-                            if (klass->methods.find(classInitKey, initializer)) {
+                            if (klass->methods.find(initString, initializer)) {
                                 return call(
                                     initializer.asObject()->as<Closure>(),
                                     argc);
@@ -612,11 +1173,18 @@ namespace cpplox {
             return false;
         }
 
+        const std::size_t bp = stack.size() - argc - 1;
+        if (f->function->maxStackSize > stack.capacity() - bp) {
+            runtimeError("Stack overflow.");
+            return false;
+        }
+
         frames.insertBack(CallFrame{
             .closure = f,
             .ip = f->function->chunk.code.data(),
-            .bp = stack.size() - argc - 1,
+            .bp = bp,
         });
+        compileIfHot(f->function);
 
 #ifdef CPPLOX_DEBUG_TRACE_EXECUTION
         Disassembler disassembler;
@@ -627,6 +1195,102 @@ namespace cpplox {
         return true;
     }
 
+    bool VM::tailCallValue(Value& v, std::uint8_t argc) {
+        const Value* const base = &stack.at(frames.back().bp);
+        const bool captured = openUpvalues != nullptr && openUpvalues->location >= base;
+        if (captured == false && v.isObject()) {
+            switch (v.asObject()->type()) {
+                case ObjectType::CLOSURE: {
+                    return tailCall(v.asObject()->as<Closure>(), argc);
+                } break;
+                case ObjectType::BOUND_METHOD: {
+                    BoundMethod* bm = v.asObject()->as<BoundMethod>();
+                    stack.at(stack.size() - argc - 1) = bm->receiver;
+                    return tailCall(bm->method, argc);
+                } break;
+                default: { } break;
+            }
+        }
+
+        return callValue(v, argc);
+    }
+
+    bool VM::tailCall(Closure* f, std::uint8_t argc) {
+        if (f->function->arity != argc) {
+            runtimeError("Invalid argument count. Expected {}, found {}.",
+                         f->function->arity,
+                         argc);
+            return false;
+        }
+
+        CallFrame& frame = frames.back();
+        if (f->function->maxStackSize > stack.capacity() - frame.bp) {
+            runtimeError("Stack overflow.");
+            return false;
+        }
+
+        // move the callee and the arguments down to the base of the frame
+        Value* const base = stack.data() + frame.bp;
+        const Value* const args = stack.end() - argc - 1;
+        for (std::size_t i = 0; i <= argc; ++i) {
+            base[i] = args[i];
+        }
+        stack.setEnd(base + argc + 1);
+
+        frame.closure = f;
+        frame.ip = f->function->chunk.code.data();
+        compileIfHot(f->function);
+
+#ifdef CPPLOX_DEBUG_TRACE_EXECUTION
+        Disassembler disassembler;
+        disassembler.disassembleChunk(f->function->chunk,
+                                      f->function->name.c_str());
+#endif
+
+        return true;
+    }
+
+    bool VM::resumeAot() {
+        CallFrame& frame = frames.back();
+        Chunk& chunk = frame.closure->function->chunk;
+        const AotFrame aotFrame{
+            .vm = this,
+            .slots = stack.data() + frame.bp,
+            .code = chunk.code.data(),
+            .constants = chunk.constants.data(),
+            .globals = globals.values(),
+        };
+        const std::size_t offset = static_cast<std::size_t>(frame.ip - chunk.code.data());
+        // the stubs never push or pop frames, so frame stays valid
+        const AotExit exit = frame.closure->function->aotEntry(aotFrame, stack.end(), offset);
+        if (exit.sp == nullptr) {
+            return false;
+        }
+
+        frame.ip = exit.ip;
+        stack.setEnd(exit.sp);
+        return true;
+    }
+
+    void VM::compileIfHot([[maybe_unused]] Function* function) {
+#ifdef CPPLOX_JIT
+        // the C++ code of an ahead-of-time built program is not compiled again
+        if (function->jitCode == nullptr && function->jitFailed == false &&
+            function->aotEntry == nullptr && ++function->callCount > jitThreshold) {
+            jit.compile(*function);
+        }
+#endif
+    }
+
+    void VM::compileIfHotLoop([[maybe_unused]] Function* function) {
+#ifdef CPPLOX_JIT
+        if (function->jitCode == nullptr && function->jitFailed == false &&
+            ++function->backEdgeCount > osrThreshold) {
+            jit.compile(*function);
+        }
+#endif
+    }
+
     Upvalue* VM::captureUpvalue(std::size_t offset) {
         if (offset >= stack.size()) {
             runtimeError("Internal error.");
@@ -665,13 +1329,166 @@ namespace cpplox {
         const Value* const location = &stack.at(offset);
         while (openUpvalues != nullptr && openUpvalues->location >= location) {
             Upvalue* const upv = openUpvalues;
+            const HeapLock lock = beforeStore(upv->closed);
             upv->closed = *upv->location;
             upv->location = &upv->closed;
+            writeBarrier(upv, upv->closed);
 
             openUpvalues = openUpvalues->next;
         }
     }
 
+    bool VM::getProperty(Instance* inst, const String& name, PropertyCache& cache) {
+        std::size_t slot = 0;
+        if (inst->shape->find(&name, slot)) {
+            fillPropertyCache(cache, {
+                .shape = inst->shape,
+                .slot = static_cast<std::uint32_t>(slot),
+            });
+            stack.peek() = inst->fields[slot];
+            return true;
+        }
+
+        Value method;
+        if (inst->klass->methods.find(&name, method) == false) {
+            runtimeError("Undefined property '{}'.", name);
+            return false;
+        }
+
+        // Methods are only added while a class is being defined, before
+        // any of its instances exist, so the method cached for a shape
+        // never changes and needs no invalidation.
+        Closure* closure = method.asObject()->as<Closure>();
+        fillPropertyCache(cache, {.shape = inst->shape, .method = closure});
+        return bindMethod(closure);
+    }
+
+    bool VM::setProperty(Instance* inst,
+                         const String& name,
+                         const Value& value,
+                         PropertyCache& cache) {
+        Shape* const shape = inst->shape;
+        std::size_t slot = 0;
+        if (shape->find(&name, slot)) {
+            {
+                const HeapLock lock = beforeStore(inst->fields[slot]);
+                inst->fields[slot] = value;
+                writeBarrier(inst, value);
+            }
+            fillPropertyCache(cache, {
+                .shape = shape,
+                .slot = static_cast<std::uint32_t>(slot),
+            });
+            return true;
+        }
+
+        slot = inst->fields.getCount();
+        if (addField(inst, name, value) == false) {
+            return false;
+        }
+        fillPropertyCache(cache, {
+            .shape = shape,
+            .next = inst->shape,
+            .slot = static_cast<std::uint32_t>(slot),
+        });
+
+        return true;
+    }
+
+    bool VM::addField(Instance* inst, const String& name, const Value& value) {
+        Shape* next = inst->shape->transition(&name);
+        if (next == nullptr) {
+            next = makeObject<Shape>(*inst->shape, &name);
+            if (next == nullptr) {
+                return false;
+            }
+            const HeapLock lock = beforeStore(inst->shape);
+            inst->shape->addTransition(&name, next);
+            writeBarrier(inst->shape);
+        }
+
+        const HeapLock lock = beforeStore(inst);
+        inst->shape = next;
+        inst->fields.insertBack(value);
+        writeBarrier(inst);
+
+        Class* klass = inst->klass;
+        if (klass->fieldCountHint < inst->fields.getCount()) {
+            klass->fieldCountHint = inst->fields.getCount();
+        }
+
+        return true;
+    }
+
+    bool VM::makeClosure(Function* function, const std::uint8_t*& upvalues) {
+        Closure* closure = makeObject<Closure>(function);
+        if (closure == nullptr) {
+            return false;
+        }
+        stack.push(Value(closure));
+
+        const CallFrame& frame = frames.back();
+        const std::size_t count = *(upvalues++);
+        for (std::size_t i = 0; i < count; ++i) {
+            const bool isLocal = *(upvalues++) == 1;
+            Upvalue* upvalue = nullptr;
+            if (isLocal) {
+                const std::size_t index = parseTwoByteInteger(upvalues[0], upvalues[1]);
+                upvalues += 2;
+                upvalue = captureUpvalue(frame.bp + index);
+                if (upvalue == nullptr) {
+                    return false;
+                }
+            } else {
+                upvalue = frame.closure->upvalues[*(upvalues++)];
+            }
+            // the closure is old if a capture above collected the nursery,
+            // or in the snapshot of a marking started by it
+            const HeapLock lock = beforeStore(closure);
+            closure->upvalues[i] = upvalue;
+            writeBarrier(closure);
+        }
+
+        return true;
+    }
+
+    bool VM::makeClass(const String& name) {
+        Shape* rootShape = makeObject<Shape>();
+        if (rootShape == nullptr) {
+            return false;
+        }
+        // keep the shape reachable while allocating the class
+        stack.push(Value(rootShape));
+        Class* classObj = makeObject<Class>(name, rootShape);
+        if (classObj == nullptr) {
+            return false;
+        }
+        stack.peek() = Value(classObj);
+
+        return true;
+    }
+
+    bool VM::inherit() {
+        Value& subclass = stack.peek();
+        Value& superclass = stack.peekN(1);
+
+        if (superclass.isObject() == false ||
+            superclass.asObject()->hasType(ObjectType::CLASS) == false)
+        {
+            runtimeError("Can only inherit classes.");
+            return false;
+        }
+
+        Class* subclassObj = subclass.asObject()->as<Class>();
+        Class* superclassObj = superclass.asObject()->as<Class>();
+        const HeapLock lock = beforeStore(subclassObj);
+        subclassObj->methods = superclassObj->methods;
+        writeBarrier(subclassObj);
+
+        stack.popN(1); // subclass
+        return true;
+    }
+
     void VM::defineMethod(const String& name) {
         Value& method = stack.peek();
         Value& classObj = stack.peekN(1);
@@ -679,7 +1496,9 @@ namespace cpplox {
         if (classObj.isObject() && method.isObject()) {
             Class* c = classObj.asObject()->as<Class>();
             if (c != nullptr) {
-                c->methods.insert(name, method);
+                const HeapLock lock = beforeStore(c);
+                c->methods.insert(&name, method);
+                writeBarrier(c, method);
             }
         }
 
@@ -688,14 +1507,17 @@ namespace cpplox {
 
     bool VM::bindMethod(Class* klass, const String& name) {
         Value method;
-        bool found = klass->methods.find(name, method);
+        bool found = klass->methods.find(&name, method);
         if (found == false) {
             runtimeError("Undefined property '{}'.", name);
             return false;
         }
 
-        Closure* cl = method.asObject()->as<Closure>();
-        BoundMethod* bm = makeObject<BoundMethod>(stack.peek(), cl);
+        return bindMethod(method.asObject()->as<Closure>());
+    }
+
+    bool VM::bindMethod(Closure* method) {
+        BoundMethod* bm = makeObject<BoundMethod>(stack.peek(), method);
         if (bm != nullptr) {
             stack.pop();
             stack.push(Value(bm));
@@ -706,16 +1528,16 @@ namespace cpplox {
     }
 
     template <NumberBinaryOp Op>
-    bool VM::numBinaryOp(const Op& op) {
-        if (stack.peek().isNumber() && stack.peekN(1).isNumber()) {
-            const double b = stack.pop().asNumber();
-            const double a = stack.pop().asNumber();
-            stack.push(op(a, b));
+    bool VM::numBinaryOp(Value*& top, const Op& op) {
+        Value& b = top[-1];
+        Value& a = top[-2];
+        if (a.isNumber() && b.isNumber()) {
+            a = op(a.asNumber(), b.asNumber());
+            --top;
 
             return true;
         }
 
-        runtimeError("Operands must be numbers.");
         return false;
     }
 
@@ -741,6 +1563,10 @@ namespace cpplox {
         appendCallStackInfo(b);
     }
 
+    // the errors reported by the stubs of compiled code
+    template void VM::runtimeError<>(std::string_view);
+    template void VM::runtimeError<const String&>(std::string_view, const String&);
+
     void VM::appendCallStackInfo(FmtBuffer& buf) {
         buf.buffer.clear();
 
@@ -756,26 +1582,44 @@ namespace cpplox {
                                "\n[line {}] in {}",
                                line,
                                i != 1 ? frame.closure->function->name : "script");
-                error += std::string_view(buf.buffer.data(), buf.buffer.size());
-                buf.buffer.clear();
             }
         }
+
+        error += std::string_view(buf.buffer.data(), buf.buffer.size());
+        buf.buffer.clear();
     }
 
     template <typename T, typename... Args>
     T* VM::makeObject(Args&&... args) {
 #ifdef CPPLOX_DEBUG_STRESS_GC
-        runGC();
+        // a minor collection first, which frees whatever young object
+        // a missing write barrier leaves unreachable
+        collectNursery();
+        if (incrementalGC) {
+            stepGC();
+        } else {
+            runGC();
+        }
 #endif
 
-        if (bytesAllocated > nextGC) {
-            runGC();
+        if (nurseryBytes > nurserySize) {
+            collectNursery();
+        }
+        if (gcPhase != GCPhase::IDLE) {
+            if (bytesSinceGCStep > GC_STEP_BYTES) {
+                stepGC();
+            }
+        } else if (bytesAllocated > nextGC) {
+            if (incrementalGC) {
+                stepGC();
+            } else {
+                runGC();
+            }
         }
 
         T* obj = gc::makeObject<T>(std::forward<Args>(args)...);
         if (obj != nullptr) {
-            bytesAllocated += sizeof(T);
-            gcObjects.insertBack(obj);
+            track(obj);
         }
         else {
             runtimeError("Out of memory");
@@ -784,6 +1628,28 @@ namespace cpplox {
         return obj;
     }
 
+    void VM::track(Object* obj) {
+        const std::size_t size = objectSize(obj);
+        bytesAllocated += size;
+        nurseryBytes += size;
+        bytesSinceGCStep += size;
+        if (nursery == nullptr) {
+            nurseryTail = obj;
+        }
+        obj->next = nursery;
+        nursery = obj;
+
+        if (markingConcurrently) {
+            // allocated black, what the constructor stored into it
+            // is in the snapshot or allocated since as well
+            obj->isReachable = true;
+        } else if (gcPhase == GCPhase::MARKING) {
+            // allocated gray, so that what the constructor
+            // stored into it is marked as well
+            marker.visit(obj);
+        }
+    }
+
     std::size_t VM::objectSize(Object* obj) {
         if (obj == nullptr) {
             return 0;
@@ -809,34 +1675,75 @@ namespace cpplox {
             case ObjectType::BOUND_METHOD: {
                 objSize = sizeof(BoundMethod);
             } break;
+            case ObjectType::STRING: {
+                objSize = sizeof(StringObject) + obj->as<StringObject>()->capacity();
+            } break;
+            case ObjectType::SHAPE: {
+                objSize = sizeof(Shape);
+            } break;
         }
 
         return objSize;
     }
 
-    void VM::runGC() {
+    void VM::collectNursery() {
+        // the nursery is swept with the old objects when they are marked
+        if (gcPhase == GCPhase::CLEARING || gcPhase == GCPhase::MARKING) {
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+#ifdef CPPLOX_DEBUG_LOG_GC
+        const auto before = bytesAllocated;
+#endif
+
+        // the old objects are still marked from the last collection,
+        // so marking stops at them
         traceGCRoots();
+        strings.removeUnreachable();
+        promoteNursery();
 
 #ifdef CPPLOX_DEBUG_LOG_GC
-const auto before = bytesAllocated;
+        println("Minor GC collected {} bytes from the total {}.",
+                before - bytesAllocated,
+                before);
 #endif
+        recordPause(start);
+    }
 
-        // todo: optimize with intrusive linked list
-        forEach(gcObjects, [this](Object* &obj) {
-            if (obj != nullptr) {
-                if (obj->isReachable == false) {
-                    bytesAllocated -= objectSize(obj);
-                    gc::freeObject(obj);
-                    obj = nullptr;
-                }
-                else {
-                    obj->isReachable = false;
-                }
-            }
-        });
-        removeIf(gcObjects, [] (const Object* obj) {
-            return obj == nullptr;
+    void VM::runGC() {
+        const auto start = std::chrono::steady_clock::now();
+#ifdef CPPLOX_DEBUG_LOG_GC
+        const auto before = bytesAllocated;
+#endif
+
+        for (Object* obj = oldObjects; obj != nullptr; obj = obj->next) {
+            obj->isReachable = false;
+        }
+        // everything is traced, the remembered set is not needed
+        forEach(rememberedSet, [](Object* obj) {
+            obj->isRemembered = false;
         });
+        rememberedSet.clear();
+
+        traceGCRoots();
+        strings.removeUnreachable();
+
+        // unlink the unreachable objects in place, only the headers are
+        // touched, the reachable ones stay marked
+        Object** link = &oldObjects;
+        while (*link != nullptr) {
+            Object* obj = *link;
+            if (obj->isReachable == false) {
+                *link = obj->next;
+                bytesAllocated -= objectSize(obj);
+                gc::freeObject(obj);
+            }
+            else {
+                link = &obj->next;
+            }
+        }
+        promoteNursery();
 
         const std::uint64_t HEAP_GROWTH_FACTOR = 2;
         nextGC = bytesAllocated * HEAP_GROWTH_FACTOR;
@@ -847,31 +1754,285 @@ const auto before = bytesAllocated;
                 before,
                 nextGC);
 #endif
+        recordPause(start);
     }
 
-    void VM::traceGCRoots() {
-        const std::size_t stackSize = stack.size();
-        for (std::size_t i = 0; i < stackSize; ++i) {
-            Value& v = stack.at(i);
-            if (v.isObject()) {
-                gc::traceRoot(v.asObject());
+    void VM::stepGC() {
+#ifdef CPPLOX_DEBUG_STRESS_GC
+        // the smallest steps, so that the program runs in every phase
+        const bool finish = false;
+#else
+        // a collection outpaced by the allocations finishes in this step
+        const bool finish = bytesAllocated > nextGC * 2;
+#endif
+        bytesSinceGCStep = 0;
+        // the program goes on while the thread marks
+        const auto isWaitingForMarker = [this, finish] {
+            return markingConcurrently && finish == false &&
+                   markerDone.load(std::memory_order_acquire) == false;
+        };
+        if (isWaitingForMarker()) {
+#ifdef CPPLOX_DEBUG_STRESS_GC
+            // the marking goes on between any two allocations
+            std::this_thread::yield();
+#endif
+            return;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + gcPauseBudget;
+
+        if (gcPhase == GCPhase::IDLE) {
+            clearCursor = oldObjects;
+            gcPhase = GCPhase::CLEARING;
+        }
+
+        do {
+            switch (gcPhase) {
+                case GCPhase::CLEARING: {
+                    for (std::size_t i = 0; i < GC_STEP_OBJECTS && clearCursor != nullptr; ++i) {
+                        clearCursor->isReachable = false;
+                        clearCursor = clearCursor->next;
+                    }
+                    if (clearCursor == nullptr) {
+                        // everything is traced, the remembered set is not needed
+                        forEach(rememberedSet, [](Object* obj) {
+                            obj->isRemembered = false;
+                        });
+                        rememberedSet.clear();
+                        visitGCRoots();
+                        gcPhase = GCPhase::MARKING;
+                        if (concurrentGC) {
+                            startMarkerThread();
+                        }
+                    }
+                } break;
+                case GCPhase::MARKING: {
+                    if (markingConcurrently) {
+                        if (isWaitingForMarker()) {
+                            break;
+                        }
+                        // the final remark, the barriers kept the snapshot so
+                        // only what they marked since the thread is done is left
+                        markerThread.join();
+                        markingConcurrently = false;
+                        marker.trace();
+                    } else if (marker.trace(GC_STEP_OBJECTS)) {
+                        // the roots change without write barriers,
+                        // mark what they refer to by now
+                        visitGCRoots();
+                        marker.trace();
+                    } else {
+                        break;
+                    }
+                    strings.removeUnreachable();
+
+                    // the nursery holds the objects allocated since
+                    // the marking started, sweep it with the old ones
+                    if (nursery != nullptr) {
+                        nurseryTail->next = oldObjects;
+                        oldObjects = nursery;
+                        nursery = nullptr;
+                        nurseryTail = nullptr;
+                        nurseryBytes = 0;
+                    }
+                    sweepCursor = &oldObjects;
+                    gcPhase = GCPhase::SWEEPING;
+                } break;
+                case GCPhase::SWEEPING: {
+                    for (std::size_t i = 0; i < GC_STEP_OBJECTS && *sweepCursor != nullptr; ++i) {
+                        Object* obj = *sweepCursor;
+                        if (obj->isReachable == false) {
+                            *sweepCursor = obj->next;
+                            bytesAllocated -= objectSize(obj);
+                            gc::freeObject(obj);
+                        }
+                        else {
+                            obj->isOld = true;
+                            sweepCursor = &obj->next;
+                        }
+                    }
+                    if (*sweepCursor == nullptr) {
+                        const std::uint64_t HEAP_GROWTH_FACTOR = 2;
+                        nextGC = bytesAllocated * HEAP_GROWTH_FACTOR;
+                        gcPhase = GCPhase::IDLE;
+#ifdef CPPLOX_DEBUG_LOG_GC
+                        println("Incremental GC done with {} bytes left. Next run at {}.",
+                                bytesAllocated,
+                                nextGC);
+#endif
+                    }
+                } break;
+                case GCPhase::IDLE: {
+                } break;
             }
+        } while (gcPhase != GCPhase::IDLE && isWaitingForMarker() == false &&
+                 (finish || std::chrono::steady_clock::now() < deadline));
+
+        recordPause(start);
+    }
+
+    void VM::startMarkerThread() {
+        markerDone = false;
+        try {
+            markerThread = std::thread(&VM::markConcurrently, this);
+            markingConcurrently = true;
+        } catch (const std::system_error&) {
+            // without a thread the marking goes on in steps
         }
+    }
 
-        globals.forEachValue([](Value& v) {
-            if (v.isObject()) {
-                gc::traceRoot(v.asObject());
+    void VM::markConcurrently() {
+        bool isDone = false;
+        while (isDone == false) {
+            // the program stores into the objects between the chunks
+            {
+                const HeapLock lock(heapMutex);
+                isDone = marker.trace(GC_STEP_OBJECTS);
             }
-        });
+#ifdef CPPLOX_DEBUG_STRESS_GC
+            // the program goes on between any two chunks
+            std::this_thread::yield();
+#endif
+        }
+        markerDone.store(true, std::memory_order_release);
+    }
+
+    void VM::recordPause(std::chrono::steady_clock::time_point start) {
+        gcPauses.insertBack(std::chrono::steady_clock::now() - start);
+    }
+
+    GCStats VM::gcStats() const {
+        GCStats stats;
+        stats.pauses = gcPauses.getCount();
+        if (stats.pauses == 0) {
+            return stats;
+        }
+
+        Vector<std::chrono::nanoseconds> pauses = gcPauses;
+        std::chrono::nanoseconds* const first = pauses.data();
+        std::chrono::nanoseconds* const last = first + stats.pauses;
+        for (const std::chrono::nanoseconds* p = first; p != last; ++p) {
+            stats.total += *p;
+            stats.max = std::max(stats.max, *p);
+        }
+        // the smallest pause at least 99% of the pauses do not exceed
+        std::chrono::nanoseconds* const p99 = first + (stats.pauses * 99 + 99) / 100 - 1;
+        std::nth_element(first, p99, last);
+        stats.p99 = *p99;
+
+        return stats;
+    }
+
+    void VM::promoteNursery() {
+        Object* obj = nursery;
+        while (obj != nullptr) {
+            Object* const next = obj->next;
+            if (obj->isReachable == false) {
+                bytesAllocated -= objectSize(obj);
+                gc::freeObject(obj);
+            }
+            else {
+                obj->isOld = true;
+                obj->next = oldObjects;
+                oldObjects = obj;
+            }
+            obj = next;
+        }
+
+        nursery = nullptr;
+        nurseryTail = nullptr;
+        nurseryBytes = 0;
+    }
+
+    void VM::storedIntoMarked(Object* owner, const Value& stored) {
+        if (markingConcurrently) {
+            // beforeStore kept the snapshot
+        } else if (gcPhase == GCPhase::MARKING) {
+            marker.visit(stored);
+        } else if (gc::isYoung(stored)) {
+            remember(owner);
+        }
+    }
 
-        forEach(frames, [](CallFrame& f) { 
-            gc::traceRoot(f.closure);
+    void VM::storedIntoMarked(Object* owner) {
+        if (markingConcurrently) {
+            // beforeStore kept the snapshot
+        } else if (gcPhase == GCPhase::MARKING) {
+            marker.retrace(owner);
+        } else {
+            remember(owner);
+        }
+    }
+
+    void VM::remember(Object* owner) {
+        owner->isRemembered = true;
+        rememberedSet.insertBack(owner);
+    }
+
+    VM::HeapLock VM::shadeOverwritten(const Value& overwritten) {
+        HeapLock lock(heapMutex);
+        marker.visit(overwritten);
+        return lock;
+    }
+
+    VM::HeapLock VM::shadeReferences(Object* owner) {
+        HeapLock lock(heapMutex);
+        owner->trace(marker);
+        return lock;
+    }
+
+    void VM::stringFound(StringObject* s) {
+        // the snapshot may not have s, which is about to be referred to
+        if (markingConcurrently) {
+            const HeapLock lock(heapMutex);
+            marker.visit(s);
+        }
+    }
+
+    void VM::fillPropertyCache(PropertyCache& cache, const PropertyCache::Entry& entry) {
+        Function* const function = frames.back().closure->function;
+        const HeapLock lock = beforeStore(function);
+        cache.insert(entry);
+        writeBarrier(function);
+    }
+
+    void VM::visitGCRoots() {
+        const std::size_t stackSize = stack.size();
+        for (std::size_t i = 0; i < stackSize; ++i) {
+            marker.visit(stack.at(i));
+        }
+
+        Value* const globalSlots = globals.values();
+        const std::size_t globalsCount = globals.size();
+        for (std::size_t i = 0; i < globalsCount; ++i) {
+            marker.visit(globalSlots[i]);
+        }
+
+        marker.visit(initString);
+
+        forEach(frames, [this](CallFrame& f) {
+            marker.visit(f.closure);
         });
 
         for (Upvalue* upvalue = openUpvalues; upvalue != nullptr;
              upvalue = upvalue->next)
         {
-            gc::traceRoot(upvalue);
+            marker.visit(upvalue);
         }
     }
+
+    void VM::traceGCRoots() {
+        visitGCRoots();
+
+        // the children of the remembered objects, which are old and
+        // marked, may be young
+        forEach(rememberedSet, [this](Object* obj) {
+            obj->isRemembered = false;
+            obj->trace(marker);
+        });
+        rememberedSet.clear();
+
+        marker.trace();
+    }
 }
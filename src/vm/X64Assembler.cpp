@@ -0,0 +1,276 @@
+#include "cpplox/vm/X64Assembler.hpp"
+
+namespace cpplox::x64 {
+    namespace {
+        std::uint8_t encoding(Reg r) {
+            return static_cast<std::uint8_t>(r);
+        }
+
+        std::uint8_t encoding(Xmm r) {
+            return static_cast<std::uint8_t>(r);
+        }
+
+        bool fitsInt8(std::int64_t value) {
+            return value >= -128 && value <= 127;
+        }
+    } // namespace
+
+    Label Assembler::newLabel() {
+        labels.insertBack(UNBOUND);
+        return Label{labels.getCount() - 1};
+    }
+
+    void Assembler::bind(Label label) {
+        labels[label.id] = buffer.getCount();
+    }
+
+    bool Assembler::finish() {
+        for (std::size_t i = 0; i < fixups.getCount(); ++i) {
+            const Fixup& fixup = fixups[i];
+            const std::size_t target = labels[fixup.target.id];
+            if (target == UNBOUND) {
+                return false;
+            }
+
+            const auto displacement = static_cast<std::uint32_t>(
+                static_cast<std::int64_t>(target) - static_cast<std::int64_t>(fixup.at + 4));
+            for (std::size_t k = 0; k < 4; ++k) {
+                buffer[fixup.at + k] = static_cast<std::uint8_t>(displacement >> (8 * k));
+            }
+        }
+
+        return true;
+    }
+
+    void Assembler::push(Reg r) {
+        if (encoding(r) >= 8) {
+            emit(0x41);
+        }
+        emit(0x50 + (encoding(r) & 7));
+    }
+
+    void Assembler::pop(Reg r) {
+        if (encoding(r) >= 8) {
+            emit(0x41);
+        }
+        emit(0x58 + (encoding(r) & 7));
+    }
+
+    void Assembler::ret() {
+        emit(0xC3);
+    }
+
+    void Assembler::mov(Reg dst, Reg src) {
+        aluRR(0x89, dst, src);
+    }
+
+    void Assembler::mov(Reg dst, std::uint64_t imm) {
+        rexW(0, encoding(dst));
+        emit(0xB8 + (encoding(dst) & 7));
+        emit64(imm);
+    }
+
+    void Assembler::load(Reg dst, Reg base, std::int32_t disp) {
+        rexW(encoding(dst), encoding(base));
+        emit(0x8B);
+        memory(encoding(dst), base, disp);
+    }
+
+    void Assembler::store(Reg base, std::int32_t disp, Reg src) {
+        rexW(encoding(src), encoding(base));
+        emit(0x89);
+        memory(encoding(src), base, disp);
+    }
+
+    void Assembler::add(Reg dst, Reg src) {
+        aluRR(0x01, dst, src);
+    }
+
+    void Assembler::add(Reg dst, std::int32_t imm) {
+        aluRI(0, dst, imm);
+    }
+
+    void Assembler::sub(Reg dst, Reg src) {
+        aluRR(0x29, dst, src);
+    }
+
+    void Assembler::sub(Reg dst, std::int32_t imm) {
+        aluRI(5, dst, imm);
+    }
+
+    void Assembler::and_(Reg dst, Reg src) {
+        aluRR(0x21, dst, src);
+    }
+
+    void Assembler::xor_(Reg dst, Reg src) {
+        aluRR(0x31, dst, src);
+    }
+
+    void Assembler::xor_(Reg dst, std::int32_t imm) {
+        aluRI(6, dst, imm);
+    }
+
+    void Assembler::cmp(Reg a, Reg b) {
+        aluRR(0x39, a, b);
+    }
+
+    void Assembler::cmp(Reg a, std::int32_t imm) {
+        aluRI(7, a, imm);
+    }
+
+    void Assembler::test(Reg a, Reg b) {
+        aluRR(0x85, a, b);
+    }
+
+    void Assembler::btc(Reg r, std::uint8_t bit) {
+        rexW(0, encoding(r));
+        emit(0x0F);
+        emit(0xBA);
+        modRM(3, 7, encoding(r));
+        emit(bit);
+    }
+
+    void Assembler::set(Cond cond, Reg dst) {
+        // setcc dst8, then movzx dst32, dst8 which clears the upper bits
+        emit(0x0F);
+        emit(0x90 + static_cast<std::uint8_t>(cond));
+        modRM(3, 0, encoding(dst));
+        emit(0x0F);
+        emit(0xB6);
+        modRM(3, encoding(dst), encoding(dst));
+    }
+
+    void Assembler::movq(Xmm dst, Reg src) {
+        emit(0x66);
+        rexW(encoding(dst), encoding(src));
+        emit(0x0F);
+        emit(0x6E);
+        modRM(3, encoding(dst), encoding(src));
+    }
+
+    void Assembler::movq(Reg dst, Xmm src) {
+        emit(0x66);
+        rexW(encoding(src), encoding(dst));
+        emit(0x0F);
+        emit(0x7E);
+        modRM(3, encoding(src), encoding(dst));
+    }
+
+    void Assembler::addsd(Xmm dst, Xmm src) {
+        sse(0xF2, 0x58, dst, src);
+    }
+
+    void Assembler::subsd(Xmm dst, Xmm src) {
+        sse(0xF2, 0x5C, dst, src);
+    }
+
+    void Assembler::mulsd(Xmm dst, Xmm src) {
+        sse(0xF2, 0x59, dst, src);
+    }
+
+    void Assembler::divsd(Xmm dst, Xmm src) {
+        sse(0xF2, 0x5E, dst, src);
+    }
+
+    void Assembler::ucomisd(Xmm a, Xmm b) {
+        sse(0x66, 0x2E, a, b);
+    }
+
+    void Assembler::jmp(Label target) {
+        emit(0xE9);
+        jump(target);
+    }
+
+    void Assembler::jcc(Cond cond, Label target) {
+        emit(0x0F);
+        emit(0x80 + static_cast<std::uint8_t>(cond));
+        jump(target);
+    }
+
+    void Assembler::jmp(Reg target) {
+        if (encoding(target) >= 8) {
+            emit(0x41);
+        }
+        emit(0xFF);
+        modRM(3, 4, encoding(target));
+    }
+
+    void Assembler::call(Reg target) {
+        if (encoding(target) >= 8) {
+            emit(0x41);
+        }
+        emit(0xFF);
+        modRM(3, 2, encoding(target));
+    }
+
+    void Assembler::emit(std::uint8_t byte) {
+        buffer.insertBack(byte);
+    }
+
+    void Assembler::emit32(std::uint32_t value) {
+        for (std::size_t k = 0; k < 4; ++k) {
+            emit(static_cast<std::uint8_t>(value >> (8 * k)));
+        }
+    }
+
+    void Assembler::emit64(std::uint64_t value) {
+        for (std::size_t k = 0; k < 8; ++k) {
+            emit(static_cast<std::uint8_t>(value >> (8 * k)));
+        }
+    }
+
+    void Assembler::rexW(std::uint8_t reg, std::uint8_t rm) {
+        emit(0x48 | ((reg >> 3) << 2) | (rm >> 3));
+    }
+
+    void Assembler::modRM(std::uint8_t mod, std::uint8_t reg, std::uint8_t rm) {
+        emit(static_cast<std::uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+    }
+
+    void Assembler::memory(std::uint8_t reg, Reg base, std::int32_t disp) {
+        // [rbp] and [r13] have no form without a displacement,
+        // so every access carries one
+        const bool shortDisp = fitsInt8(disp);
+        modRM(shortDisp ? 1 : 2, reg, encoding(base));
+        if ((encoding(base) & 7) == 4) {
+            // rsp and r12 as a base need a SIB byte with no index
+            emit(0x24);
+        }
+        if (shortDisp) {
+            emit(static_cast<std::uint8_t>(disp));
+        } else {
+            emit32(static_cast<std::uint32_t>(disp));
+        }
+    }
+
+    void Assembler::aluRR(std::uint8_t opcode, Reg dst, Reg src) {
+        rexW(encoding(src), encoding(dst));
+        emit(opcode);
+        modRM(3, encoding(src), encoding(dst));
+    }
+
+    void Assembler::aluRI(std::uint8_t ext, Reg dst, std::int32_t imm) {
+        rexW(0, encoding(dst));
+        if (fitsInt8(imm)) {
+            emit(0x83);
+            modRM(3, ext, encoding(dst));
+            emit(static_cast<std::uint8_t>(imm));
+        } else {
+            emit(0x81);
+            modRM(3, ext, encoding(dst));
+            emit32(static_cast<std::uint32_t>(imm));
+        }
+    }
+
+    void Assembler::sse(std::uint8_t prefix, std::uint8_t opcode, Xmm dst, Xmm src) {
+        emit(prefix);
+        emit(0x0F);
+        emit(opcode);
+        modRM(3, encoding(dst), encoding(src));
+    }
+
+    void Assembler::jump(Label target) {
+        fixups.insertBack(Fixup{.at = buffer.getCount(), .target = target});
+        emit32(0);
+    }
+} // namespace cpplox::x64
@@ -1,5 +1,6 @@
 #include "doctest/doctest.h"
 #include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
 
 TEST_CASE("fitsOneByte") {
     using cpplox::fitsOneByte;
@@ -22,6 +23,20 @@ TEST_CASE("fitsTwoBytes") {
     CHECK_FALSE(fitsTwoBytes(999999));
 }
 
+TEST_CASE("operandOf reads the one and the two-byte form") {
+    using cpplox::OpCode;
+    using cpplox::operandEnd;
+    using cpplox::operandOf;
+
+    const std::uint8_t shortForm[] = {static_cast<std::uint8_t>(OpCode::READ_GLOBAL), 7};
+    CHECK(operandOf(shortForm, OpCode::READ_GLOBAL) == 7);
+    CHECK(operandEnd(shortForm, OpCode::READ_GLOBAL) == 2);
+
+    const std::uint8_t longForm[] = {static_cast<std::uint8_t>(OpCode::READ_GLOBAL_16), 0x34, 0x12};
+    CHECK(operandOf(longForm, OpCode::READ_GLOBAL) == 0x1234);
+    CHECK(operandEnd(longForm, OpCode::READ_GLOBAL) == 3);
+}
+
 TEST_SUITE("Two-byte (de)serialization") {
     using cpplox::parseTwoByteInteger;
     using cpplox::serializeTwoByteInteger;
@@ -57,4 +72,135 @@ TEST_SUITE("Two-byte (de)serialization") {
         CHECK(parseTwoByteInteger(0xFF, 0x00) == 0x00FF);
         CHECK(parseTwoByteInteger(0x00, 0xFF) == 0xFF00);
     }
-}
\ No newline at end of file
+}
+
+namespace {
+    using cpplox::Chunk;
+    using cpplox::OpCode;
+    using cpplox::addCode;
+
+    void emit(Chunk& chunk, OpCode op) {
+        addCode(chunk, static_cast<std::uint8_t>(op), 1);
+    }
+
+    void emit(Chunk& chunk, OpCode op, std::uint8_t operand) {
+        emit(chunk, op);
+        addCode(chunk, operand, 1);
+    }
+
+    void emit(Chunk& chunk, OpCode op, std::uint8_t a, std::uint8_t b) {
+        emit(chunk, op, a);
+        addCode(chunk, b, 1);
+    }
+} // namespace
+
+TEST_SUITE("Instruction length") {
+    using cpplox::instructionLength;
+
+    TEST_CASE("instructionLength accounts for the operands") {
+        Chunk chunk;
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::READ_LOCAL, 1);
+        emit(chunk, OpCode::JMP, 0, 0);
+        emit(chunk, OpCode::MAKE_CLOSURE, 0);
+        addCode(chunk, 2, 1);        // upvalues count
+        addCode(chunk, 1, 1);        // local, two-byte index
+        addCode(chunk, 0, 1);
+        addCode(chunk, 0, 1);
+        addCode(chunk, 0, 1);        // enclosing, one-byte index
+        addCode(chunk, 0, 1);
+
+        CHECK(instructionLength(chunk, 0) == 1);
+        CHECK(instructionLength(chunk, 1) == 2);
+        CHECK(instructionLength(chunk, 3) == 3);
+        CHECK(instructionLength(chunk, 6) == 8);
+    }
+
+    TEST_CASE("property instructions carry a cache index") {
+        Chunk chunk;
+        CHECK(cpplox::addPropertyCache(chunk) == 0);
+        CHECK(cpplox::addPropertyCache(chunk) == 1);
+
+        emit(chunk, OpCode::GET_PROPERTY, 0);
+        addCode(chunk, 0, 1);        // cache index
+        addCode(chunk, 0, 1);
+        emit(chunk, OpCode::SET_PROPERTY_16, 0, 0);
+        addCode(chunk, 1, 1);        // cache index
+        addCode(chunk, 0, 1);
+
+        CHECK(instructionLength(chunk, 0) == 4);
+        CHECK(instructionLength(chunk, 4) == 5);
+        CHECK(chunk.propertyCaches.getCount() == 2);
+    }
+}
+
+TEST_SUITE("Stack depth") {
+    using cpplox::instructionLength;
+    using cpplox::maxStackDepth;
+
+    TEST_CASE("straight-line code") {
+        Chunk chunk;
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::TRUE);
+        emit(chunk, OpCode::FALSE);
+        emit(chunk, OpCode::EQUAL);
+        emit(chunk, OpCode::POP_N, 2);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::RETURN);
+
+        CHECK(maxStackDepth(chunk, 0) == 3);
+        CHECK(maxStackDepth(chunk, 2) == 5);
+    }
+
+    TEST_CASE("both branches of a conditional are taken into account") {
+        // if (true) { nil; } else { nil; nil; nil; }
+        Chunk chunk;
+        emit(chunk, OpCode::TRUE);
+        emit(chunk, OpCode::JMP_IF_FALSE, 6, 0);
+        emit(chunk, OpCode::POP);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::POP);
+        emit(chunk, OpCode::JMP, 6, 0);
+        emit(chunk, OpCode::POP);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::POP_N, 3);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::RETURN);
+
+        CHECK(maxStackDepth(chunk, 1) == 4);
+    }
+
+    TEST_CASE("a compare-and-branch pops its operands on both paths") {
+        // if (1 < 2) { nil; nil; } else { nil; }
+        Chunk chunk;
+        emit(chunk, OpCode::TRUE);
+        emit(chunk, OpCode::FALSE);
+        emit(chunk, OpCode::JMP_IF_NOT_LESS, 7, 0);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::POP_N, 2);
+        emit(chunk, OpCode::JMP, 2, 0);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::POP);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::RETURN);
+
+        CHECK(instructionLength(chunk, 2) == 3);
+        CHECK(maxStackDepth(chunk, 1) == 3);
+    }
+
+    TEST_CASE("a call leaves only its result") {
+        Chunk chunk;
+        emit(chunk, OpCode::READ_GLOBAL, 0);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::CALL, 2);
+        emit(chunk, OpCode::NIL);
+        emit(chunk, OpCode::ADD);
+        emit(chunk, OpCode::RETURN);
+
+        CHECK(maxStackDepth(chunk, 1) == 4);
+    }
+}
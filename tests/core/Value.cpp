@@ -2,7 +2,12 @@
 #include "cpplox/core/Value.hpp"
 #include "cpplox/core/String.hpp"
 
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
 using cpplox::Value;
+using cpplox::String;
 
 TEST_CASE("Value() is NIL") {
     Value v;
@@ -10,27 +15,31 @@ TEST_CASE("Value() is NIL") {
     CHECK(v.isNil());
 }
 
-TEST_CASE("Copy ctor for String") {
-    Value a(std::string_view("abc"));
+TEST_CASE("Copies of a String value refer to the same String") {
+    const String s("abc");
+    Value a(&s);
     Value b(a);
 
     REQUIRE(b.isString());
-    CHECK(a.asString() == b.asString());
+    CHECK(&b.asString() == &s);
+    CHECK(a == b);
 }
 
 TEST_CASE("Copy assignment - String in NIL") {
+    const String s("abc");
     Value a;
-    Value b(std::string_view("abc"));
+    Value b(&s);
 
     a = b;
 
     REQUIRE(a.isString());
-    CHECK(a.asString() == b.asString());
+    CHECK(&a.asString() == &s);
 }
 
 TEST_CASE("Copy assignment - Boolean in String") {
+    const String s("abc");
     Value a(true);
-    Value b(std::string_view("abc"));
+    Value b(&s);
 
     b = a;
 
@@ -38,33 +47,59 @@ TEST_CASE("Copy assignment - Boolean in String") {
     CHECK(b.asBoolean());
 }
 
-TEST_CASE("Move ctor for String") {
-    Value a(std::string_view("a"));
-    Value b(std::move(a));
+TEST_CASE("String values are equal only for the same String") {
+    const String s1("abc");
+    const String s2("abc");
 
-    REQUIRE(a.isNil());
-    REQUIRE(b.isString());
-    CHECK(b.asString() == "a");
+    CHECK(Value(&s1) == Value(&s1));
+    CHECK(Value(&s1) != Value(&s2));
 }
 
-TEST_CASE("Move assignment - String in Boolean") {
-    Value a(false);
-    Value b(std::string_view("a"));
-
-    a = std::move(b);
-
-    REQUIRE(b.isNil());
-    REQUIRE(a.isString());
-    CHECK(a.asString() == "a");
+TEST_CASE("Numbers keep their exact value") {
+    const double values[] = {0.0, -0.0, 1.5, -1e308, 4.9e-324,
+                             std::numeric_limits<double>::infinity()};
+    for (const double d : values) {
+        Value v(d);
+
+        REQUIRE(v.isNumber());
+        CHECK_FALSE(v.isNil());
+        CHECK_FALSE(v.isBoolean());
+        CHECK_FALSE(v.isObject());
+        CHECK_FALSE(v.isString());
+        CHECK(std::signbit(v.asNumber()) == std::signbit(d));
+        CHECK(v.asNumber() == d);
+    }
 }
 
-TEST_CASE("Move assignment - Boolean in String") {
-    Value a(true);
-    Value b(std::string_view("abc"));
+TEST_CASE("NaN is a number which is not equal to itself") {
+    Value v(std::numeric_limits<double>::quiet_NaN());
 
-    b = std::move(a);
+    REQUIRE(v.isNumber());
+    CHECK(std::isnan(v.asNumber()));
+    CHECK(v != v);
+}
 
-    REQUIRE(a.isNil());
-    REQUIRE(b.isBoolean());
-    CHECK(b.asBoolean());
+TEST_CASE("Types are told apart") {
+    Value nil;
+    Value t(true);
+    Value f(false);
+    Value obj(reinterpret_cast<cpplox::Object*>(std::uintptr_t{0x7f12345678f0}));
+    const String chars("str");
+    Value str(&chars);
+
+    CHECK(nil.internalType() == cpplox::ValueType::NIL);
+    CHECK(t.internalType() == cpplox::ValueType::BOOL);
+    CHECK(f.internalType() == cpplox::ValueType::BOOL);
+    CHECK(obj.internalType() == cpplox::ValueType::OBJECT);
+    CHECK(str.internalType() == cpplox::ValueType::STRING);
+
+    CHECK(t.asBoolean());
+    CHECK_FALSE(f.asBoolean());
+    CHECK(nil.isFalsey());
+    CHECK(f.isFalsey());
+    CHECK_FALSE(t.isFalsey());
+    CHECK_FALSE(Value(0.0).isFalsey());
+    CHECK(obj.asObject() == reinterpret_cast<cpplox::Object*>(std::uintptr_t{0x7f12345678f0}));
+    CHECK(t != f);
+    CHECK(nil == Value::nil());
 }
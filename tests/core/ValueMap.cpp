@@ -1,5 +1,6 @@
 #include "doctest/doctest.h"
 #include "cpplox/core/ValueMap.hpp"
+#include <memory>
 #include <string>
 #include <random>
 #include <unordered_map>
@@ -8,14 +9,17 @@ using cpplox::ValueMap;
 using cpplox::Value;
 using cpplox::String;
 
-namespace std {
-    template <>
-    struct hash<String> {
-        std::size_t operator()(const String& s) const noexcept {
-            return static_cast<std::size_t>(s.hashValue());
-        }
-    };
-} // namespace std
+// the map compares keys by identity, so equal keys must be the same String
+static const String* key(std::string_view chars) {
+    static std::unordered_map<std::string, std::unique_ptr<String>> interned;
+
+    auto& s = interned[std::string(chars)];
+    if (s == nullptr) {
+        s = std::make_unique<String>(chars);
+    }
+
+    return s.get();
+}
 
 static bool isBool(const Value& v, bool expected) {
     return v.isBoolean() && v.asBoolean() == expected;
@@ -29,92 +33,106 @@ TEST_CASE("Default constructed map is empty") {
     ValueMap m;
 
     CHECK(m.isEmpty());
-    CHECK_FALSE(m.contains("x"));
+    CHECK_FALSE(m.contains(key("x")));
 }
 
 TEST_CASE("Insert adds entries and contains/find locate them") {
     ValueMap m;
-    m.insert("a", Value(1.0));
-    m.insert("b", Value(true));
+    m.insert(key("a"), Value(1.0));
+    m.insert(key("b"), Value(true));
 
-    CHECK(m.contains("a"));
-    CHECK(m.contains("b"));
-    CHECK_FALSE(m.contains("c"));
+    CHECK(m.contains(key("a")));
+    CHECK(m.contains(key("b")));
+    CHECK_FALSE(m.contains(key("c")));
 
     Value v;
-    CHECK(m.find("a", v));
+    CHECK(m.find(key("a"), v));
     CHECK(isNumber(v, 1.0));
 
-    CHECK(m.find("b", v));
+    CHECK(m.find(key("b"), v));
     CHECK(isBool(v, true));
 }
 
 TEST_CASE("Remove deletes existing keys") {
     ValueMap m;
-    m.insert("a", Value(1.0));
-    m.insert("b", Value(false));
+    m.insert(key("a"), Value(1.0));
+    m.insert(key("b"), Value(false));
 
     Value removed;
-    bool found = m.remove("a", removed);
+    bool found = m.remove(key("a"), removed);
 
     CHECK(found);
     CHECK(isNumber(removed, 1.0));
-    CHECK_FALSE(m.contains("a"));
-    CHECK(m.contains("b"));
+    CHECK_FALSE(m.contains(key("a")));
+    CHECK(m.contains(key("b")));
+}
+
+TEST_CASE("Removing every key empties the map") {
+    ValueMap m;
+    m.insert(key("a"), Value(1.0));
+    m.insert(key("b"), Value(2.0));
+
+    Value removed;
+    CHECK(m.remove(key("a"), removed));
+    CHECK(m.remove(key("b"), removed));
+
+    CHECK(m.isEmpty());
+    CHECK_FALSE(m.contains(key("a")));
+    CHECK_FALSE(m.contains(key("b")));
 }
 
 TEST_CASE("Remove on missing key leaves map unchanged") {
     ValueMap m;
-    m.insert("a", Value(1.0));
+    m.insert(key("a"), Value(1.0));
 
     Value dummy(false);
-    bool found = m.remove("zzz", dummy);
+    bool found = m.remove(key("zzz"), dummy);
 
     CHECK_FALSE(found);
     CHECK(isBool(dummy, false));
-    CHECK(m.contains("a"));
+    CHECK(m.contains(key("a")));
 }
 
 TEST_CASE("Insert overwrites existing key") {
     ValueMap m;
-    m.insert("x", Value(1.0));
-    m.insert("x", Value(2.0));
+    m.insert(key("x"), Value(1.0));
+    m.insert(key("x"), Value(2.0));
 
     Value v;
-    CHECK(m.find("x", v));
+    CHECK(m.find(key("x"), v));
     CHECK(isNumber(v, 2.0));
 }
 
 TEST_CASE("Clear empties the map") {
     ValueMap m;
-    m.insert("a", Value(1.0));
-    m.insert("b", Value(true));
+    m.insert(key("a"), Value(1.0));
+    m.insert(key("b"), Value(true));
 
     m.clear();
 
     CHECK(m.isEmpty());
-    CHECK_FALSE(m.contains("a"));
-    CHECK_FALSE(m.contains("b"));
+    CHECK_FALSE(m.contains(key("a")));
+    CHECK_FALSE(m.contains(key("b")));
 }
 
 TEST_CASE("Swap exchanges contents of two maps") {
     ValueMap a;
-    a.insert("x", Value(10.0));
+    a.insert(key("x"), Value(10.0));
 
     ValueMap b;
-    b.insert("y", Value(false));
+    b.insert(key("y"), Value(false));
 
     a.swap(b);
 
-    CHECK(a.contains("y"));
-    CHECK_FALSE(a.contains("x"));
-    CHECK(b.contains("x"));
-    CHECK_FALSE(b.contains("y"));
+    CHECK(a.contains(key("y")));
+    CHECK_FALSE(a.contains(key("x")));
+    CHECK(b.contains(key("x")));
+    CHECK_FALSE(b.contains(key("y")));
 
     Value v;
-    CHECK(a.find("y", v));
+    CHECK(a.find(key("y"), v));
     CHECK(isBool(v, false));
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 10.0));
 }
 
@@ -127,15 +145,15 @@ TEST_CASE("Copy constructor from empty map") {
 
 TEST_CASE("Copy constructor from non-empty map") {
     ValueMap a;
-    a.insert("x", Value(1.0));
-    a.insert("flag", Value(true));
+    a.insert(key("x"), Value(1.0));
+    a.insert(key("flag"), Value(true));
 
     ValueMap b(a);
 
     Value v;
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 1.0));
-    CHECK(b.find("flag", v));
+    CHECK(b.find(key("flag"), v));
     CHECK(isBool(v, true));
 }
 
@@ -149,15 +167,15 @@ TEST_CASE("Move constructor from empty map") {
 
 TEST_CASE("Move constructor from non-empty map") {
     ValueMap a;
-    a.insert("x", Value(1.0));
+    a.insert(key("x"), Value(1.0));
 
     ValueMap b(std::move(a));
 
     CHECK(a.isEmpty());
-    CHECK(b.contains("x"));
+    CHECK(b.contains(key("x")));
 
     Value v;
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 1.0));
 }
 
@@ -172,46 +190,46 @@ TEST_CASE("Copy assignment - empty to empty") {
 TEST_CASE("Copy assignment - empty to non-empty") {
     ValueMap a;
     ValueMap b;
-    b.insert("k", Value(5.0));
+    b.insert(key("k"), Value(5.0));
 
     b = a;
 
     CHECK(b.isEmpty());
-    CHECK_FALSE(b.contains("k"));
+    CHECK_FALSE(b.contains(key("k")));
 }
 
 TEST_CASE("Copy assignment - non-empty to empty") {
     ValueMap a;
-    a.insert("x", Value(1.0));
+    a.insert(key("x"), Value(1.0));
 
     ValueMap b;
     b = a;
 
-    CHECK(b.contains("x"));
+    CHECK(b.contains(key("x")));
 
     Value v;
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 1.0));
 }
 
 TEST_CASE("Copy assignment - non-empty to non-empty") {
     ValueMap a;
-    a.insert("x", Value(1.0));
-    a.insert("y", Value(2.0));
+    a.insert(key("x"), Value(1.0));
+    a.insert(key("y"), Value(2.0));
 
     ValueMap b;
-    b.insert("z", Value(99.0));
+    b.insert(key("z"), Value(99.0));
 
     b = a;
 
-    CHECK(b.contains("x"));
-    CHECK(b.contains("y"));
-    CHECK_FALSE(b.contains("z"));
+    CHECK(b.contains(key("x")));
+    CHECK(b.contains(key("y")));
+    CHECK_FALSE(b.contains(key("z")));
 
     Value v;
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 1.0));
-    CHECK(b.find("y", v));
+    CHECK(b.find(key("y"), v));
     CHECK(isNumber(v, 2.0));
 }
 
@@ -227,49 +245,49 @@ TEST_CASE("Move assignment - empty to empty") {
 TEST_CASE("Move assignment - empty to non-empty") {
     ValueMap a;
     ValueMap b;
-    b.insert("k", Value(5.0));
+    b.insert(key("k"), Value(5.0));
 
     b = std::move(a);
 
     CHECK(b.isEmpty());
     CHECK(a.isEmpty());
-    CHECK_FALSE(b.contains("k"));
+    CHECK_FALSE(b.contains(key("k")));
 }
 
 TEST_CASE("Move assignment - non-empty to empty") {
     ValueMap a;
-    a.insert("x", Value(7.0));
+    a.insert(key("x"), Value(7.0));
 
     ValueMap b;
     b = std::move(a);
 
-    CHECK(b.contains("x"));
+    CHECK(b.contains(key("x")));
     CHECK(a.isEmpty());
 
     Value v;
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 7.0));
 }
 
 TEST_CASE("Move assignment - non-empty to non-empty") {
     ValueMap a;
-    a.insert("x", Value(11.0));
-    a.insert("y", Value(false));
+    a.insert(key("x"), Value(11.0));
+    a.insert(key("y"), Value(false));
 
     ValueMap b;
-    b.insert("z", Value(99.0));
+    b.insert(key("z"), Value(99.0));
 
     b = std::move(a);
 
-    CHECK(b.contains("x"));
-    CHECK(b.contains("y"));
-    CHECK_FALSE(b.contains("z"));
+    CHECK(b.contains(key("x")));
+    CHECK(b.contains(key("y")));
+    CHECK_FALSE(b.contains(key("z")));
     CHECK(a.isEmpty());
 
     Value v;
-    CHECK(b.find("x", v));
+    CHECK(b.find(key("x"), v));
     CHECK(isNumber(v, 11.0));
-    CHECK(b.find("y", v));
+    CHECK(b.find(key("y"), v));
     CHECK(isBool(v, false));
 }
 
@@ -278,30 +296,33 @@ TEST_CASE("ValueMap handles many random keys correctly") {
     std::uniform_int_distribution<int> dist(0, 1000000);
 
     const std::size_t N = 500;
-    std::vector<String> keys;
+    std::vector<const String*> keys;
+    std::unordered_map<const String*, double> expected;
     keys.reserve(N);
 
     ValueMap m;
     for (std::size_t i = 0; i < N; ++i) {
-        String key = "k";
-        key += std::to_string(dist(rng)).c_str();
-        keys.push_back(key);
+        std::string chars = "k";
+        chars += std::to_string(dist(rng));
+        const String* k = key(chars);
+        keys.push_back(k);
+        expected[k] = double(i);
 
-        m.insert(std::move(key), Value(double(i)));
+        m.insert(k, Value(double(i)));
     }
 
     for (std::size_t i = 0; i < N; ++i) {
         Value v;
         CHECK(m.find(keys[i], v));
-        CHECK(isNumber(v, double(i)));
+        CHECK(isNumber(v, expected[keys[i]]));
     }
 }
 
 TEST_CASE("Random mixed operations under load behave correctly") {
     const auto makeBaseKey = [](int i) {
-        String key = "base";
-        key += std::to_string(i).c_str();
-        return key;
+        std::string chars = "base";
+        chars += std::to_string(i);
+        return key(chars);
     };
     enum class Op { INSERT, REMOVE, FIND };
     const int minOp = static_cast<int>(Op::INSERT);
@@ -309,10 +330,10 @@ TEST_CASE("Random mixed operations under load behave correctly") {
     class Random {
     public:
         Random() : rng(98765), keyDist(0, 1000000), opDist(minOp, maxOp) {}
-        String key() {
-            String key = "k";
-            key += std::to_string(keyDist(rng)).c_str();
-            return key;
+        const String* key() {
+            std::string chars = "k";
+            chars += std::to_string(keyDist(rng));
+            return ::key(chars);
         }
         Op op() {
             return static_cast<Op>(opDist(rng));
@@ -324,30 +345,30 @@ TEST_CASE("Random mixed operations under load behave correctly") {
     } random;
 
     ValueMap map;
-    std::unordered_map<String, Value> refMap;
+    std::unordered_map<const String*, Value> refMap;
 
     const int PREFILL = 300;
     for (int i = 0; i < PREFILL; ++i) {
-        String key = makeBaseKey(i);
+        const String* k = makeBaseKey(i);
         auto val = Value{double(i)};
-        refMap[key] = val;
-        map.insert(std::move(key), val);
+        refMap[k] = val;
+        map.insert(k, val);
     }
 
     const int OPS = 2000;
     for (int i = 0; i < OPS; ++i) {
-        String key = random.key();
+        const String* k = random.key();
         switch (random.op()) {
             case Op::INSERT: {
                 auto val = Value{double(i)};
-                map.insert(key, val);
-                refMap[key] = val;
+                map.insert(k, val);
+                refMap[k] = val;
             } break;
             case Op::REMOVE: {
                 Value removed;
-                bool found = map.remove(key, removed);
+                bool found = map.remove(k, removed);
 
-                auto it = refMap.find(key);
+                auto it = refMap.find(k);
                 if (it != refMap.end()) {
                     CHECK(found);
                     CHECK(removed == it->second);
@@ -359,9 +380,9 @@ TEST_CASE("Random mixed operations under load behave correctly") {
             } break;
             case Op::FIND: {
                 Value v;
-                bool found = map.find(key, v);
+                bool found = map.find(k, v);
 
-                auto it = refMap.find(key);
+                auto it = refMap.find(k);
                 if (it != refMap.end()) {
                     CHECK(found);
                     CHECK(v == it->second);
@@ -378,9 +399,9 @@ TEST_CASE("Random mixed operations under load behave correctly") {
         }
     }
 
-    for (const auto& [key, val] : refMap) {
+    for (const auto& [k, val] : refMap) {
         Value v;
-        CHECK(map.find(key, v));
+        CHECK(map.find(k, v));
         CHECK(v == val);
     }
 }
\ No newline at end of file
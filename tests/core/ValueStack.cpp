@@ -93,4 +93,35 @@ TEST_CASE("Clear empties the stack") {
 
     CHECK(s.isEmpty());
     CHECK(s.size() == 0);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Stack has the requested fixed capacity") {
+    ValueStack s(4);
+
+    CHECK(s.capacity() == 4);
+    CHECK_FALSE(s.isFull());
+
+    const Value* data = s.data();
+    for (int i = 0; i < 4; ++i) {
+        s.push(Value((double)i));
+    }
+
+    CHECK(s.isFull());
+    CHECK(s.size() == 4);
+    CHECK(s.data() == data);
+}
+
+TEST_CASE("setEnd moves the top of the stack") {
+    ValueStack s(8);
+    s.push(Value(1.0));
+
+    Value* top = s.end();
+    *(top++) = Value(2.0);
+    *(top++) = Value(3.0);
+    s.setEnd(top);
+
+    REQUIRE(s.size() == 3);
+    CHECK(s.peek().asNumber() == 3.0);
+    CHECK(s.pop().asNumber() == 3.0);
+    CHECK(s.size() == 2);
+}
@@ -12,6 +12,11 @@ Expectation comment formats (placed anywhere in a .lox file):
                                              (line number inferred from comment position)
     // nontest                            -- skip this file entirely
 
+With --aot-dir the runner runs the standalone binaries built from the
+tests with `cpplox --emit-cpp` instead, found under the directory at the
+path of the test relative to this one, without the .lox extension. Tests
+which expect compile errors have no binary and are skipped.
+
 Exit-code conventions:
     0  = success
     65 = compile error
@@ -87,13 +92,13 @@ def parse_expectations(filepath: Path) -> Expectations:
     return exp
 
 
-def run_test(interpreter: Path, filepath: Path, exp: Expectations) -> TestResult:
-    """Run *filepath* under *interpreter* and validate against *exp*."""
+def run_test(command: list[str], filepath: Path, exp: Expectations) -> TestResult:
+    """Run *command* for *filepath* and validate against *exp*."""
     result = TestResult(path=str(filepath), passed=True)
 
     try:
         proc = subprocess.run(
-            [str(interpreter), str(filepath)],
+            command,
             capture_output=True,
             text=True,
             timeout=TIMEOUT_SECONDS,
@@ -104,7 +109,7 @@ def run_test(interpreter: Path, filepath: Path, exp: Expectations) -> TestResult
         return result
     except OSError as e:
         result.passed = False
-        result.failures.append(f"Failed to run interpreter: {e}")
+        result.failures.append(f"Failed to run test: {e}")
         return result
 
     actual_stdout = proc.stdout.splitlines() if proc.stdout else []
@@ -169,8 +174,9 @@ def discover_tests(path: Path) -> list[Path]:
 
 def main() -> int:
     parser = argparse.ArgumentParser(description="cpplox end-to-end test runner")
+    parser.add_argument("--interpreter", help="Path to the cpplox executable")
     parser.add_argument(
-        "--interpreter", required=True, help="Path to the cpplox executable"
+        "--aot-dir", help="Directory of the ahead-of-time built test binaries"
     )
     parser.add_argument(
         "paths",
@@ -183,12 +189,18 @@ def main() -> int:
     )
     args = parser.parse_args()
 
-    interpreter = Path(args.interpreter)
-    if not interpreter.exists():
-        print(f"Error: interpreter not found: {interpreter}", file=sys.stderr)
+    if (args.interpreter is None) == (args.aot_dir is None):
+        print("Error: expected one of --interpreter or --aot-dir", file=sys.stderr)
         return 1
 
-    test_paths = [Path(p) for p in args.paths] if args.paths else [Path(__file__).parent]
+    if args.interpreter is not None:
+        interpreter = Path(args.interpreter)
+        if not interpreter.exists():
+            print(f"Error: interpreter not found: {interpreter}", file=sys.stderr)
+            return 1
+
+    tests_dir = Path(__file__).parent.resolve()
+    test_paths = [Path(p) for p in args.paths] if args.paths else [tests_dir]
 
     all_tests: list[Path] = []
     for p in test_paths:
@@ -206,13 +218,18 @@ def main() -> int:
     for test_file in all_tests:
         exp = parse_expectations(test_file)
 
-        if exp.skip:
+        if exp.skip or (args.aot_dir is not None and exp.compile_errors):
             skipped += 1
             if args.verbose:
                 print(f"  SKIP  {test_file}")
             continue
 
-        result = run_test(interpreter, test_file, exp)
+        if args.aot_dir is not None:
+            relative = test_file.resolve().relative_to(tests_dir)
+            command = [str(Path(args.aot_dir) / relative.with_suffix(""))]
+        else:
+            command = [str(interpreter), str(test_file)]
+        result = run_test(command, test_file, exp)
 
         if result.passed:
             passed += 1
@@ -0,0 +1,113 @@
+#include "doctest/doctest.h"
+#include "cpplox/vm/X64Assembler.hpp"
+
+#include <initializer_list>
+
+TEST_SUITE("x86-64 assembler") {
+    using cpplox::x64::Assembler;
+    using cpplox::x64::Cond;
+    using cpplox::x64::Label;
+    using cpplox::x64::Reg;
+    using cpplox::x64::Xmm;
+
+    bool hasCode(const Assembler& a, std::initializer_list<std::uint8_t> expected) {
+        if (a.size() != expected.size()) {
+            return false;
+        }
+        std::size_t i = 0;
+        for (const std::uint8_t byte : expected) {
+            if (a.code()[i++] != byte) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    TEST_CASE("register moves and pushes of the extended registers have a REX prefix") {
+        Assembler a;
+        a.push(Reg::RBX);
+        a.push(Reg::R12);
+        a.mov(Reg::R13, Reg::RDX);
+        a.pop(Reg::R15);
+        a.ret();
+
+        CHECK(hasCode(a, {0x53,
+                          0x41, 0x54,
+                          0x49, 0x89, 0xD5,
+                          0x41, 0x5F,
+                          0xC3}));
+    }
+
+    TEST_CASE("a 64-bit immediate is little-endian") {
+        Assembler a;
+        a.mov(Reg::R15, 0x7ffc000000000000);
+
+        CHECK(hasCode(a, {0x49, 0xBF, 0, 0, 0, 0, 0, 0, 0xFC, 0x7F}));
+    }
+
+    TEST_CASE("memory operands") {
+        SUBCASE("a short displacement takes one byte") {
+            Assembler a;
+            a.load(Reg::RAX, Reg::R13, -8);
+            CHECK(hasCode(a, {0x49, 0x8B, 0x45, 0xF8}));
+        }
+        SUBCASE("r12 as a base needs a SIB byte") {
+            Assembler a;
+            a.store(Reg::R12, 0x100, Reg::RCX);
+            CHECK(hasCode(a, {0x49, 0x89, 0x8C, 0x24, 0x00, 0x01, 0x00, 0x00}));
+        }
+    }
+
+    TEST_CASE("arithmetic with immediates uses the short form when it fits") {
+        Assembler a;
+        a.add(Reg::R13, 8);
+        a.sub(Reg::R13, 0x1000);
+        a.cmp(Reg::RCX, 1);
+
+        CHECK(hasCode(a, {0x49, 0x83, 0xC5, 0x08,
+                          0x49, 0x81, 0xED, 0x00, 0x10, 0x00, 0x00,
+                          0x48, 0x83, 0xF9, 0x01}));
+    }
+
+    TEST_CASE("scalar double operations") {
+        Assembler a;
+        a.movq(Xmm::XMM0, Reg::RAX);
+        a.addsd(Xmm::XMM0, Xmm::XMM1);
+        a.ucomisd(Xmm::XMM1, Xmm::XMM0);
+        a.movq(Reg::RAX, Xmm::XMM0);
+
+        CHECK(hasCode(a, {0x66, 0x48, 0x0F, 0x6E, 0xC0,
+                          0xF2, 0x0F, 0x58, 0xC1,
+                          0x66, 0x0F, 0x2E, 0xC8,
+                          0x66, 0x48, 0x0F, 0x7E, 0xC0}));
+    }
+
+    TEST_CASE("a flag is materialized as 0 or 1") {
+        Assembler a;
+        a.set(Cond::BE, Reg::RAX);
+
+        CHECK(hasCode(a, {0x0F, 0x96, 0xC0, 0x0F, 0xB6, 0xC0}));
+    }
+
+    TEST_CASE("jumps are resolved relative to the next instruction") {
+        Assembler a;
+        Label back = a.newLabel();
+        Label forward = a.newLabel();
+        a.bind(back);
+        a.jcc(Cond::E, forward);
+        a.jmp(back);
+        a.bind(forward);
+        REQUIRE(a.finish());
+
+        CHECK(hasCode(a, {0x0F, 0x84, 0x05, 0x00, 0x00, 0x00,
+                          0xE9, 0xF5, 0xFF, 0xFF, 0xFF}));
+        CHECK(a.offsetOf(forward) == 11);
+    }
+
+    TEST_CASE("an unbound label fails the assembly") {
+        Assembler a;
+        a.jmp(a.newLabel());
+
+        CHECK_FALSE(a.finish());
+    }
+}
@@ -0,0 +1,305 @@
+#include "doctest/doctest.h"
+#include "cpplox/bytecode/Optimizer.hpp"
+#include "cpplox/bytecode/Bytecode.hpp"
+#include "cpplox/bytecode/OpCode.hpp"
+
+#include <initializer_list>
+
+TEST_SUITE("Peephole optimizer") {
+    using cpplox::Chunk;
+    using cpplox::OpCode;
+    using cpplox::OptimizationLevel;
+    using cpplox::addCode;
+    using cpplox::optimize;
+
+    void emit(Chunk& chunk, unsigned line, OpCode op) {
+        addCode(chunk, static_cast<std::uint8_t>(op), line);
+    }
+
+    void emit(Chunk& chunk, unsigned line, OpCode op, std::uint8_t operand) {
+        emit(chunk, line, op);
+        addCode(chunk, operand, line);
+    }
+
+    void emit(Chunk& chunk, unsigned line, OpCode op, std::uint8_t a, std::uint8_t b) {
+        emit(chunk, line, op, a);
+        addCode(chunk, b, line);
+    }
+
+    bool hasCode(const Chunk& chunk, std::initializer_list<std::uint8_t> expected) {
+        if (chunk.code.getCount() != expected.size()) {
+            return false;
+        }
+        std::size_t i = 0;
+        for (const std::uint8_t byte : expected) {
+            if (chunk.code[i++] != byte) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::uint8_t byte(OpCode op) {
+        return static_cast<std::uint8_t>(op);
+    }
+
+    TEST_CASE("level NONE leaves the code as it is") {
+        Chunk chunk;
+        emit(chunk, 1, OpCode::NIL);
+        emit(chunk, 1, OpCode::SET_LOCAL, 1);
+        emit(chunk, 1, OpCode::POP);
+        emit(chunk, 1, OpCode::JMP, 0, 0);
+        emit(chunk, 1, OpCode::NIL);
+        emit(chunk, 1, OpCode::RETURN);
+
+        const Chunk before = chunk;
+        optimize(chunk, OptimizationLevel::NONE);
+
+        CHECK(chunk.code == before.code);
+        CHECK(chunk.lines == before.lines);
+    }
+
+    TEST_CASE("a local assignment statement pops in the same instruction") {
+        Chunk chunk;
+        emit(chunk, 1, OpCode::NIL);
+        emit(chunk, 2, OpCode::SET_LOCAL, 1);
+        emit(chunk, 2, OpCode::POP);
+        emit(chunk, 3, OpCode::NIL);
+        emit(chunk, 3, OpCode::RETURN);
+
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        CHECK(hasCode(chunk, {byte(OpCode::NIL),
+                              byte(OpCode::SET_LOCAL_POP), 1,
+                              byte(OpCode::NIL),
+                              byte(OpCode::RETURN)}));
+        REQUIRE(chunk.lines.getCount() == 5);
+        CHECK(chunk.lines[1] == 2);
+        CHECK(chunk.lines[2] == 2);
+        CHECK(chunk.lines[3] == 3);
+    }
+
+    TEST_CASE("a negated condition flips the jump") {
+        // if (!x) nil;
+        Chunk chunk;
+        emit(chunk, 1, OpCode::READ_LOCAL, 1);
+        emit(chunk, 1, OpCode::NOT);
+        emit(chunk, 1, OpCode::POP_JMP_IF_FALSE, 2, 0);
+        emit(chunk, 1, OpCode::NIL);
+        emit(chunk, 1, OpCode::POP);
+        emit(chunk, 2, OpCode::NIL);
+        emit(chunk, 2, OpCode::RETURN);
+
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        CHECK(hasCode(chunk, {byte(OpCode::READ_LOCAL), 1,
+                              byte(OpCode::POP_JMP_IF_TRUE), 2, 0,
+                              byte(OpCode::NIL),
+                              byte(OpCode::POP),
+                              byte(OpCode::NIL),
+                              byte(OpCode::RETURN)}));
+    }
+
+    TEST_CASE("a sequence is not fused when a jump lands in its middle") {
+        Chunk chunk;
+        emit(chunk, 1, OpCode::TRUE);
+        emit(chunk, 1, OpCode::POP_JMP_IF_FALSE, 2, 0);
+        emit(chunk, 1, OpCode::SET_LOCAL, 1);
+        emit(chunk, 1, OpCode::POP);
+        emit(chunk, 1, OpCode::NIL);
+        emit(chunk, 1, OpCode::RETURN);
+
+        const Chunk before = chunk;
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        CHECK(chunk.code == before.code);
+    }
+
+    TEST_CASE("jumps to jumps go straight to the final target") {
+        Chunk chunk;
+        emit(chunk, 1, OpCode::TRUE);                       // 0
+        emit(chunk, 1, OpCode::POP_JMP_IF_FALSE, 4, 0);     // 1 -> 8
+        emit(chunk, 1, OpCode::NIL);                        // 4
+        emit(chunk, 1, OpCode::POP);                        // 5
+        emit(chunk, 1, OpCode::NIL);                        // 6
+        emit(chunk, 1, OpCode::POP);                        // 7
+        emit(chunk, 1, OpCode::JMP, 2, 0);                  // 8 -> 13
+        emit(chunk, 1, OpCode::NIL);                        // 11
+        emit(chunk, 1, OpCode::POP);                        // 12
+        emit(chunk, 1, OpCode::NIL);                        // 13
+        emit(chunk, 1, OpCode::RETURN);                     // 14
+
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        // the JMP itself becomes a jump to the next instruction and the
+        // code it skipped is dead, so both are removed
+        CHECK(hasCode(chunk, {byte(OpCode::TRUE),
+                              byte(OpCode::POP_JMP_IF_FALSE), 4, 0,
+                              byte(OpCode::NIL),
+                              byte(OpCode::POP),
+                              byte(OpCode::NIL),
+                              byte(OpCode::POP),
+                              byte(OpCode::NIL),
+                              byte(OpCode::RETURN)}));
+    }
+
+    TEST_CASE("a forward jump to a loop becomes a loop") {
+        // while (x) { if (y) { jump to the end of the body } nil; }
+        Chunk chunk;
+        emit(chunk, 1, OpCode::READ_LOCAL, 1);              // 0
+        emit(chunk, 1, OpCode::POP_JMP_IF_FALSE, 12, 0);    // 2 -> 17
+        emit(chunk, 1, OpCode::READ_LOCAL, 2);              // 5
+        emit(chunk, 1, OpCode::POP_JMP_IF_FALSE, 3, 0);     // 7 -> 13
+        emit(chunk, 1, OpCode::JMP, 1, 0);                  // 10 -> 14
+        emit(chunk, 1, OpCode::NIL);                        // 13
+        emit(chunk, 1, OpCode::LOOP, 17, 0);                // 14 -> 0
+        emit(chunk, 1, OpCode::NIL);                        // 17
+        emit(chunk, 1, OpCode::RETURN);                     // 18
+
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        CHECK(hasCode(chunk, {byte(OpCode::READ_LOCAL), 1,
+                              byte(OpCode::POP_JMP_IF_FALSE), 12, 0,
+                              byte(OpCode::READ_LOCAL), 2,
+                              byte(OpCode::POP_JMP_IF_FALSE), 3, 0,
+                              byte(OpCode::LOOP), 13, 0,
+                              byte(OpCode::NIL),
+                              byte(OpCode::LOOP), 17, 0,
+                              byte(OpCode::NIL),
+                              byte(OpCode::RETURN)}));
+    }
+
+    TEST_CASE("unreachable code is removed and the jumps over it are fixed") {
+        Chunk chunk;
+        emit(chunk, 1, OpCode::TRUE);                       // 0
+        emit(chunk, 1, OpCode::POP_JMP_IF_FALSE, 3, 0);     // 1 -> 7
+        emit(chunk, 2, OpCode::NIL);                        // 4
+        emit(chunk, 2, OpCode::RETURN);                     // 5
+        emit(chunk, 3, OpCode::POP);                        // 6, dead
+        emit(chunk, 4, OpCode::NIL);                        // 7
+        emit(chunk, 4, OpCode::RETURN);                     // 8
+
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        CHECK(hasCode(chunk, {byte(OpCode::TRUE),
+                              byte(OpCode::POP_JMP_IF_FALSE), 2, 0,
+                              byte(OpCode::NIL),
+                              byte(OpCode::RETURN),
+                              byte(OpCode::NIL),
+                              byte(OpCode::RETURN)}));
+        REQUIRE(chunk.lines.getCount() == 8);
+        CHECK(chunk.lines[4] == 2);
+        CHECK(chunk.lines[6] == 4);
+        CHECK(chunk.lines[7] == 4);
+    }
+
+    TEST_CASE("operands of other instructions are copied as they are") {
+        Chunk chunk;
+        cpplox::addPropertyCache(chunk);
+        emit(chunk, 1, OpCode::READ_LOCAL, 0);
+        emit(chunk, 1, OpCode::GET_PROPERTY, 7);
+        addCode(chunk, 0, 1);
+        addCode(chunk, 0, 1);
+        emit(chunk, 1, OpCode::JMP, 0, 0);
+        emit(chunk, 1, OpCode::RETURN);
+
+        optimize(chunk, OptimizationLevel::PEEPHOLE);
+
+        CHECK(hasCode(chunk, {byte(OpCode::READ_LOCAL), 0,
+                              byte(OpCode::GET_PROPERTY), 7, 0, 0,
+                              byte(OpCode::RETURN)}));
+        CHECK(chunk.propertyCaches.getCount() == 1);
+    }
+}
+
+TEST_SUITE("Register allocation") {
+    using cpplox::Chunk;
+    using cpplox::OpCode;
+    using cpplox::RK_CONSTANT;
+    using cpplox::addCode;
+    using cpplox::allocateRegisters;
+
+    void emit(Chunk& chunk, OpCode op) {
+        addCode(chunk, static_cast<std::uint8_t>(op), 1);
+    }
+
+    void emit(Chunk& chunk, OpCode op, std::uint8_t operand) {
+        emit(chunk, op);
+        addCode(chunk, operand, 1);
+    }
+
+    void emit(Chunk& chunk, OpCode op, std::uint8_t a, std::uint8_t b) {
+        emit(chunk, op, a);
+        addCode(chunk, b, 1);
+    }
+
+    TEST_CASE("a local copied to another local becomes a move") {
+        Chunk chunk;
+        emit(chunk, OpCode::READ_LOCAL, 1);
+        emit(chunk, OpCode::SET_LOCAL_POP, 2);
+        emit(chunk, OpCode::RETURN);
+
+        allocateRegisters(chunk);
+
+        CHECK(hasCode(chunk, {byte(OpCode::MOVE), 2, 1,
+                              byte(OpCode::RETURN)}));
+        CHECK(chunk.lines.getCount() == chunk.code.getCount());
+    }
+
+    TEST_CASE("arithmetic on locals and constants stored to a local is three-address") {
+        Chunk chunk;
+        emit(chunk, OpCode::READ_LOCAL, 1);
+        emit(chunk, OpCode::CONSTANT, 3);
+        emit(chunk, OpCode::MULTIPLY);
+        emit(chunk, OpCode::SET_LOCAL, 2);
+        emit(chunk, OpCode::POP);
+        emit(chunk, OpCode::RETURN);
+
+        allocateRegisters(chunk);
+
+        CHECK(hasCode(chunk, {byte(OpCode::MULTIPLY_RK), 2, 1, 3 | RK_CONSTANT,
+                              byte(OpCode::RETURN)}));
+    }
+
+    TEST_CASE("fused superinstructions are rewritten as well") {
+        Chunk chunk;
+        emit(chunk, OpCode::ADD_LOCAL_CONST, 1, 0);
+        emit(chunk, OpCode::SET_LOCAL_POP, 1);
+        emit(chunk, OpCode::RETURN);
+
+        allocateRegisters(chunk);
+
+        CHECK(hasCode(chunk, {byte(OpCode::ADD_RK), 1, 1, RK_CONSTANT,
+                              byte(OpCode::RETURN)}));
+    }
+
+    TEST_CASE("a comparison and its jump become one instruction with the same target") {
+        Chunk chunk;
+        emit(chunk, OpCode::LESS_LOCAL_CONST, 1, 2);       // 0
+        emit(chunk, OpCode::POP_JMP_IF_FALSE, 2, 0);       // 3
+        emit(chunk, OpCode::NIL);                          // 6
+        emit(chunk, OpCode::POP);                          // 7
+        emit(chunk, OpCode::RETURN);                       // 8
+
+        allocateRegisters(chunk);
+
+        CHECK(hasCode(chunk, {byte(OpCode::JMP_IF_NOT_LESS_RK), 2, 0, 1, 2 | RK_CONSTANT,
+                              byte(OpCode::NIL),
+                              byte(OpCode::POP),
+                              byte(OpCode::RETURN)}));
+    }
+
+    TEST_CASE("a sequence is not rewritten when a jump lands in its middle") {
+        Chunk chunk;
+        emit(chunk, OpCode::TRUE);
+        emit(chunk, OpCode::POP_JMP_IF_FALSE, 2, 0);
+        emit(chunk, OpCode::READ_LOCAL, 1);
+        emit(chunk, OpCode::SET_LOCAL_POP, 2);
+        emit(chunk, OpCode::RETURN);
+
+        const Chunk before = chunk;
+        allocateRegisters(chunk);
+
+        CHECK(chunk.code == before.code);
+    }
+}
@@ -0,0 +1,82 @@
+#include "doctest/doctest.h"
+#include "cpplox/runtime/GC.hpp"
+#include "cpplox/runtime/Upvalue.hpp"
+#include "cpplox/core/Vector.hpp"
+
+TEST_SUITE("GC marker") {
+    using cpplox::Object;
+    using cpplox::Upvalue;
+    using cpplox::Value;
+    using cpplox::Vector;
+    using cpplox::gc::Marker;
+
+    // a closed upvalue holding the previous one, count long
+    Vector<Upvalue*> makeChain(std::size_t count) {
+        Vector<Upvalue*> chain;
+        chain.reserve(count);
+        Upvalue* prev = nullptr;
+        for (std::size_t i = 0; i < count; ++i) {
+            auto* u = cpplox::gc::makeObject<Upvalue>(nullptr);
+            if (prev != nullptr) {
+                u->closed = Value(static_cast<Object*>(prev));
+            }
+            u->location = &u->closed;
+            chain.insertBack(u);
+            prev = u;
+        }
+        return chain;
+    }
+
+    void freeChain(Vector<Upvalue*>& chain) {
+        for (std::size_t i = 0; i < chain.getCount(); ++i) {
+            cpplox::gc::freeObject(chain[i]);
+        }
+        chain.clear();
+    }
+
+    bool allMarked(const Vector<Upvalue*>& chain) {
+        for (std::size_t i = 0; i < chain.getCount(); ++i) {
+            if (chain[i]->isReachable == false) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    TEST_CASE("visiting only marks, tracing marks everything reachable") {
+        Vector<Upvalue*> chain = makeChain(3);
+        Marker marker;
+
+        marker.visit(chain.back());
+        CHECK(chain[2]->isReachable);
+        CHECK(chain[1]->isReachable == false);
+
+        marker.trace();
+        CHECK(allMarked(chain));
+
+        freeChain(chain);
+    }
+
+    TEST_CASE("marking a long chain does not recurse on the native stack") {
+        Vector<Upvalue*> chain = makeChain(1'000'000);
+        Marker marker;
+
+        marker.visit(chain.back());
+        marker.trace();
+        CHECK(allMarked(chain));
+
+        freeChain(chain);
+    }
+
+    TEST_CASE("cycles are marked once") {
+        Vector<Upvalue*> chain = makeChain(2);
+        chain[0]->closed = Value(static_cast<Object*>(chain[1]));
+        Marker marker;
+
+        marker.visit(chain[0]);
+        marker.trace();
+        CHECK(allMarked(chain));
+
+        freeChain(chain);
+    }
+}
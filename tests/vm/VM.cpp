@@ -0,0 +1,57 @@
+#include "doctest/doctest.h"
+#include "cpplox/vm/VM.hpp"
+#include "cpplox/compiler/Compiler.hpp"
+#include "cpplox/diagnostics/DiagnosticEngine.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace {
+    class DiagnosticsIgnore : public cpplox::DiagnosticConsumer {
+    public:
+        void consume(cpplox::Diagnostic&&) override {}
+    };
+
+    cpplox::InterpretResult interpret(cpplox::VM& vm, std::string source) {
+        cpplox::DiagnosticEngine diag(std::make_unique<DiagnosticsIgnore>());
+        cpplox::Compiler compiler;
+        compiler.setGlobals(&vm.globalTable());
+        cpplox::CompileResult compiled = compiler.compile(std::move(source), &diag);
+        REQUIRE_FALSE(compiled.error);
+        return vm.interpret(compiled.function, std::move(compiled.gcObjects));
+    }
+
+    bool startsWith(const cpplox::String& s, std::string_view prefix) {
+        return std::string_view(s.c_str(), s.size()).starts_with(prefix);
+    }
+} // namespace
+
+TEST_SUITE("Stack capacity") {
+    using cpplox::InterpretResultCode;
+    using cpplox::VM;
+    using cpplox::VMOptions;
+
+    TEST_CASE("a script which does not fit the stack is a stack overflow") {
+        VM vm(VMOptions{.stackSize = 2});
+        const auto r = interpret(vm, "{ var a = 1; var b = 2; var d = 3; print a + b + d; }");
+
+        CHECK(r.code == InterpretResultCode::RUNTIME_ERROR);
+        CHECK(startsWith(r.error, "Stack overflow."));
+    }
+
+    TEST_CASE("a stack without room for the script is a stack overflow") {
+        VM vm(VMOptions{.stackSize = 0});
+        const auto r = interpret(vm, "print 1;");
+
+        CHECK(r.code == InterpretResultCode::RUNTIME_ERROR);
+        CHECK(startsWith(r.error, "Stack overflow."));
+    }
+
+    TEST_CASE("a script which fits the stack runs") {
+        VM vm(VMOptions{.stackSize = 16});
+        const auto r = interpret(vm, "var a = 1;");
+
+        CHECK(r.code == InterpretResultCode::OK);
+    }
+}